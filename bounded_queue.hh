@@ -0,0 +1,153 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __BOUNDED_QUEUE_HH__
+#define __BOUNDED_QUEUE_HH__
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace csv {
+
+    /// A bounded, lock-free, multi-producer multi-consumer queue.
+    //
+    /// Elements are stored in a ring buffer of a fixed number of
+    /// cells, with each cell carrying a sequence number telling
+    /// producers and consumers whether the cell is free to write
+    /// or ready to be read. Producers and consumers each claim
+    /// positions with a single compare-and-swap, and never block.
+    ///
+    /// Neither try_push() nor try_pop() waits. A full queue makes
+    /// try_push() return false, which is how backpressure is applied
+    /// to producers. Callers decide how to wait before retrying.
+    ///
+    /// \c T should be cheap to copy, typically a pointer.
+    ///
+    template <typename T>
+    class BoundedQueue {
+    public:
+        /// Constructor.
+        //
+        /// @param capacity The minimum number of elements that the
+        ///                 queue can hold. Rounded up to a power of two.
+        ///
+        BoundedQueue(std::size_t capacity)
+        {
+            std::size_t size(2);
+
+            while(size < capacity)
+                size <<= 1;
+
+            cells_.reset(new Cell[size]);
+            mask_ = size - 1;
+
+            for(std::size_t i = 0; i < size; ++i)
+                cells_[i].sequence_.store(i, std::memory_order_relaxed);
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        /// Return the number of elements that the queue can hold.
+        std::size_t capacity(void) const { return mask_ + 1; }
+
+        /// Add an element to the end of the queue.
+        //
+        /// @param value The element to add.
+        ///
+        /// @return true - The element was added.
+        /// @return false - The queue is full.
+        ///
+        bool try_push(const T& value)
+        {
+            std::size_t position(push_position_.load(std::memory_order_relaxed));
+
+            while(true) {
+                Cell& cell(cells_[position & mask_]);
+                std::size_t sequence(cell.sequence_.load(std::memory_order_acquire));
+                std::ptrdiff_t diff(std::ptrdiff_t(sequence) - std::ptrdiff_t(position));
+
+                // Is the cell free? Then try to claim it.
+                if (diff == 0) {
+                    if (push_position_.compare_exchange_weak(position, position + 1,
+                                                             std::memory_order_relaxed)) {
+                        cell.value_ = value;
+                        cell.sequence_.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                    continue;
+                }
+
+                // Has the cell not yet been read since the last lap?
+                if (diff < 0)
+                    return false;
+
+                // Another producer claimed the position. Try the next one.
+                position = push_position_.load(std::memory_order_relaxed);
+            }
+        }
+
+        /// Remove the element at the front of the queue.
+        //
+        /// @param value Set to the removed element.
+        ///
+        /// @return true - An element was removed.
+        /// @return false - The queue is empty.
+        ///
+        bool try_pop(T& value)
+        {
+            std::size_t position(pop_position_.load(std::memory_order_relaxed));
+
+            while(true) {
+                Cell& cell(cells_[position & mask_]);
+                std::size_t sequence(cell.sequence_.load(std::memory_order_acquire));
+                std::ptrdiff_t diff(std::ptrdiff_t(sequence) - std::ptrdiff_t(position + 1));
+
+                // Has the cell been written? Then try to claim it.
+                if (diff == 0) {
+                    if (pop_position_.compare_exchange_weak(position, position + 1,
+                                                            std::memory_order_relaxed)) {
+                        value = cell.value_;
+                        cell.sequence_.store(position + mask_ + 1, std::memory_order_release);
+                        return true;
+                    }
+                    continue;
+                }
+
+                // Is the cell still waiting for a producer?
+                if (diff < 0)
+                    return false;
+
+                // Another consumer claimed the position. Try the next one.
+                position = pop_position_.load(std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        struct Cell {
+            std::atomic<std::size_t> sequence_;
+            T value_;
+        };
+
+        std::unique_ptr<Cell[]> cells_;
+        std::size_t mask_ { 0 };
+
+        // Kept on separate cache lines to avoid false sharing
+        // between producers and consumers.
+        alignas(64) std::atomic<std::size_t> push_position_ { 0 };
+        alignas(64) std::atomic<std::size_t> pop_position_ { 0 };
+    };
+};
+#endif
@@ -0,0 +1,394 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// End-to-end throughput benchmark.
+//
+// Generates a synthetic CSV file and converts it with every
+// registered ingester and emitter pair, reporting one JSON object
+// per conversion on stdout.
+//
+// With -E, string escaping is benchmarked instead, comparing
+// csv::Escaper at each supported instruction set with a
+// per-character escaper.
+//
+#include "emitter_iface.hh"
+#include "ingestion_iface.hh"
+#include "csv_common.hh"
+#include "csv_escape.hh"
+#include "csv_simd.hh"
+#include "csv_generator.hh"
+#include "mapped_file.hh"
+#include "factory.hh"
+#include "factory_impl.hh"
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+
+void usage(char* progname)
+{
+    std::cout << "Usage: " << progname << " [-S <bytes>] [-C <columns>] [-m <type-mix>] [-l <length>] [-x <density>] [-r <seed>] [-j <threads>] [-g <file>] [-Q] [-E]" << std::endl;
+    std::cout << "  -S <bytes>                  Size of generated CSV data. Default 64 MB." << std::endl;
+    std::cout << "  -C <columns>                Number of fields per record. Default 8." << std::endl;
+    std::cout << "  -m <type-mix>               Comma separated field types, repeated over all columns. Default 'int,double,string'." << std::endl;
+    std::cout << "  -l <length>                 Maximum string field length. Default 16." << std::endl;
+    std::cout << "  -x <density>                Fraction of string characters that are escaped separators. Default 0.01." << std::endl;
+    std::cout << "  -r <seed>                   Seed of the generated data. Default 1." << std::endl;
+    std::cout << "  -j <threads>                Also benchmark the parallel and pipelined conversions with <threads> threads." << std::endl;
+    std::cout << "  -g <file>                   Only generate data, writing it to <file>." << std::endl;
+    std::cout << "  -Q, --quoted                Quote strings with separators instead of escaping them." << std::endl;
+    std::cout << "  -E, --escape                Benchmark string escaping of <bytes> of strings up to <length> long," << std::endl;
+    std::cout << "                              with <density> of the characters escaped, instead of conversions." << std::endl << std::endl;
+    std::cout << "Each conversion is reported as a JSON object on a single line:" << std::endl;
+    std::cout << "  { \"reader\": ..., \"writer\": ..., \"threads\": ..., \"bytes\": ..., \"records\": ...," << std::endl;
+    std::cout << "    \"seconds\": ..., \"mb_per_s\": ..., \"records_per_s\": ..., \"peak_rss_kb\": ... }" << std::endl;
+    std::cout << "Escaping runs are reported as:" << std::endl;
+    std::cout << "  { \"escaper\": ..., \"style\": ..., \"bytes\": ..., \"strings\": ..., \"seconds\": ..., \"mb_per_s\": ... }" << std::endl;
+}
+
+//
+// The per-character escaper that csv::Escaper replaces, used as
+// the baseline of the escaping benchmark.
+//
+static void naive_escape(std::string& output,
+                         std::string_view value,
+                         csv::Escaper::Style style)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    for(char ch: value) {
+        if (style == csv::Escaper::Style::PREFIX) {
+            if (ch == ',' || ch == '\n')
+                output += '\\';
+            output += ch;
+            continue;
+        }
+
+        switch(ch) {
+        case '"': output += "\\\""; break;
+        case '\\': output += "\\\\"; break;
+        case '\n': output += "\\n"; break;
+        case '\t': output += "\\t"; break;
+        default:
+            if (uint8_t(ch) < 0x20) {
+                output += "\\u00";
+                output += hex[uint8_t(ch) >> 4];
+                output += hex[ch & 0xf];
+            } else
+                output += ch;
+        }
+    }
+}
+
+//
+// Generate strings, escape them with each escaper, and print
+// the results.
+//
+static void run_escape(std::size_t size,
+                       std::size_t string_length,
+                       double escape_density,
+                       uint64_t seed)
+{
+    static const char special[] = "\"\\,\n\t\x01";
+    static const char* level_names[] = { "scalar", "sse2", "avx2", "avx512" };
+    std::mt19937_64 rng(seed);
+    std::string data("");
+    std::vector<std::size_t> offsets { 0 };
+
+    // Printable strings with escape_density of the characters
+    // drawn from the characters escaped by JSON or CSV.
+    while(data.size() < size) {
+        std::size_t length(1 + rng() % (string_length?string_length:1));
+
+        for(std::size_t c = 0; c < length; ++c) {
+            if (std::generate_canonical<double, 32>(rng) < escape_density)
+                data += special[rng() % (sizeof(special) - 1)];
+            else
+                data += char('a' + rng() % 26);
+        }
+        offsets.push_back(data.size());
+    }
+
+    for(auto style: { csv::Escaper::Style::BACKSLASH, csv::Escaper::Style::PREFIX }) {
+        csv::Escaper escaper(style, '\\', ',');
+
+        // -1 is the per-character escaper.
+        for(int level = -1; level <= int(csv::simd_level_supported()); ++level) {
+            std::string output("");
+            std::size_t output_size(0);
+
+            output.reserve(1024*1024);
+            if (level >= 0)
+                csv::set_simd_level(csv::SimdLevel(level));
+
+            auto start(std::chrono::steady_clock::now());
+
+            // Flush the output once in a while, as the emitters do.
+            for(std::size_t index = 1; index < offsets.size(); ++index) {
+                std::string_view value(data.data() + offsets[index - 1], offsets[index] - offsets[index - 1]);
+
+                if (level < 0)
+                    naive_escape(output, value, style);
+                else
+                    escaper.append(output, value);
+
+                if (output.size() >= 1024*1024) {
+                    output_size += output.size();
+                    output.clear();
+                }
+            }
+            output_size += output.size();
+
+            double seconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            std::cout << "{ \"escaper\": \"" << (level < 0?"naive":level_names[level]) <<
+                "\", \"style\": \"" << (style == csv::Escaper::Style::PREFIX?"csv":"json") <<
+                "\", \"bytes\": " << data.size() <<
+                ", \"output_bytes\": " << output_size <<
+                ", \"strings\": " << offsets.size() - 1 <<
+                ", \"seconds\": " << seconds <<
+                ", \"mb_per_s\": " << data.size() / seconds / 1e6 << " }" << std::endl;
+        }
+    }
+    csv::set_simd_level(csv::simd_level_supported());
+}
+
+//
+// Convert the CSV file with the given reader and writer, and
+// print the result.
+//
+// Called in a child process, so that the peak RSS reported is
+// that of the conversion alone.
+//
+static void run(const csv::Specification& spec,
+                const std::string& csv_file,
+                std::size_t size,
+                const std::string& ingestion_type,
+                const std::string& output_type,
+                unsigned int thread_count)
+{
+    auto ingester(csv::Factory<csv::IngestionIface>::produce(ingestion_type));
+    auto emitter(csv::Factory<csv::EmitterIface>::produce(output_type));
+    std::ifstream input(csv_file);
+    std::ofstream output("/dev/null");
+    uint32_t records(0);
+    struct rusage usage;
+
+    auto start(std::chrono::steady_clock::now());
+
+    if (thread_count == 0) {
+        ingester->open_file(csv_file);
+        records = csv::convert(spec, *ingester, input, *emitter, output);
+    } else if (ingestion_type == "csv-mmap") {
+        csv::MappedFile file;
+
+        file.open(csv_file);
+        records = csv::convert(spec, file.data(), file.size(), *emitter, output, thread_count);
+    } else
+        records = csv::convert(spec, input, *emitter, output, thread_count);
+
+    double seconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << "{ \"reader\": \"" << ingestion_type <<
+        "\", \"writer\": \"" << output_type <<
+        "\", \"threads\": " << (thread_count?thread_count:1) <<
+        ", \"bytes\": " << size <<
+        ", \"records\": " << records <<
+        ", \"seconds\": " << seconds <<
+        ", \"mb_per_s\": " << size / seconds / 1e6 <<
+        ", \"records_per_s\": " << records / seconds <<
+        ", \"peak_rss_kb\": " << usage.ru_maxrss << " }" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    static struct option long_options[] =  {
+        {"size", required_argument, NULL, 'S'},
+        {"columns", required_argument, NULL, 'C'},
+        {"mix", required_argument, NULL, 'm'},
+        {"string-length", required_argument, NULL, 'l'},
+        {"escape-density", required_argument, NULL, 'x'},
+        {"seed", required_argument, NULL, 'r'},
+        {"threads", required_argument, NULL, 'j'},
+        {"generate", required_argument, NULL, 'g'},
+        {"quoted", no_argument, NULL, 'Q'},
+        {"escape", no_argument, NULL, 'E'},
+        {NULL, 0, NULL, 0}
+    };
+
+    std::size_t size(64*1024*1024);
+    std::size_t columns(8);
+    std::string mix("int,double,string");
+    std::size_t string_length(16);
+    double escape_density(0.01);
+    uint64_t seed(1);
+    unsigned int thread_count(0);
+    std::string generate_file("");
+    bool quoted(false);
+    bool escape(false);
+    int ch(0);
+
+    while ((ch = getopt_long(argc, argv, "S:C:m:l:x:r:j:g:QE", long_options, NULL)) != -1) {
+        switch (ch)
+        {
+        case 'S':
+            size = strtoull(optarg, 0, 10);
+            break;
+
+        case 'C':
+            columns = strtoul(optarg, 0, 10);
+            break;
+
+        case 'm':
+            mix = optarg;
+            break;
+
+        case 'l':
+            string_length = strtoul(optarg, 0, 10);
+            break;
+
+        case 'x':
+            escape_density = strtod(optarg, 0);
+            break;
+
+        case 'r':
+            seed = strtoull(optarg, 0, 10);
+            break;
+
+        case 'j':
+            thread_count = strtoul(optarg, 0, 10);
+            break;
+
+        case 'g':
+            generate_file = optarg;
+            break;
+
+        case 'Q':
+            quoted = true;
+            break;
+
+        case 'E':
+            escape = true;
+            break;
+
+        default:
+            usage(argv[0]);
+            exit(255);
+        }
+    }
+
+    if (escape) {
+        run_escape(size, string_length, escape_density, seed);
+        exit(0);
+    }
+
+    // Repeat the type mix over all columns.
+    std::vector<std::string> types;
+    std::istringstream mix_stream(mix);
+    std::string type;
+
+    while(getline(mix_stream, type, ','))
+        types.push_back(type);
+
+    if (!columns || types.empty()) {
+        usage(argv[0]);
+        exit(255);
+    }
+
+    std::vector<std::tuple<std::string, std::string> > field_spec_tuple;
+    for(std::size_t column = 0; column < columns; ++column)
+        field_spec_tuple.push_back({ "field_" + std::to_string(column), types[column % types.size()] });
+
+    csv::Specification spec(field_spec_tuple, ',', quoted?0:'\\', {}, "", quoted?'"':0);
+    csv::Generator generator(spec, seed, string_length, escape_density);
+
+    if (!generate_file.empty()) {
+        std::ofstream output(generate_file);
+
+        if (!output.is_open()) {
+            std::cout << "Could not open " << generate_file << " for writing." << std::endl;
+            exit(255);
+        }
+
+        generator.generate(output, size);
+        output.close();
+        exit(0);
+    }
+
+    // Generate the data to a temporary file.
+    char csv_file[] = "/tmp/csv_bench.XXXXXX";
+    int fd(mkstemp(csv_file));
+
+    if (fd == -1) {
+        std::cout << "Could not create " << csv_file << std::endl;
+        exit(255);
+    }
+    close(fd);
+
+    {
+        std::ofstream output(csv_file);
+        generator.generate(output, size);
+    }
+
+    std::ifstream generated(csv_file, std::ifstream::ate);
+    size = generated.tellg();
+
+    std::list<std::string> ingestion_types;
+    std::list<std::string> output_types;
+
+    csv::Factory<csv::IngestionIface>::producers(ingestion_types);
+    csv::Factory<csv::EmitterIface>::producers(output_types);
+
+    for(const auto& ingestion_type: ingestion_types) {
+        for(const auto& output_type: output_types) {
+            // 0 runs the serial convert().
+            std::vector<unsigned int> runs { 0 };
+
+            if (thread_count)
+                runs.push_back(thread_count);
+
+            for(unsigned int threads: runs) {
+                // Flush before forking, or the child inherits our buffer.
+                std::cout.flush();
+
+                pid_t pid(fork());
+                if (pid == 0) {
+                    run(spec, csv_file, size, ingestion_type, output_type, threads);
+                    exit(0);
+                }
+
+                int status(0);
+                waitpid(pid, &status, 0);
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    std::cout << "Conversion from " << ingestion_type << " to " <<
+                        output_type << " failed." << std::endl;
+                    unlink(csv_file);
+                    exit(255);
+                }
+            }
+        }
+    }
+
+    unlink(csv_file);
+    exit(0);
+}
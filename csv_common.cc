@@ -15,12 +15,30 @@
 
 // Some simple support functions
 #include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <charconv>
 #include <string>
 #include <vector>
+#include "csv_common.hh"
+#include "csv_simd.hh"
+#include "csv_tokenizer.hh"
 #include "record.hh"
+#include "record_batch.hh"
 #include "ingestion_iface.hh"
 #include "emitter_iface.hh"
+#include "bounded_queue.hh"
+#include "csv_stats.hh"
+#include "fd_stream.hh"
+#include "csv_error.hh"
 #include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
 
 namespace csv {
 
@@ -29,53 +47,329 @@ namespace csv {
     // 'separator' is the character used to delineate fields.
     // `escape` is the character used to escape the next character.
     //
-    // SLOW!
-    uint32_t tokenize_line(const std::string& line,
+    // The line is scanned with csv::find_first_of() for the next
+    // separator or escape character, and the run of plain characters
+    // leading up to it is appended to the token in a single operation.
+    //
+    uint32_t tokenize_line(const char* begin,
+                           const char* end,
                            uint8_t separator,
                            uint8_t escape,
                            std::vector<std::string>& result)
     {
-        bool escape_mode(false);
-        std::string token("");
+        CSV_STATS_TIME_SAMPLED(TOKENIZE);
+
+        // Search for the separator twice if we have no escape character.
+        uint8_t special(escape?escape:separator);
         int res(0);
 
         // Check for nil lines.
-        if (!line.length())
+        if (begin == end)
             return 0;
 
-        for(uint8_t ch: line) {
-            // Was the previous character the escape character?
+        result.emplace_back();
+
+        while(true) {
+            const char* hit(find_first_of(begin, end, separator, special));
+
+            // Add the plain characters up to the hit to the current token.
+            result.back().append(begin, hit);
+
+            if (hit == end)
+                break;
 
             // Is this an escape character?
-            // If so, switch mode and continue.
-            if (escape && ch == escape) {
-                escape_mode = true;
+            // If so, skip it, and any escape characters following it,
+            // and add the next character to the token, even if it is
+            // a separator.
+            if (escape && uint8_t(*hit) == escape) {
+                do {
+                    ++hit;
+                } while(hit != end && uint8_t(*hit) == escape);
+
+                if (hit == end)
+                    break;
+
+                result.back().push_back(*hit);
+                begin = hit + 1;
                 continue;
             }
 
-            // We are not in escape mode, and we found a separator.
-            // Wrap up the current token.
-            if (!escape_mode && ch == separator) {
-                // Push back the complete token on the result vector.
-                result.push_back(token);
+            // We found a separator.
+            // Wrap up the current token and start a new one.
+            result.emplace_back();
+            res++;
+            begin = hit + 1;
+        }
+
+        // Return number of tokens.
+        return res + 1;
+    }
+
+    uint32_t tokenize_line(const std::string& line,
+                           uint8_t separator,
+                           uint8_t escape,
+                           std::vector<std::string>& result)
+    {
+        return tokenize_line(line.data(), line.data() + line.length(),
+                             separator, escape, result);
+    }
+
+    uint32_t tokenize_line(std::string_view line,
+                           uint8_t separator,
+                           uint8_t escape,
+                           std::vector<std::string_view>& result,
+                           std::string& buffer)
+    {
+        CSV_STATS_TIME_SAMPLED(TOKENIZE);
+        const char* begin(line.data());
+        const char* end(begin + line.length());
+        uint8_t special(escape?escape:separator);
+        bool buffer_used(false);
+        uint32_t res(0);
+
+        // Check for nil lines.
+        if (begin == end)
+            return 0;
+
+        while(true) {
+            const char* hit(find_first_of(begin, end, separator, special));
 
-                token.resize(0); // Reset the token.
+            // Fast path. The field has no escape characters
+            // and can be referenced directly in the line.
+            if (hit == end || !escape || uint8_t(*hit) != escape) {
+                result.emplace_back(begin, hit - begin);
                 res++;
+
+                if (hit == end)
+                    break;
+
+                begin = hit + 1;
                 continue;
             }
 
-            // We are either in escape mode, accepting any character,
-            // and/or we have found a non-separator character.
-            // Add it to the current token.
-            token.push_back(ch);
-            escape_mode = false;
+            // The field has escape characters. Build an unescaped copy
+            // of it in the buffer. Unescaped data is never longer than
+            // the line, so reserving the line length up front ensures that
+            // views of earlier fields in the buffer remain valid.
+            if (!buffer_used) {
+                buffer.clear();
+                if (buffer.capacity() < line.length())
+                    buffer.reserve(line.length());
+
+                buffer_used = true;
+            }
+
+            std::size_t field_start(buffer.length());
+
+            while(true) {
+                buffer.append(begin, hit);
+
+                if (hit == end || !escape || uint8_t(*hit) != escape)
+                    break;
+
+                // Skip the escape characters, and add the next character
+                // even if it is a separator.
+                do {
+                    ++hit;
+                } while(hit != end && uint8_t(*hit) == escape);
+
+                if (hit == end)
+                    break;
+
+                buffer.push_back(*hit);
+                begin = hit + 1;
+                hit = find_first_of(begin, end, separator, special);
+            }
+
+            result.emplace_back(buffer.data() + field_start, buffer.length() - field_start);
+            res++;
+
+            if (hit == end)
+                break;
+
+            begin = hit + 1;
+        }
+
+        // Return number of tokens.
+        return res;
+    }
+
+    //
+    // Helper functions for numeric parsing. Not visible to the outside.
+    //
+
+    // Strip out leading and trailing white spaces.
+    static std::string_view strip_whitespaces(std::string_view str)
+    {
+        const char* begin(str.data());
+        const char* end(begin + str.length());
+
+        while(begin != end && (*begin == ' ' || *begin == '\t'))
+            ++begin;
+
+        while(end != begin && (end[-1] == ' ' || end[-1] == '\t'))
+            --end;
+
+        return std::string_view(begin, end - begin);
+    }
+
+    // strtoll() and strtod() skip any leading white space,
+    // not only the spaces and tabs removed by strip_whitespaces().
+    static const char* skip_space(const char* begin, const char* end)
+    {
+        while(begin != end && (*begin == ' ' || (*begin >= '\t' && *begin <= '\r')))
+            ++begin;
+
+        return begin;
+    }
+
+    //
+    // Copy a token into a null terminated buffer, as expected by
+    // strtod(). Tokens fitting the stack buffer are
+    // copied without any heap allocation.
+    //
+    class TerminatedToken {
+    public:
+        TerminatedToken(std::string_view token)
+        {
+            if (token.length() < sizeof(stack_buf_)) {
+                memcpy(stack_buf_, token.data(), token.length());
+                stack_buf_[token.length()] = 0;
+                data_ = stack_buf_;
+                return;
+            }
+            heap_buf_.assign(token);
+            data_ = heap_buf_.c_str();
+        }
+
+        const char* c_str(void) const { return data_; }
+
+    private:
+        char stack_buf_[64];
+        std::string heap_buf_;
+        const char* data_;
+    };
+
+    // Parse integers in place with std::from_chars(), which is
+    // locale independent and needs no null terminated copy.
+    // Sign and base prefix are handled here to match strtoll() with base 0.
+    bool parse_int64(std::string_view token, int64_t& value)
+    {
+        std::string_view data { strip_whitespaces(token) };
+        const char* cur(skip_space(data.data(), data.data() + data.length()));
+        const char* end(data.data() + data.length());
+        bool negative(false);
+        uint64_t magnitude(0);
+        int base(10);
+
+        // An empty token is parsed as 0, just like strtoll() does.
+        if (cur == end) {
+            value = 0;
+            return true;
         }
 
-        // Push back the final token
-        result.push_back(token);
+        if (*cur == '-' || *cur == '+') {
+            negative = (*cur == '-');
+            ++cur;
+        }
 
-        // Return nu,ber of tokens.
-        return res + 1;
+        // Base prefix.
+        if (end - cur >= 2 && cur[0] == '0' && (cur[1] == 'x' || cur[1] == 'X')) {
+            base = 16;
+            cur += 2;
+        } else if (cur != end && cur[0] == '0')
+            base = 8;
+
+        auto [ptr, ec] = std::from_chars(cur, end, magnitude, base);
+
+        if (ptr != end || ec == std::errc::invalid_argument)
+            return false;
+
+        // Saturate out of range values, just like strtoll() does.
+        if (ec == std::errc::result_out_of_range)
+            magnitude = ~uint64_t(0);
+
+        if (negative)
+            value = (magnitude >= uint64_t(INT64_MAX) + 1)?INT64_MIN:-int64_t(magnitude);
+        else
+            value = (magnitude > uint64_t(INT64_MAX))?INT64_MAX:int64_t(magnitude);
+
+        return true;
+    }
+
+    // Parse doubles in place with std::from_chars(), which is
+    // locale independent, needs no null terminated copy,
+    // and is considerably faster than strtod().
+    bool parse_double(std::string_view token, double& value)
+    {
+        std::string_view data { strip_whitespaces(token) };
+        const char* cur(skip_space(data.data(), data.data() + data.length()));
+        const char* end(data.data() + data.length());
+        std::chars_format format(std::chars_format::general);
+        bool negative(false);
+
+        // An empty token is parsed as 0.0, just like strtod() does.
+        if (cur == end) {
+            value = 0.0;
+            return true;
+        }
+
+        // std::from_chars() does not accept a leading '+'.
+        // Handle the sign here.
+        if (*cur == '-' || *cur == '+') {
+            negative = (*cur == '-');
+            ++cur;
+
+            if (cur != end && (*cur == '-' || *cur == '+'))
+                return false;
+        }
+
+        // std::from_chars() does not accept a hexadecimal prefix.
+        if (end - cur >= 2 && cur[0] == '0' && (cur[1] == 'x' || cur[1] == 'X')) {
+            format = std::chars_format::hex;
+            cur += 2;
+        }
+
+        auto [ptr, ec] = std::from_chars(cur, end, value, format);
+
+        if (ptr != end || ec == std::errc::invalid_argument)
+            return false;
+
+        // Let strtod() produce the same overflow and underflow
+        // values as before. This is the slow, rare, path.
+        if (ec == std::errc::result_out_of_range) {
+            TerminatedToken copy { data };
+            value = strtod(copy.c_str(), nullptr);
+            return true;
+        }
+
+        if (negative)
+            value = -value;
+
+        return true;
+    }
+
+    const char* find_record_end(const char* begin,
+                                const char* end,
+                                uint8_t escape)
+    {
+        const char* cur(begin);
+
+        while(cur != end) {
+            const char* nl = static_cast<const char*>(memchr(cur, '\n', end - cur));
+
+            if (!nl)
+                return end;
+
+            // Is the newline escaped? If so, it is part of the record.
+            if (escape && nl != begin && uint8_t(nl[-1]) == escape) {
+                cur = nl + 1;
+                continue;
+            }
+            return nl;
+        }
+        return end;
     }
 
     uint32_t convert(const csv::Specification& specification,
@@ -87,6 +381,20 @@ namespace csv {
         uint32_t record_index(0);
 
         emitter.begin(output, "", specification);
+
+        // Move records batch by batch if both sides support it.
+        if (ingester.has_native_batch() && emitter.has_native_batch()) {
+            RecordBatch batch(specification);
+
+            while(ingester.ingest_batch(input, specification, record_index, batch)) {
+                emitter.emit_batch(output, specification, batch);
+                record_index += batch.size();
+            }
+
+            emitter.end(output, specification);
+            return record_index;
+        }
+
         while(auto record = ingester.ingest_record(input, specification, record_index)) {
             emitter.emit_record(output, specification, *record);
             ++record_index;
@@ -95,4 +403,759 @@ namespace csv {
         emitter.end(output, specification);
         return record_index;
     }
+
+    //
+    // Helper functions for the parallel convert(). Not visible to the outside.
+    //
+
+    // Return the start of the first record beginning at or after
+    // 'position', i.e. the character after the first unescaped
+    // newline at or after position - 1.
+    static const char* next_record_start(const char* data,
+                                         const char* position,
+                                         const char* end,
+                                         uint8_t escape)
+    {
+        if (position == data)
+            return data;
+
+        const char* cur(position - 1);
+
+        while(cur != end) {
+            const char* nl = static_cast<const char*>(memchr(cur, '\n', end - cur));
+
+            if (!nl)
+                return end;
+
+            if (!escape || nl == data || uint8_t(nl[-1]) != escape)
+                return nl + 1;
+
+            cur = nl + 1;
+        }
+        return end;
+    }
+
+    // Add the tokens of a line to 'batch' if the filter accepts them.
+    // Returns false, with 'error' set, if the line cannot be filtered
+    // or converted.
+    static bool add_record(const csv::Specification& specification,
+                           const std::vector<std::string_view>& fields,
+                           csv::RecordBatch& batch,
+                           std::string& error)
+    {
+        if (!specification.accept(fields, error))
+            return error.empty();
+
+        return batch.append(fields, error);
+    }
+
+    // Parse all records in the range 'begin' - 'end' into 'batch'.
+    // Records that cannot be parsed are added to 'errors', with line
+    // numbers relative to 'begin'. Returns the number of lines parsed,
+    // counting the quoted and escaped newlines within records.
+    static std::size_t parse_chunk(const csv::Specification& specification,
+                                   const char* begin,
+                                   const char* end,
+                                   csv::RecordBatch& batch,
+                                   std::vector<csv::RecordError>& errors)
+    {
+        std::vector<std::string_view> fields;
+        std::string buffer;
+        std::string error;
+        std::size_t line(0);
+        std::size_t next_line(1);
+
+        CSV_STATS_ADD(BYTES_READ, end - begin);
+
+        // Quoted records are located and tokenized in a single pass
+        // over the index of the chunk.
+        if (specification.quote_char()) {
+            StructuralTokenizer tokenizer(specification.separator_char(),
+                                          specification.escape_char(),
+                                          specification.quote_char());
+
+            tokenizer.reset(begin, end);
+            while(!tokenizer.done()) {
+                std::string_view text;
+                uint32_t field_count(0);
+
+                CSV_STATS_ADD(LINES, 1);
+
+                fields.clear();
+                field_count = tokenizer.next(fields, buffer, text);
+                line = next_line;
+                next_line += record_line_count(text);
+
+                if (field_count != specification.input_field_count()) {
+                    errors.push_back({ line, field_count_error(specification, field_count), std::string(text) });
+                    continue;
+                }
+
+                if (!add_record(specification, fields, batch, error))
+                    errors.push_back({ line, error, std::string(text) });
+            }
+            return next_line - 1;
+        }
+
+        while(begin != end) {
+            const char* record_end(nullptr);
+            uint32_t field_count(0);
+
+            {
+                CSV_STATS_TIME_SAMPLED(READ);
+                record_end = find_record_end(begin, end, specification.escape_char());
+            }
+            CSV_STATS_ADD(LINES, 1);
+
+            std::string_view text(begin, record_end - begin);
+            begin = (record_end == end)?end:(record_end + 1);
+
+            // Only escaped newlines make a record span several lines.
+            line = next_line;
+            next_line += specification.escape_char()?record_line_count(text):1;
+
+            fields.clear();
+            field_count = tokenize_line(text,
+                                        specification.separator_char(),
+                                        specification.escape_char(),
+                                        fields,
+                                        buffer);
+
+            if (field_count != specification.input_field_count()) {
+                errors.push_back({ line, field_count_error(specification, field_count), std::string(text) });
+                continue;
+            }
+
+            if (!add_record(specification, fields, batch, error))
+                errors.push_back({ line, error, std::string(text) });
+        }
+        return next_line - 1;
+    }
+
+    // Split 'data' into ranges of roughly 'chunk_size' bytes, with
+    // each boundary snapped to the start of the next record. Returns
+    // the start of each range, followed by the end of the data.
+    static std::vector<const char*> split_chunks(const csv::Specification& specification,
+                                                 const char* data,
+                                                 std::size_t size,
+                                                 std::size_t chunk_size)
+    {
+        const char* end(data + size);
+        std::vector<const char*> bounds;
+
+        bounds.push_back(data);
+
+        // Whether a newline ends a record depends on the quotes before
+        // it, so the state is carried from the start of the data.
+        if (specification.quote_char()) {
+            const StructuralChars chars { uint8_t(specification.separator_char()),
+                                          uint8_t(specification.escape_char()),
+                                          uint8_t(specification.quote_char()) };
+            StructuralState state;
+
+            for(std::size_t offset = chunk_size; offset < size; offset += chunk_size) {
+                const char* position(data + offset);
+
+                if (position <= bounds.back())
+                    continue;
+
+                scan_structure(bounds.back(), position, chars, state);
+
+                const char* record_end(find_record_end(position, end, chars, state));
+
+                if (record_end == end || record_end + 1 == end)
+                    break;
+
+                bounds.push_back(record_end + 1);
+            }
+            bounds.push_back(end);
+            return bounds;
+        }
+
+        for(std::size_t offset = chunk_size; offset < size; offset += chunk_size) {
+            const char* start(next_record_start(data, data + offset, end, specification.escape_char()));
+
+            if (start > bounds.back() && start < end)
+                bounds.push_back(start);
+        }
+        bounds.push_back(end);
+        return bounds;
+    }
+
+    uint32_t convert(const csv::Specification& specification,
+                     const char* data,
+                     std::size_t size,
+                     EmitterIface& emitter,
+                     std::ostream& output,
+                     unsigned int thread_count,
+                     std::size_t chunk_size,
+                     ErrorHandler* errors)
+    {
+        // A chunk slot, used by one chunk at a time.
+        struct Slot {
+            Slot(const csv::Specification& specification):
+                batch(specification)
+            {}
+
+            csv::RecordBatch batch;
+
+            // The batch formatted by the worker, if the emitter supports it.
+            std::string text;
+
+            // Records that could not be parsed, and the number of lines in the chunk.
+            std::vector<RecordError> errors;
+            std::size_t line_count { 0 };
+            bool ready { false };
+        };
+
+        std::vector<const char*> bounds;
+        std::size_t chunk_count(0);
+        std::size_t window(0);
+        std::size_t next_chunk(0);
+        std::size_t emitted(0);
+        uint32_t record_index(0);
+        std::size_t line_index(0);
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::vector<std::thread> workers;
+        const bool parallel_format(emitter.has_parallel_format());
+        ErrorHandler& error_handler(errors?*errors:ErrorHandler::fail());
+
+        if (thread_count == 0)
+            thread_count = 1;
+
+        if (chunk_size == 0)
+            chunk_size = default_chunk_size;
+
+        bounds = split_chunks(specification, data, size, chunk_size);
+        chunk_count = bounds.size() - 1;
+
+        // Allow workers to run a bit ahead of the emitter while
+        // bounding the number of parsed, but not yet emitted, records.
+        window = 2 * thread_count;
+        std::vector<Slot> slots;
+
+        slots.reserve(window);
+        for(std::size_t i = 0; i < window; ++i)
+            slots.emplace_back(specification);
+
+        auto worker = [&](void) {
+            while(true) {
+                std::size_t chunk(0);
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+
+                    cond.wait(lock, [&] {
+                        return next_chunk >= chunk_count || next_chunk < emitted + window;
+                    });
+
+                    if (next_chunk >= chunk_count)
+                        return;
+
+                    chunk = next_chunk++;
+                }
+
+                // The slot was released by the emitter before 'chunk'
+                // could be handed out. We have exclusive access to it.
+                Slot& slot(slots[chunk % window]);
+                slot.line_count = parse_chunk(specification, bounds[chunk], bounds[chunk + 1],
+                                              slot.batch, slot.errors);
+
+                if (parallel_format)
+                    emitter.format_batch(slot.text, specification, slot.batch);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slot.ready = true;
+                }
+                cond.notify_all();
+            }
+        };
+
+        for(unsigned int i = 0; i < thread_count; ++i)
+            workers.emplace_back(worker);
+
+        emitter.begin(output, "", specification);
+
+        // Emit the chunks in their original order.
+        for(std::size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            Slot& slot(slots[chunk % window]);
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&] { return slot.ready; });
+            }
+
+            // Report failed records in input order.
+            for(const auto& error: slot.errors)
+                error_handler.report(error, line_index + 1);
+            line_index += slot.line_count;
+
+            // The chunk's records follow those already emitted.
+            slot.batch.set_first_index(record_index);
+            if (parallel_format)
+                emitter.emit_formatted(output, specification, slot.text);
+            else
+                emitter.emit_batch(output, specification, slot.batch);
+            record_index += slot.batch.size();
+
+            slot.batch.clear();
+            slot.text.clear();
+            slot.errors.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slot.ready = false;
+                emitted = chunk + 1;
+            }
+            cond.notify_all();
+        }
+
+        for(auto& thr: workers)
+            thr.join();
+
+        emitter.end(output, specification);
+        return record_index;
+    }
+
+    uint32_t convert(const csv::Specification& specification,
+                     const char* data,
+                     std::size_t size,
+                     EmitterIface& emitter,
+                     int output_fd,
+                     unsigned int thread_count,
+                     std::size_t chunk_size,
+                     ErrorHandler* errors)
+    {
+        FdStreamBuf output_buffer(output_fd);
+        std::ostream output(&output_buffer);
+
+        // Batches have to be written in order through a stream.
+        if (!emitter.has_parallel_format() || !supports_write_at(output_fd)) {
+            uint32_t record_count(convert(specification, data, size, emitter, output,
+                                          thread_count, chunk_size, errors));
+            output.flush();
+            return record_count;
+        }
+
+        std::vector<const char*> bounds;
+        std::size_t chunk_count(0);
+        std::size_t next_chunk(0);
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::vector<std::thread> workers;
+        bool failed(false);
+        int write_error(0);
+        ErrorHandler& error_handler(errors?*errors:ErrorHandler::fail());
+
+        if (thread_count == 0)
+            thread_count = 1;
+
+        if (chunk_size == 0)
+            chunk_size = default_chunk_size;
+
+        bounds = split_chunks(specification, data, size, chunk_size);
+        chunk_count = bounds.size() - 1;
+
+        // Formatted size and record count of each chunk, and the
+        // output offset of each chunk, known once all chunks before
+        // it have been formatted.
+        std::vector<std::size_t> text_sizes(chunk_count, 0);
+        std::vector<uint32_t> record_counts(chunk_count, 0);
+        std::vector<bool> formatted(chunk_count, false);
+        std::vector<std::size_t> offsets(chunk_count + 1, 0);
+        std::size_t offset_count(0);
+
+        // Records that could not be parsed, and the number of lines,
+        // of each chunk. Reported in order along with the prefix sum.
+        std::vector<std::vector<RecordError>> chunk_errors(chunk_count);
+        std::vector<std::size_t> line_counts(chunk_count, 0);
+        std::size_t line_index(0);
+
+        emitter.begin(output, "", specification);
+        output.flush();
+
+        // Chunks are written after anything already in the file.
+        off_t start(lseek(output_fd, 0, SEEK_CUR));
+        offsets[0] = (start > 0)?start:0;
+
+        auto worker = [&](void) {
+            csv::RecordBatch batch(specification);
+            std::string text;
+
+            while(true) {
+                std::size_t chunk(0);
+                std::size_t offset(0);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if (next_chunk >= chunk_count || failed)
+                        return;
+
+                    chunk = next_chunk++;
+                }
+
+                batch.clear();
+                text.clear();
+                line_counts[chunk] = parse_chunk(specification, bounds[chunk], bounds[chunk + 1],
+                                                 batch, chunk_errors[chunk]);
+                emitter.format_batch(text, specification, batch);
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+
+                    text_sizes[chunk] = text.length();
+                    record_counts[chunk] = batch.size();
+                    formatted[chunk] = true;
+
+                    // Extend the prefix sum of the formatted sizes
+                    // over all consecutive formatted chunks.
+                    while(offset_count < chunk_count && formatted[offset_count]) {
+                        offsets[offset_count + 1] = offsets[offset_count] + text_sizes[offset_count];
+
+                        for(const auto& error: chunk_errors[offset_count])
+                            error_handler.report(error, line_index + 1);
+                        line_index += line_counts[offset_count];
+                        ++offset_count;
+                    }
+                    cond.notify_all();
+
+                    // Chunks are handed out in order, so the chunks
+                    // before this one are all being formatted.
+                    cond.wait(lock, [&] { return offset_count > chunk || failed; });
+
+                    // Another worker failed to write. This chunk's
+                    // offset may never be known, so it is not written.
+                    if (offset_count <= chunk)
+                        return;
+
+                    offset = offsets[chunk];
+                }
+
+                CSV_STATS_ADD(BYTES_WRITTEN, text.length());
+                if (!write_at(output_fd, text.data(), text.length(), offset)) {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    write_error = errno;
+                    failed = true;
+                    cond.notify_all();
+                    return;
+                }
+            }
+        };
+
+        for(unsigned int i = 0; i < thread_count; ++i)
+            workers.emplace_back(worker);
+
+        for(auto& thr: workers)
+            thr.join();
+
+        if (failed) {
+            std::cerr << "convert(): Could not write output: " << strerror(write_error) << std::endl;
+            exit(255);
+        }
+
+        // Continue after the last chunk.
+        lseek(output_fd, offsets[chunk_count], SEEK_SET);
+        emitter.end(output, specification);
+        output.flush();
+
+        uint32_t record_count(0);
+        for(uint32_t count: record_counts)
+            record_count += count;
+
+        return record_count;
+    }
+
+    //
+    // Helper functions for the pipelined convert(). Not visible to the outside.
+    //
+
+    // Wait before retrying a queue operation that failed.
+    // Spins briefly, then yields, and finally sleeps, so that
+    // threads stalled by a slower stage do not burn CPU.
+    static void backoff(unsigned int& attempts)
+    {
+        if (attempts < 16) {
+            ++attempts;
+            return;
+        }
+
+        if (attempts < 64) {
+            ++attempts;
+            std::this_thread::yield();
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    // Return the index of the last unescaped and unquoted newline in
+    // 'data' at or after 'from', or std::string::npos if there is none.
+    // 'data' starts at the start of a record.
+    static std::size_t last_record_end(const std::string& data,
+                                       std::size_t from,
+                                       const StructuralChars& chars)
+    {
+        if (chars.quote) {
+            constexpr std::size_t window_size = 32*1024;
+            StructuralState state;
+            std::vector<uint32_t> positions(std::min(data.length(), window_size));
+            std::size_t result(std::string::npos);
+
+            // Index all of the data, keeping the last newline.
+            for(std::size_t window = 0; window < data.length(); window += window_size) {
+                std::size_t window_end(std::min(data.length(), window + window_size));
+                std::size_t count(index_structure(data.data() + window, data.data() + window_end,
+                                                  chars, state, positions.data()));
+
+                while(count--) {
+                    if (positions[count] & structural_newline) {
+                        result = window + (positions[count] & structural_offset_mask);
+                        break;
+                    }
+                }
+            }
+            return (result != std::string::npos && result >= from)?result:std::string::npos;
+        }
+
+        uint8_t escape(chars.escape);
+        std::size_t position(data.length());
+
+        while(position > from) {
+            position = data.rfind('\n', position - 1);
+
+            if (position == std::string::npos || position < from)
+                return std::string::npos;
+
+            if (!escape || position == 0 || uint8_t(data[position - 1]) != escape)
+                return position;
+        }
+        return std::string::npos;
+    }
+
+    uint32_t convert(const csv::Specification& specification,
+                     std::istream& input,
+                     EmitterIface& emitter,
+                     std::ostream& output,
+                     unsigned int thread_count,
+                     std::size_t queue_depth,
+                     std::size_t block_size,
+                     ErrorHandler* errors)
+    {
+        // A block of whole records, and the batch it is parsed into.
+        struct Block {
+            Block(const csv::Specification& specification):
+                batch(specification)
+            {}
+
+            std::string data;
+            std::size_t sequence { 0 };
+            csv::RecordBatch batch;
+
+            // The batch formatted by the worker, if the emitter supports it.
+            std::string text;
+
+            // Records that could not be parsed, and the number of lines in the block.
+            std::vector<RecordError> errors;
+            std::size_t line_count { 0 };
+        };
+
+        if (thread_count == 0)
+            thread_count = 1;
+
+        if (queue_depth == 0)
+            queue_depth = 2 * thread_count + 2;
+
+        // At least one block being filled while another is emitted.
+        if (queue_depth < 2)
+            queue_depth = 2;
+
+        if (block_size == 0)
+            block_size = default_chunk_size;
+
+        // All blocks are created up front. Each queue can hold every
+        // block, so a push only fails while another thread is
+        // momentarily holding a cell.
+        std::vector<std::unique_ptr<Block>> blocks;
+        BoundedQueue<Block*> free_blocks(queue_depth);
+        BoundedQueue<Block*> read_blocks(queue_depth);
+        BoundedQueue<Block*> parsed_blocks(queue_depth);
+        std::atomic<bool> reader_done(false);
+        std::atomic<std::size_t> block_count(0);
+        std::vector<std::thread> workers;
+        uint32_t record_index(0);
+        std::size_t line_index(0);
+        const bool parallel_format(emitter.has_parallel_format());
+        ErrorHandler& error_handler(errors?*errors:ErrorHandler::fail());
+
+        blocks.reserve(queue_depth);
+        for(std::size_t i = 0; i < queue_depth; ++i) {
+            blocks.emplace_back(new Block(specification));
+            free_blocks.try_push(blocks.back().get());
+        }
+
+        //
+        // Stage 1: Read blocks of whole records.
+        //
+        const StructuralChars chars { uint8_t(specification.separator_char()),
+                                      uint8_t(specification.escape_char()),
+                                      uint8_t(specification.quote_char()) };
+
+        auto reader = [&](void) {
+            std::string carry("");
+            std::size_t sequence(0);
+            bool eof(false);
+
+            while(!eof) {
+                Block* block(nullptr);
+                unsigned int attempts(0);
+
+                // Wait for the emitter to release a block.
+                while(!free_blocks.try_pop(block))
+                    backoff(attempts);
+
+                // Start with the partial record left by the previous block.
+                block->data.swap(carry);
+                carry.clear();
+
+                // Read until the block holds at least one complete
+                // record, or the input is exhausted.
+                while(true) {
+                    std::size_t length(block->data.length());
+                    std::size_t record_end(std::string::npos);
+
+                    block->data.resize(length + block_size);
+                    {
+                        CSV_STATS_TIME(READ);
+                        input.read(&block->data[length], block_size);
+                    }
+                    block->data.resize(length + input.gcount());
+
+                    if (!input) {
+                        eof = true;
+                        break;
+                    }
+
+                    record_end = last_record_end(block->data, length, chars);
+                    if (record_end != std::string::npos) {
+                        carry.assign(block->data, record_end + 1, std::string::npos);
+                        block->data.resize(record_end + 1);
+                        break;
+                    }
+                }
+
+                if (block->data.empty()) {
+                    free_blocks.try_push(block);
+                    break;
+                }
+
+                block->sequence = sequence++;
+
+                while(!read_blocks.try_push(block))
+                    backoff(attempts);
+            }
+
+            block_count.store(sequence, std::memory_order_relaxed);
+            reader_done.store(true, std::memory_order_release);
+        };
+
+        //
+        // Stage 2: Parse blocks into batches.
+        //
+        auto worker = [&](void) {
+            unsigned int attempts(0);
+
+            while(true) {
+                Block* block(nullptr);
+
+                if (!read_blocks.try_pop(block)) {
+                    // All blocks are pushed before reader_done is set.
+                    if (!reader_done.load(std::memory_order_acquire)) {
+                        backoff(attempts);
+                        continue;
+                    }
+
+                    if (!read_blocks.try_pop(block))
+                        return;
+                }
+                attempts = 0;
+
+                block->batch.clear();
+                block->errors.clear();
+                block->line_count = parse_chunk(specification,
+                                                block->data.data(),
+                                                block->data.data() + block->data.length(),
+                                                block->batch,
+                                                block->errors);
+
+                if (parallel_format) {
+                    block->text.clear();
+                    emitter.format_batch(block->text, specification, block->batch);
+                }
+
+                while(!parsed_blocks.try_push(block))
+                    backoff(attempts);
+            }
+        };
+
+        std::thread reader_thread(reader);
+
+        for(unsigned int i = 0; i < thread_count; ++i)
+            workers.emplace_back(worker);
+
+        //
+        // Stage 3: Emit batches in their original order.
+        //
+        // Since at most queue_depth blocks are in flight, all
+        // parsed blocks waiting to be emitted have a sequence number
+        // in the range [next_sequence, next_sequence + queue_depth).
+        //
+        std::vector<Block*> pending(queue_depth, nullptr);
+        std::size_t next_sequence(0);
+        unsigned int attempts(0);
+
+        emitter.begin(output, "", specification);
+
+        while(!reader_done.load(std::memory_order_acquire) ||
+              next_sequence < block_count.load(std::memory_order_relaxed)) {
+            Block* block(nullptr);
+
+            if (!parsed_blocks.try_pop(block)) {
+                backoff(attempts);
+                continue;
+            }
+            attempts = 0;
+            pending[block->sequence % queue_depth] = block;
+
+            while((block = pending[next_sequence % queue_depth])) {
+                pending[next_sequence % queue_depth] = nullptr;
+
+                // Report failed records in input order.
+                for(const auto& error: block->errors)
+                    error_handler.report(error, line_index + 1);
+                line_index += block->line_count;
+
+                // The block's records follow those already emitted.
+                block->batch.set_first_index(record_index);
+                if (parallel_format)
+                    emitter.emit_formatted(output, specification, block->text);
+                else
+                    emitter.emit_batch(output, specification, block->batch);
+                record_index += block->batch.size();
+                ++next_sequence;
+
+                while(!free_blocks.try_push(block))
+                    backoff(attempts);
+            }
+        }
+
+        reader_thread.join();
+        for(auto& thr: workers)
+            thr.join();
+
+        emitter.end(output, specification);
+        return record_index;
+    }
 }
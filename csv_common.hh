@@ -17,6 +17,10 @@
 #define __CSV_COMMON_HH__
 #include <iostream>
 #include <fstream>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace csv {
     /// Extract fields from a single line.
@@ -44,9 +48,117 @@ namespace csv {
                                   uint8_t escape,
                                   std::vector<std::string>& result);
 
+    /// Extract fields from a single line held in a memory range.
+    //
+    /// Identical to tokenize_line(const std::string&, ...), but
+    /// operates directly on the bytes between \a begin and \a end,
+    /// allowing a line to be tokenized in place in a memory mapped file
+    /// without first being copied into a string.
+    ///
+    /// @param begin Pointer to the first character of the line.
+    /// @param end Pointer to the character after the last character of the line.
+    /// @param separator The separator character to use.
+    /// @param escape The escape character to use.
+    /// @param result The string vector to add fields to.
+    ///
+    /// @return The number of fields added to \a result.
+    ///
+    extern uint32_t tokenize_line(const char* begin,
+                                  const char* end,
+                                  uint8_t separator,
+                                  uint8_t escape,
+                                  std::vector<std::string>& result);
+
+    /// Extract fields from a single line without copying them.
+    //
+    /// This function provides the same tokenization as
+    /// tokenize_line(const std::string&, ...), but adds a view of
+    /// each field to \a result instead of a newly created string.
+    ///
+    /// Fields without any escape characters are returned as views
+    /// directly into \a line. Fields containing escape characters
+    /// have their unescaped data written to \a buffer, and are
+    /// returned as views into it.
+    ///
+    /// \a buffer is cleared when the first escaped field of \a line
+    /// is encountered. Its capacity is retained between calls, so
+    /// that a reused buffer and result vector will, once grown, not
+    /// need any further heap allocations.
+    ///
+    /// The returned views are valid until \a line, or \a buffer, is
+    /// modified or destroyed.
+    ///
+    /// @param line The line to separate into fields.
+    /// @param separator The separator character to use.
+    /// @param escape The escape character to use. 0 if no escape character is used.
+    /// @param result The vector to add field views to. \
+    ///               Fields will be added after any existing elements in the vector.
+    /// @param buffer Caller owned storage for unescaped field data.
+    ///
+    /// @return The number of fields added to \a result.
+    ///
+    extern uint32_t tokenize_line(std::string_view line,
+                                  uint8_t separator,
+                                  uint8_t escape,
+                                  std::vector<std::string_view>& result,
+                                  std::string& buffer);
+
+    /// Parse an integer field.
+    //
+    /// White-spaces before and after the value in \a token are
+    /// ignored. The value is parsed with the same rules as strtoll()
+    /// with base 0, i.e. \c 0x prefixed hexadecimal and \c 0 prefixed
+    /// octal values are accepted. An empty token is parsed as 0.
+    ///
+    /// The token is parsed in place, without copying or locale lookups.
+    ///
+    /// @param token The field data to parse.
+    /// @param value The variable to store the parsed value in.
+    ///
+    /// @return true - \a token was parsed and stored in \a value.
+    /// @return false - \a token is not an integer.
+    ///
+    extern bool parse_int64(std::string_view token, int64_t& value);
+
+    /// Parse a double field.
+    //
+    /// White-spaces before and after the value in \a token are
+    /// ignored. The value is parsed with the same rules as strtod()
+    /// in the "C" locale. An empty token is parsed as 0.0.
+    ///
+    /// The token is parsed in place, without copying or locale lookups.
+    ///
+    /// @param token The field data to parse.
+    /// @param value The variable to store the parsed value in.
+    ///
+    /// @return true - \a token was parsed and stored in \a value.
+    /// @return false - \a token is not a double.
+    ///
+    extern bool parse_double(std::string_view token, double& value);
+
+    /// Find the end of the record starting at \a begin.
+    //
+    /// Searches for the first newline in the range \a begin - \a end
+    /// that is not escaped, i.e. not directly preceded by the
+    /// character specified by \a escape.
+    ///
+    /// An escaped newline is considered field data, in the same way
+    /// that tokenize_line() treats an escaped separator as field data.
+    ///
+    /// @param begin Pointer to the first character of the record.
+    /// @param end Pointer to the end of the data to search.
+    /// @param escape The escape character to use. 0 if no escape character is used.
+    ///
+    /// @return Pointer to the terminating newline, or \a end if none was found.
+    ///
+    extern const char* find_record_end(const char* begin,
+                                       const char* end,
+                                       uint8_t escape);
+
     class IngestionIface;
     class EmitterIface;
     class Specification;
+    class ErrorHandler;
 
     /// Convert all records from an input stream to a new format.
     //
@@ -73,6 +185,11 @@ namespace csv {
     /// emitter.end();
     /// \endcode
     ///
+    /// If both \a ingester and \a emitter implement batches natively,
+    /// records are moved from one to the other in csv::RecordBatch
+    /// objects through IngestionIface::ingest_batch() and
+    /// EmitterIface::emit_batch() instead.
+    ///
     /// @param specification The specification of the records read from \a input.
     /// @param ingester The ingestion instance to use to read data from \a input.
     /// @param input The input data stream to read records from.
@@ -86,5 +203,138 @@ namespace csv {
                             std::istream& input,
                             csv::EmitterIface& emitter,
                             std::ostream& output);
+
+    /// Default target size, in bytes, of each chunk parsed by convert() in parallel mode.
+    constexpr std::size_t default_chunk_size = 4*1024*1024;
+
+    /// Convert all CSV records in a memory range using multiple threads.
+    //
+    /// This function provides the same functionality as the
+    /// stream-based convert(), but parses the CSV data held in
+    /// the memory range \a data - \a data + \a size in parallel.
+    ///
+    /// The memory range, typically a file mapped by csv::MappedFile,
+    /// is split into byte ranges of roughly \a chunk_size bytes. Each
+    /// range boundary is moved forward to the start of the next record,
+    /// i.e. past the next newline that is not escaped by
+    /// specification.escape_char().
+    ///
+    /// The ranges are parsed into csv::RecordBatch objects by
+    /// \a thread_count worker threads, using the same rules as
+    /// csv::IngestionCSVMMap. The batches are handed to
+    /// EmitterIface::emit_batch() in their original order, with correct
+    /// record indexes, producing output identical to a serial
+    /// conversion.
+    ///
+    /// Records that cannot be parsed are collected by the workers,
+    /// and reported to \a errors with their line numbers in input
+    /// order as the batches are emitted.
+    ///
+    /// @param specification The specification of the records in \a data.
+    /// @param data Pointer to the first byte of CSV data.
+    /// @param size The number of bytes of CSV data.
+    /// @param emitter The emitter instance to use to write data to \a output
+    /// @param output The output data stream to write converted records to.
+    /// @param thread_count The number of worker threads to parse records with.
+    /// @param chunk_size The target size, in bytes, of each parsed range.
+    /// @param errors The handler of records that cannot be parsed.
+    ///        NULL selects csv::ErrorHandler::fail().
+    ///
+    /// @return The number of records converted.
+    ///
+    extern uint32_t convert(const csv::Specification& specification,
+                            const char* data,
+                            std::size_t size,
+                            csv::EmitterIface& emitter,
+                            std::ostream& output,
+                            unsigned int thread_count,
+                            std::size_t chunk_size = default_chunk_size,
+                            csv::ErrorHandler* errors = nullptr);
+
+    /// Convert all CSV records in a memory range to a file, writing in parallel.
+    //
+    /// This function provides the same functionality as the
+    /// memory range convert(), but each worker thread also formats
+    /// the records of the range it parsed with
+    /// EmitterIface::format_batch(), and writes them straight to
+    /// \a output_fd with csv::write_at().
+    ///
+    /// The position of each range in the output is the sum of the
+    /// formatted sizes of the ranges before it. A worker thus waits,
+    /// after formatting, only until the ranges before its own have
+    /// been formatted, and not until they have been written. The
+    /// output is identical to that of a serial conversion.
+    ///
+    /// If the emitter does not support EmitterIface::has_parallel_format(),
+    /// or \a output_fd cannot be written at arbitrary positions, such
+    /// as a pipe, the records are written in order through a stream
+    /// instead, as by the memory range convert().
+    ///
+    /// @param specification The specification of the records in \a data.
+    /// @param data Pointer to the first byte of CSV data.
+    /// @param size The number of bytes of CSV data.
+    /// @param emitter The emitter instance to use to format records.
+    /// @param output_fd The file descriptor to write converted records to,
+    ///        starting at its current offset. The offset is moved past the written data.
+    /// @param thread_count The number of worker threads to parse and write records with.
+    /// @param chunk_size The target size, in bytes, of each parsed range.
+    /// @param errors The handler of records that cannot be parsed.
+    ///        NULL selects csv::ErrorHandler::fail().
+    ///
+    /// @return The number of records converted.
+    ///
+    extern uint32_t convert(const csv::Specification& specification,
+                            const char* data,
+                            std::size_t size,
+                            csv::EmitterIface& emitter,
+                            int output_fd,
+                            unsigned int thread_count,
+                            std::size_t chunk_size = default_chunk_size,
+                            csv::ErrorHandler* errors = nullptr);
+
+    /// Convert all CSV records from an input stream in a three stage pipeline.
+    //
+    /// This function provides the same functionality as the
+    /// stream-based convert(), but overlaps reading, parsing, and
+    /// emitting records:
+    ///
+    ///   1. A reader thread reads blocks of roughly \a block_size bytes
+    ///      from \a input. Each block is cut after its last record,
+    ///      with the partial record that follows carried over to
+    ///      the next block.
+    ///   2. \a thread_count worker threads parse the blocks into
+    ///      csv::RecordBatch objects, using the same rules as the
+    ///      parallel convert().
+    ///   3. The calling thread hands the batches to
+    ///      EmitterIface::emit_batch() in their original order.
+    ///
+    /// The stages are connected by csv::BoundedQueue instances.
+    /// At most \a queue_depth blocks are in flight at any time, and
+    /// their memory is reused for the entire conversion. A slow
+    /// emitter will thus stall the reader and the workers instead of
+    /// growing memory usage.
+    ///
+    /// The output is identical to that of a serial conversion.
+    ///
+    /// @param specification The specification of the records read from \a input.
+    /// @param input The input data stream to read records from.
+    /// @param emitter The emitter instance to use to write data to \a output
+    /// @param output The output data stream to write converted records to.
+    /// @param thread_count The number of worker threads to parse records with.
+    /// @param queue_depth The number of blocks in flight. 0 selects 2 * \a thread_count + 2.
+    /// @param block_size The number of bytes to read from \a input at a time.
+    /// @param errors The handler of records that cannot be parsed.
+    ///        NULL selects csv::ErrorHandler::fail().
+    ///
+    /// @return The number of records converted.
+    ///
+    extern uint32_t convert(const csv::Specification& specification,
+                            std::istream& input,
+                            csv::EmitterIface& emitter,
+                            std::ostream& output,
+                            unsigned int thread_count,
+                            std::size_t queue_depth = 0,
+                            std::size_t block_size = default_chunk_size,
+                            csv::ErrorHandler* errors = nullptr);
 };
 #endif
@@ -14,8 +14,14 @@
 //
 
 #include "emitter_iface.hh"
+#include "output_buffer.hh"
 #include "ingestion_iface.hh"
 #include "csv_common.hh"
+#include "mapped_file.hh"
+#include "csv_stats.hh"
+#include "csv_error.hh"
+#include "fd_stream.hh"
+#include "decompress_stream.hh"
 #include "factory.hh"
 #include "factory_impl.hh"
 #include <stdlib.h>
@@ -23,18 +29,41 @@
 #include <fstream>
 #include <sstream>
 #include <getopt.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 
 
 void usage(char* progname)
 {
     std::cout << "Usage: " << progname << " -c <csv-file> -o <output-file> -f field_name:field_type [-f ...] [-t <type> ]" << std::endl;
-    std::cout << "  -c <csv-file>               CSV file to ingest." << std::endl;
-    std::cout << "  -T <type>                   CSV Reader type. Default 'csv'" << std::endl;
+    std::cout << "  -c <csv-file>               CSV file to ingest. '-' reads from stdin." << std::endl;
+    std::cout << "                              gzip and zstd compressed input is decompressed." << std::endl;
+    std::cout << "  -o <output-file>            File to write converted records to. '-' writes to stdout." << std::endl;
+    std::cout << "  -T <type>                   CSV Reader type. Default 'csv-mmap' for regular files, else 'csv'" << std::endl;
     std::cout << "  -t <type>                   Output file type. Default 'json'" << std::endl;
     std::cout << "  -e <escape-char>            Escape character to use. Default [none]." << std::endl;
     std::cout << "  -s <separator-char>         Separator character to use. Default ','." << std::endl;
-    std::cout << "  -f <field_name:field_type>  CSV field specification." << std::endl << std::endl;
+    std::cout << "  -u <quote-char>             Quote character to use. Default '\"'. '' reads quotes as field data." << std::endl;
+    std::cout << "  -j <threads>                Number of threads to parse and format the file with. Default 1." << std::endl;
+    std::cout << "  -q <depth>                  Blocks in flight when a csv file is parsed with -j. Default 2 * threads + 2." << std::endl;
+    std::cout << "  -R <policy>                 What to do with records that cannot be converted:" << std::endl;
+    std::cout << "                              fail, skip, or quarantine. Default fail." << std::endl;
+    std::cout << "  -Q <quarantine-file>        File to write rejected records to. Implies -R quarantine." << std::endl;
+    std::cout << "  -S, --stats                 Print conversion statistics as JSON on stderr when done." << std::endl;
+    std::cout << "                              Requires a build with 'make STATS=1'." << std::endl;
+    std::cout << "  -P <seconds>                Print progress on stderr every <seconds> seconds." << std::endl;
+    std::cout << "                              Requires a build with 'make STATS=1'." << std::endl;
+    std::cout << "  -b <bytes>                  Output bytes to buffer between writes. Default " << csv::OutputBuffer::default_capacity << "." << std::endl;
+    std::cout << "  -f <field_name:field_type>  CSV field specification." << std::endl;
+    std::cout << "  -p <field_name>[,...]       Fields to convert and emit, in order. Default all." << std::endl;
+    std::cout << "  -w <expression>             Only convert records matching the expression, e.g." << std::endl;
+    std::cout << "                              'status == \"ok\" && latency > 100'." << std::endl << std::endl;
     std::cout << "field_name is the name of the given field." << std::endl;
     std::cout << "field_type is data type. Supported values are int, double, and string." << std::endl << std::endl;
 
@@ -66,21 +95,41 @@ int main(int argc, char* argv[])
         {"type", required_argument, NULL, 't'},
         {"output", required_argument, NULL, 'o'},
         {"field", required_argument, NULL, 'f'},
+        {"project", required_argument, NULL, 'p'},
+        {"where", required_argument, NULL, 'w'},
         {"separator", required_argument, NULL, 's'},
         {"escape_char", required_argument, NULL, 'e'},
+        {"quote_char", required_argument, NULL, 'u'},
+        {"threads", required_argument, NULL, 'j'},
+        {"buffer-size", required_argument, NULL, 'b'},
+        {"queue-depth", required_argument, NULL, 'q'},
+        {"on-error", required_argument, NULL, 'R'},
+        {"quarantine", required_argument, NULL, 'Q'},
+        {"stats", no_argument, NULL, 'S'},
+        {"progress", required_argument, NULL, 'P'},
         {NULL, 0, NULL, 0}
     };
 
     std::string csv_file("");
     std::string output_type("json");
     std::string output_file("");
-    std::string ingestion_type("csv");
+    std::string ingestion_type("");
     char separator_char(',');
     char escape_char(0);
+    char quote_char('"');
+    unsigned int thread_count(1);
+    std::size_t buffer_size(csv::OutputBuffer::default_capacity);
+    std::size_t queue_depth(0);
+    bool print_stats(false);
+    unsigned int progress_interval(0);
     std::vector<std::string> field_spec_str;
+    std::vector<std::string> projection;
+    std::string filter("");
+    std::string error_policy("");
+    std::string quarantine_file("");
     int ch(0);
 
-    while ((ch = getopt_long(argc, argv, "c:t:o:T:f:s:", long_options, NULL)) != -1) {
+    while ((ch = getopt_long(argc, argv, "c:t:o:T:f:p:w:s:e:u:j:b:q:R:Q:SP:", long_options, NULL)) != -1) {
         switch (ch)
         {
             // short option 't'
@@ -100,6 +149,19 @@ int main(int argc, char* argv[])
             field_spec_str.push_back(optarg);
             break;
 
+        case 'p': {
+            std::istringstream names(optarg);
+            std::string name;
+
+            while(getline(names, name, ','))
+                projection.push_back(name);
+            break;
+        }
+
+        case 'w':
+            filter = optarg;
+            break;
+
         case 'T':
             ingestion_type = optarg;
             break;
@@ -112,6 +174,38 @@ int main(int argc, char* argv[])
             escape_char = *optarg;
             break;
 
+        case 'u':
+            quote_char = *optarg;
+            break;
+
+        case 'j':
+            thread_count = strtoul(optarg, 0, 10);
+            break;
+
+        case 'b':
+            buffer_size = strtoul(optarg, 0, 10);
+            break;
+
+        case 'q':
+            queue_depth = strtoul(optarg, 0, 10);
+            break;
+
+        case 'R':
+            error_policy = optarg;
+            break;
+
+        case 'Q':
+            quarantine_file = optarg;
+            break;
+
+        case 'S':
+            print_stats = true;
+            break;
+
+        case 'P':
+            progress_interval = strtoul(optarg, 0, 10);
+            break;
+
         default:
             usage(argv[0]);
             exit(255);
@@ -143,6 +237,45 @@ int main(int argc, char* argv[])
         exit(255);
     }
 
+    if ((print_stats || progress_interval > 0) && !csv::stats::enabled())
+        std::cerr << "Statistics are compiled out. Build with 'make STATS=1' to collect them." << std::endl;
+
+    // Select what to do with records that cannot be converted.
+    csv::ErrorPolicy policy(csv::ErrorPolicy::FAIL);
+
+    if (error_policy.empty())
+        policy = quarantine_file.empty()?csv::ErrorPolicy::FAIL:csv::ErrorPolicy::QUARANTINE;
+    else if (error_policy == "fail")
+        policy = csv::ErrorPolicy::FAIL;
+    else if (error_policy == "skip")
+        policy = csv::ErrorPolicy::SKIP;
+    else if (error_policy == "quarantine")
+        policy = csv::ErrorPolicy::QUARANTINE;
+    else {
+        std::cerr << "Unknown -R policy: " << error_policy << std::endl << std::endl;
+        usage(argv[0]);
+        exit(255);
+    }
+
+    if (policy == csv::ErrorPolicy::QUARANTINE && quarantine_file.empty()) {
+        std::cerr << "Missing: -Q <quarantine-file>" << std::endl << std::endl;
+        usage(argv[0]);
+        exit(255);
+    }
+
+    std::ofstream quarantine;
+
+    if (policy == csv::ErrorPolicy::QUARANTINE) {
+        quarantine.open(quarantine_file);
+
+        if (!quarantine.is_open()) {
+            std::cerr << "Could not open " << quarantine_file << " for writing." << std::endl;
+            exit(255);
+        }
+    }
+
+    csv::ErrorHandler error_handler(policy, &quarantine);
+
     // Divide the field spec strings up into a tuple vector
     // that is to be fed into the specification
     //
@@ -165,8 +298,47 @@ int main(int argc, char* argv[])
     // Create a spec
     csv::Specification spec(field_spec_tuple,
                             separator_char,
-                            escape_char);
+                            escape_char,
+                            projection,
+                            filter,
+                            quote_char);
+
+
+    // Open the input file, or read stdin for "-".
+    std::ifstream input_file;
+    csv::FdStreamBuf stdin_buffer(STDIN_FILENO);
+    std::istream input(&stdin_buffer);
+
+    if (csv_file == "-")
+        csv::set_pipe_size(STDIN_FILENO, csv::FdStreamBuf::default_buffer_size);
+    else {
+        input_file.open(csv_file);
+
+        if (!input_file.is_open()) {
+            std::cout << "Could not open " << csv_file << " for reading." << std::endl;
+            exit(255);
+        }
+        input.rdbuf(input_file.rdbuf());
+    }
+
+    // Decompress gzip and zstd input transparently.
+    csv::DecompressStreamBuf decompress_buffer(input.rdbuf(), thread_count);
+    input.rdbuf(&decompress_buffer);
 
+    // Compressed files cannot be memory mapped or read directly
+    // by the ingester.
+    bool mappable(csv_file != "-" && decompress_buffer.compression() == csv::Compression::NONE);
+
+    // Select the memory mapped reader for regular files, unless
+    // a reader type has been explicitly given.
+    if (ingestion_type.empty()) {
+        struct stat st;
+
+        if (mappable && stat(csv_file.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            ingestion_type = "csv-mmap";
+        else
+            ingestion_type = "csv";
+    }
 
     // Create an ingester
     auto ingester(csv::Factory<csv::IngestionIface>::produce(ingestion_type));
@@ -188,34 +360,120 @@ int main(int argc, char* argv[])
         exit(255);
     }
 
-    // Open the input file
-    std::ifstream input(csv_file);
+    emitter->set_buffer_size(buffer_size);
+    ingester->set_error_handler(error_handler);
 
-    if (!input.is_open()) {
-        std::cout << "Could not open " << csv_file << " for reading." << std::endl;
-        exit(255);
+    // A memory mapped file parsed with multiple threads is
+    // written by the worker threads, at the position of each chunk.
+    bool parallel_mmap(thread_count > 1 && ingestion_type == "csv-mmap" && mappable);
+    int output_fd(-1);
+
+    // Open the output file, or write to stdout for "-".
+    std::ofstream output_file_stream;
+    csv::FdStreamBuf stdout_buffer(STDOUT_FILENO);
+    std::ostream output(&stdout_buffer);
+
+    if (output_file == "-") {
+        csv::set_pipe_size(STDOUT_FILENO, csv::FdStreamBuf::default_buffer_size);
+        output_fd = STDOUT_FILENO;
+    } else if (parallel_mmap) {
+        output_fd = open(output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+        if (output_fd == -1) {
+            std::cout << "Could not open " << output_file << " for writing." << std::endl;
+            exit(255);
+        }
+    } else {
+        output_file_stream.open(output_file);
+
+        if (!output_file_stream.is_open()) {
+            std::cout << "Could not open " << output_file << " for writing." << std::endl;
+            exit(255);
+        }
+        output.rdbuf(output_file_stream.rdbuf());
     }
 
-    // Open the input file
-    std::ofstream output(output_file);
+    auto start(std::chrono::steady_clock::now());
+    std::mutex progress_mutex;
+    std::condition_variable progress_cond;
+    bool done(false);
+    std::thread progress_thread;
+
+    // Report progress periodically on stderr.
+    if (progress_interval > 0) {
+        progress_thread = std::thread([&](void) {
+            std::unique_lock<std::mutex> lock(progress_mutex);
+
+            while(!progress_cond.wait_for(lock, std::chrono::seconds(progress_interval),
+                                          [&] { return done; })) {
+                csv::stats::Snapshot stats(csv::stats::snapshot());
+                double seconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+                std::cerr << "progress: " << seconds << " s, " <<
+                    stats.counter(csv::stats::Counter::BYTES_READ) / 1e6 << " MB read, " <<
+                    stats.counter(csv::stats::Counter::RECORDS_EMITTED) << " records written, " <<
+                    stats.counter(csv::stats::Counter::BYTES_READ) / seconds / 1e6 << " MB/s" << std::endl;
+            }
+        });
+    }
 
-    if (!output.is_open()) {
-        std::cout << "Could not open " << output_file << " for writing." << std::endl;
-        exit(255);
+    if (parallel_mmap) {
+        //
+        // Parse a memory mapped file with multiple threads.
+        //
+        csv::MappedFile file;
+
+        if (!file.open(csv_file)) {
+            std::cout << "Could not map " << csv_file << " into memory." << std::endl;
+            exit(255);
+        }
+
+        csv::convert(spec, file.data(), file.size(), *emitter, output_fd, thread_count,
+                     csv::default_chunk_size, &error_handler);
+    } else if (thread_count > 1) {
+        //
+        // Read, parse, and emit records from a stream in a pipeline.
+        //
+        csv::convert(spec, input, *emitter, output, thread_count, queue_depth,
+                     csv::default_chunk_size, &error_handler);
+    } else {
+        // Let the ingester access the file directly, if it supports it.
+        // Ingesters that cannot will read from the input stream instead.
+        if (mappable)
+            ingester->open_file(csv_file);
+
+        //
+        // Parse all records from input string stream, using the
+        // created ingester, and emit them back out through
+        // the emitter.
+        //
+        csv::convert(spec, *ingester, input, *emitter, output);
     }
 
-    std::size_t record_index = 0;
-    std::shared_ptr<csv::Record> record;
+    // Destructors are not run by exit(), so flush stdout explicitly.
+    output.flush();
+    input_file.close();
+    output_file_stream.close();
+    quarantine.close();
 
-    //
-    // Parse all records from input string stream, using the
-    // created ingester, and emit them back out through
-    // the emitter.
-    //
-    csv::convert(spec, *ingester, input, *emitter, output);
+    if (output_fd != -1 && output_fd != STDOUT_FILENO)
+        close(output_fd);
+
+    if (progress_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            done = true;
+        }
+        progress_cond.notify_all();
+        progress_thread.join();
+    }
+
+    if (error_handler.error_count())
+        std::cerr << error_handler.error_count() << " records rejected." << std::endl;
+
+    if (print_stats)
+        csv::stats::report(std::cerr,
+                           std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 
-    input.close();
-    output.close();
     exit(0);
 }
-
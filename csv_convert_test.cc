@@ -22,6 +22,1485 @@
 #include <sstream>
 #include <getopt.h>
 #include "csv_common.hh"
+#include "record_batch.hh"
+#include "record_pool.hh"
+#include "output_buffer.hh"
+#include "csv_generator.hh"
+#include "fd_stream.hh"
+#include "decompress_stream.hh"
+#include "csv_format.hh"
+#include "emitter_columnar.hh"
+#include "static_spec.hh"
+#include "csv_error.hh"
+#include "csv_stats.hh"
+#include <zlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+//
+// Generate data with escaped separators and newlines, to
+// be converted in parallel.
+//
+static std::string parallel_test_data(void)
+{
+    std::string data("");
+
+    for(int i = 0; i < 5000; ++i) {
+        data += "A" + std::to_string(i);
+        if (i % 7 == 0)
+            data += "\\,x";
+        if (i % 11 == 0)
+            data += "\\\n";
+        data += "," + std::to_string(i * 3) + "," + std::to_string(i) + ".5\n";
+    }
+    return data;
+}
+
+static const csv::Specification& parallel_test_spec(void)
+{
+    static const csv::Specification spec({
+            { "First Field", "string" },
+            { "Second Field", "int" },
+            { "Third Field", "double" }
+        }, ',', '\\');
+
+    return spec;
+}
+
+//
+// Convert a generated CSV file both serially and in parallel, and
+// verify that the output is identical.
+//
+static bool test_parallel(void)
+{
+    const csv::Specification& spec(parallel_test_spec());
+    std::string data(parallel_test_data());
+
+    char file_name[] = "/tmp/csv_convert_test.XXXXXX";
+    int fd(mkstemp(file_name));
+    if (fd == -1 || write(fd, data.data(), data.size()) != ssize_t(data.size())) {
+        std::cout << "Could not create " << file_name << std::endl;
+        return false;
+    }
+    close(fd);
+
+    auto ingester(csv::Factory<csv::IngestionIface>::produce("csv-mmap"));
+    auto emitter(csv::Factory<csv::EmitterIface>::produce("json"));
+    std::istringstream unused;
+    std::ostringstream serial;
+
+    ingester->open_file(file_name);
+    uint32_t serial_count(csv::convert(spec, *ingester, unused, *emitter, serial));
+    unlink(file_name);
+
+    for(unsigned int threads: { 1, 2, 4 }) {
+        std::ostringstream parallel;
+        uint32_t count(csv::convert(spec, data.data(), data.size(),
+                                    *emitter, parallel, threads, 1000));
+
+        if (count != serial_count || parallel.str() != serial.str()) {
+            std::cout << "FAILED: parallel convert with " << threads <<
+                " threads differs from serial convert." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Convert generated CSV data both serially and through the
+// pipelined convert(), and verify that the output is identical.
+//
+// The serial output is produced by a single threaded memory
+// convert(), which test_parallel() verifies against csv-mmap.
+//
+static bool test_pipelined(void)
+{
+    const csv::Specification& spec(parallel_test_spec());
+    std::string data(parallel_test_data());
+    auto emitter(csv::Factory<csv::EmitterIface>::produce("json"));
+    std::ostringstream serial;
+    uint32_t serial_count(csv::convert(spec, data.data(), data.size(), *emitter, serial, 1));
+
+    // Blocks smaller than a record force records to span blocks.
+    for(std::size_t block_size: { 5, 1000, 100000 }) {
+        for(std::size_t queue_depth: { 2, 0 }) {
+            for(unsigned int threads: { 1, 2, 4 }) {
+                std::istringstream input(data);
+                std::ostringstream pipelined;
+                uint32_t count(csv::convert(spec, input, *emitter, pipelined,
+                                            threads, queue_depth, block_size));
+
+                if (count != serial_count || pipelined.str() != serial.str()) {
+                    std::cout << "FAILED: pipelined convert with " << threads <<
+                        " threads, queue depth " << queue_depth << ", and block size " <<
+                        block_size << " differs from serial convert." << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//
+// Convert data with a projection selecting and reordering fields,
+// through each reader and convert(), and verify that only the
+// projected fields are emitted. The skipped fields are not
+// valid numbers, so any attempt to convert them would fail.
+//
+static bool test_projection(void)
+{
+    csv::Specification spec({
+            { "First Field", "string" },
+            { "Skipped Int", "int" },
+            { "Second Field", "int" },
+            { "Skipped Double", "double" },
+            { "Third Field", "double" }
+        }, ',', '\\', { "Third Field", "First Field", "Second Field" });
+    std::string data("");
+    std::string expect("");
+
+    for(int i = 0; i < 5000; ++i) {
+        data += "A\\," + std::to_string(i) + ",x," + std::to_string(i * 3) + ",y," + std::to_string(i) + ".5\n";
+        expect += std::to_string(i) + ".5,A\\," + std::to_string(i) + "," + std::to_string(i * 3) + "\n";
+    }
+
+    if (spec.field_count() != 3 || spec.input_field_count() != 5 ||
+        spec.fields()[0].name_ != "Third Field" || spec.input_fields()[1].name_ != "Skipped Int") {
+        std::cout << "FAILED: Projected specification has the wrong fields." << std::endl;
+        return false;
+    }
+
+    // The escaped separator in the first field is escaped again on output.
+    for(const char* reader: { "csv", "csv-mmap" }) {
+        auto ingester(csv::Factory<csv::IngestionIface>::produce(reader));
+        auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+        std::istringstream input(data);
+        std::ostringstream output;
+
+        csv::convert(spec, *ingester, input, *emitter, output);
+
+        if (output.str() != expect) {
+            std::cout << "FAILED: Projected convert with reader " << reader << " differs." << std::endl;
+            return false;
+        }
+    }
+
+    for(unsigned int threads: { 1, 4 }) {
+        auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+        std::istringstream input(data);
+        std::ostringstream output;
+        std::ostringstream pipelined;
+
+        csv::convert(spec, data.data(), data.size(), *emitter, output, threads);
+        csv::convert(spec, input, *emitter, pipelined, threads, 0, 1000);
+
+        if (output.str() != expect || pipelined.str() != expect) {
+            std::cout << "FAILED: Projected convert with " << threads << " threads differs." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Convert data with a filter through each reader and convert(),
+// and verify that only matching records are emitted. The fields
+// neither projected nor referenced by the filter are not valid
+// numbers, so any attempt to convert them would fail.
+//
+static bool test_filter(void)
+{
+    csv::Specification spec({
+            { "Name", "string" },
+            { "Status", "string" },
+            { "Latency", "int" },
+            { "Skipped", "int" },
+            { "Score", "double" }
+        }, ',', '\\', { "Name", "Latency", "Score" },
+        "Status == \"ok\" && (Latency > 100 || Score <= 0.25) || `Name` == \"special\\\"\" ");
+    std::string data("");
+    std::string expect("");
+
+    for(int i = 0; i < 5000; ++i) {
+        std::string name((i % 100 == 0)?"special\"":"n" + std::to_string(i));
+        std::string status((i % 3)?"ok":"failed");
+        int latency(i % 200);
+        double score((i % 8) / 8.0);
+
+        data += name + "," + status + "," + std::to_string(latency) + ",x," + std::to_string(score) + "\n";
+
+        if ((status == "ok" && (latency > 100 || score <= 0.25)) || name == "special\"") {
+            expect += name + "," + std::to_string(latency) + ",";
+            csv::append_double(expect, score);
+            expect += "\n";
+        }
+    }
+
+    for(const char* reader: { "csv", "csv-mmap" }) {
+        auto ingester(csv::Factory<csv::IngestionIface>::produce(reader));
+        auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+        std::istringstream input(data);
+        std::ostringstream output;
+
+        csv::convert(spec, *ingester, input, *emitter, output);
+
+        if (output.str() != expect) {
+            std::cout << "FAILED: Filtered convert with reader " << reader << " differs." << std::endl;
+            return false;
+        }
+    }
+
+    for(unsigned int threads: { 1, 4 }) {
+        auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+        std::istringstream input(data);
+        std::ostringstream output;
+        std::ostringstream pipelined;
+
+        csv::convert(spec, data.data(), data.size(), *emitter, output, threads);
+        csv::convert(spec, input, *emitter, pipelined, threads, 0, 1000);
+
+        if (output.str() != expect || pipelined.str() != expect) {
+            std::cout << "FAILED: Filtered convert with " << threads << " threads differs." << std::endl;
+            return false;
+        }
+    }
+
+    // Lines with tokens that the filter cannot compare are skipped
+    // or quarantined like other records that cannot be converted,
+    // even if the rest of the expression would have matched them.
+    csv::Specification invalid_spec({
+            { "a", "int" },
+            { "b", "string" }
+        }, ',', 0, {}, "a > 0 || b == \"y\"");
+    std::string invalid("1,x\nzz,y\n3,z\n-1,q\n");
+    std::string expect_quarantine("2\tToken for field a: zz is not an integer.\tzz,y\n");
+
+    for(auto policy: { csv::ErrorPolicy::SKIP, csv::ErrorPolicy::QUARANTINE }) {
+        for(const char* reader: { "csv", "csv-mmap", "parallel", "pipelined" }) {
+            auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+            std::ostringstream quarantine;
+            csv::ErrorHandler errors(policy, &quarantine);
+            std::istringstream input(invalid);
+            std::ostringstream output;
+
+            if (std::string(reader) == "parallel")
+                csv::convert(invalid_spec, invalid.data(), invalid.size(), *emitter, output, 2, 4, &errors);
+            else if (std::string(reader) == "pipelined")
+                csv::convert(invalid_spec, input, *emitter, output, 2, 0, 4, &errors);
+            else {
+                auto ingester(csv::Factory<csv::IngestionIface>::produce(reader));
+
+                ingester->set_error_handler(errors);
+                csv::convert(invalid_spec, *ingester, input, *emitter, output);
+            }
+
+            if (output.str() != "1,x\n3,z\n" || errors.error_count() != 1 ||
+                quarantine.str() != (policy == csv::ErrorPolicy::QUARANTINE?expect_quarantine:"")) {
+                std::cout << "FAILED: Filtered convert with " << reader <<
+                    " did not reject a line the filter cannot compare." << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static constexpr char first_field_name[] = "First Field";
+static constexpr char second_field_name[] = "Second Field";
+static constexpr char third_field_name[] = "Third Field";
+
+//
+// Parse data with a csv::StaticSpec matching parallel_test_spec(),
+// and verify that it formats the same output as the runtime
+// specification and emitters.
+//
+static bool test_static_spec(void)
+{
+    using Spec = csv::StaticSpec<csv::StaticField<first_field_name, std::string>,
+                                 csv::StaticField<second_field_name, int64_t>,
+                                 csv::StaticField<third_field_name, double>>;
+    Spec spec(',', '\\');
+    std::string data(parallel_test_data());
+    std::vector<Spec::Record> records;
+    Spec::Record record;
+    std::string json("[\n");
+    std::string csv_output("");
+
+    static_assert(Spec::field_count == 3 && Spec::index<third_field_name>() == 2,
+                  "Wrong static field layout");
+
+    if (!spec.parse(data, records) || records.size() != 5000) {
+        std::cout << "FAILED: StaticSpec could not parse test data." << std::endl;
+        return false;
+    }
+
+    for(const auto& rec: records) {
+        spec.append_json(json, rec, &rec == &records.front());
+        spec.append_csv(csv_output, rec);
+    }
+    json.append("]\n");
+
+    // Compare with the runtime conversion of the same data,
+    // using the runtime specification produced by the static one.
+    const csv::Specification runtime_spec(spec.specification());
+
+    for(const char* type: { "json", "csv" }) {
+        auto emitter(csv::Factory<csv::EmitterIface>::produce(type));
+        std::ostringstream output;
+
+        csv::convert(runtime_spec, data.data(), data.size(), *emitter, output, 1);
+
+        if (output.str() != (type[0] == 'j'?json:csv_output)) {
+            std::cout << "FAILED: StaticSpec " << type << " output differs from the runtime emitter." << std::endl;
+            return false;
+        }
+    }
+
+    if (spec.parse("A,1", record) || spec.parse("A,x,1.5", record) ||
+        !spec.parse("A\\,B, 7,1.5", record) ||
+        record != Spec::Record("A,B", 7, 1.5)) {
+        std::cout << "FAILED: StaticSpec parsed invalid lines, or failed valid ones." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//
+// Store records in a csv::RecordBatch and verify that rows read back
+// through the row view emit the same output as the original records.
+//
+static bool test_record_batch(void)
+{
+    csv::Specification spec({
+            { "First Field", "string" },
+            { "Second Field", "int" },
+            { "Third Field", "double" },
+            { "Fourth Field", "string" }
+        }, ',', '\\');
+
+    static std::string in_csv_data {
+        "A1,  1, 1.5,\n"
+        "A\\,2,0x10,2.25,B2\n"
+        ",3,-3,B3\n"
+    };
+
+    auto csv_ingester(csv::Factory<csv::IngestionIface>::produce("csv"));
+    auto json_emitter(csv::Factory<csv::EmitterIface>::produce("json"));
+    std::istringstream input(in_csv_data);
+    std::ostringstream expect;
+    std::ostringstream result;
+    std::vector<std::string_view> tokens;
+    std::string buffer;
+    std::string line;
+    std::string error;
+    csv::RecordBatch batch(spec, 2);
+
+    csv::convert(spec, *csv_ingester, input, *json_emitter, expect);
+
+    // Tokenize straight into the batch, starting at record index 0.
+    input.clear();
+    input.str(in_csv_data);
+    while(std::getline(input, line)) {
+        tokens.clear();
+        csv::tokenize_line(line, spec.separator_char(), spec.escape_char(), tokens, buffer);
+        if (!batch.append(tokens, error)) {
+            std::cout << "FAILED: RecordBatch rejected a valid record: " << error << std::endl;
+            return false;
+        }
+    }
+
+    if (batch.size() != 3 || !batch.full() || batch.row(1).int64_value(1) != 16 ||
+        batch.row(1).string_value(0) != "A,2") {
+        std::cout << "FAILED: RecordBatch holds incorrect data." << std::endl;
+        return false;
+    }
+
+    json_emitter->begin(result, "", spec);
+    for(std::size_t row = 0; row < batch.size(); ++row)
+        json_emitter->emit_record(result, spec, csv::Record(spec, batch.row(row)));
+    json_emitter->end(result, spec);
+
+    if (result.str() != expect.str()) {
+        std::cout << "FAILED: RecordBatch rows differ from records." << std::endl;
+        std::cout << "Records:" << std::endl << expect.str() << std::endl;
+        std::cout << "Batch rows:" << std::endl << result.str() << std::endl;
+        return false;
+    }
+
+    // A cleared batch is reused from the start.
+    batch.clear();
+    if (!batch.empty())
+        return false;
+
+    return true;
+}
+
+//
+// Verify that records released by the caller are recycled
+// by the ingester's record pool.
+//
+static bool test_record_pool(void)
+{
+    csv::Specification spec({
+            { "First Field", "string" },
+            { "Second Field", "int" }
+        }, ',', 0);
+
+    auto csv_ingester(csv::Factory<csv::IngestionIface>::produce("csv"));
+    std::istringstream input("A,1\nBB,2\nCCC,3\nDDDD,4\n");
+    std::size_t record_index(0);
+    csv::stats::Snapshot before(csv::stats::snapshot());
+
+    while(auto record = csv_ingester->ingest_record(input, spec, record_index)) {
+        if (record->index() != record_index ||
+            record->int64_value(1) != int64_t(record_index + 1) ||
+            record->string_value(0).length() != record_index + 1) {
+            std::cout << "FAILED: Recycled record holds incorrect data." << std::endl;
+            return false;
+        }
+        ++record_index;
+    }
+
+    const csv::RecordPool* pool(csv_ingester->record_pool());
+    if (!pool || pool->misses() != 1 || pool->hits() != 3) {
+        std::cout << "FAILED: Records were not recycled by the record pool." << std::endl;
+        return false;
+    }
+
+    // The hits and misses are also reported by --stats.
+    csv::stats::Snapshot after(csv::stats::snapshot());
+    if (csv::stats::enabled() &&
+        (after.counter(csv::stats::Counter::POOL_HITS) - before.counter(csv::stats::Counter::POOL_HITS) != 3 ||
+         after.counter(csv::stats::Counter::POOL_MISSES) - before.counter(csv::stats::Counter::POOL_MISSES) != 1)) {
+        std::cout << "FAILED: Record pool hits and misses are not counted." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//
+// Compare csv::parse_int64() and csv::parse_double() against
+// strtoll() and strtod() on valid and invalid tokens.
+//
+static bool test_parse_numbers(void)
+{
+    static const char* tokens[] = {
+        "", " ", "0", "-0", "+0", "  42  ", "\t-17\t", "+5", "-", "+", "--1", "+-1",
+        "0x1f", "0X1F", "-0x10", "0x", "010", "-010", "08", "1a", "a1", "1 2",
+        "9223372036854775807", "9223372036854775808", "-9223372036854775808",
+        "-9223372036854775809", "99999999999999999999999",
+        "1.5", "-1.5", "+1.5", ".5", "5.", "1e10", "1E-10", "1e", "1e+", "-.5e3",
+        "0x1p3", "-0x1.8p1", "0x.8", "inf", "-Infinity", "nan", "NaN", "1e400", "-1e400",
+        "1e-400", "0.1", "3.141592653589793", "1.7976931348623157e308", "4.9e-324",
+        "1,5", "1..5", " \v12"
+    };
+
+    for(const char* token: tokens) {
+        std::string stripped(token);
+        int64_t int_val(0);
+        double double_val(0.0);
+        char* endptr(0);
+
+        // strtoll()/strtod() expect the spaces and tabs to be stripped.
+        stripped.erase(0, stripped.find_first_not_of(" \t"));
+        stripped.erase(stripped.find_last_not_of(" \t") + 1);
+
+        int64_t expect_int(strtoll(stripped.c_str(), &endptr, 0));
+        bool expect_int_ok(!*endptr);
+        double expect_double(strtod(stripped.c_str(), &endptr));
+        bool expect_double_ok(!*endptr);
+
+        bool int_ok(csv::parse_int64(token, int_val));
+        bool double_ok(csv::parse_double(token, double_val));
+
+        if (int_ok != expect_int_ok || (int_ok && int_val != expect_int)) {
+            std::cout << "FAILED: parse_int64(\"" << token << "\"): " << int_ok << "/" << int_val <<
+                ". Expected: " << expect_int_ok << "/" << expect_int << std::endl;
+            return false;
+        }
+
+        if (double_ok != expect_double_ok ||
+            (double_ok && memcmp(&double_val, &expect_double, sizeof(double)) &&
+             !(double_val != double_val && expect_double != expect_double))) {
+            std::cout << "FAILED: parse_double(\"" << token << "\"): " << double_ok << "/" << double_val <<
+                ". Expected: " << expect_double_ok << "/" << expect_double << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Verify that doubles survive a CSV to CSV conversion
+// without any loss of precision.
+//
+static bool test_double_round_trip(void)
+{
+    csv::Specification spec({
+            { "First Field", "double" },
+            { "Second Field", "int" }
+        }, ',', 0);
+
+    static std::string in_csv_data {
+        "0.30000000000000004,-9223372036854775808\n"
+        "1.7976931348623157e+308,9223372036854775807\n"
+        "5e-324,0\n"
+        "123456.789,-1\n"
+        "-0.1,1\n"
+    };
+
+    auto csv_ingester(csv::Factory<csv::IngestionIface>::produce("csv"));
+    auto csv_emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+    std::istringstream input(in_csv_data);
+    std::ostringstream output;
+
+    csv::convert(spec, *csv_ingester, input, *csv_emitter, output);
+
+    if (output.str() != in_csv_data) {
+        std::cout << "FAILED: Numbers did not survive a round trip." << std::endl;
+        std::cout << "Input:" << std::endl << in_csv_data << std::endl;
+        std::cout << "Output:" << std::endl << output.str() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//
+// Verify that the output of all emitters is independent of the
+// size of their output buffers, and that nothing is written out
+// before the buffer is full.
+//
+static bool test_output_buffer(void)
+{
+    csv::Specification spec({
+            { "First Field", "string" },
+            { "Second Field", "int" },
+            { "Third Field", "double" }
+        }, ',', 0);
+
+    std::string in_csv_data("");
+    for(int i = 0; i < 1000; ++i)
+        in_csv_data += "A" + std::to_string(i) + "," + std::to_string(i) + "," + std::to_string(i) + ".25\n";
+
+    for(auto type: { "csv", "json", "yaml" }) {
+        std::string expect("");
+
+        for(std::size_t size: { std::size_t(0), std::size_t(100), csv::OutputBuffer::default_capacity }) {
+            auto ingester(csv::Factory<csv::IngestionIface>::produce("csv"));
+            auto emitter(csv::Factory<csv::EmitterIface>::produce(type));
+            std::istringstream input(in_csv_data);
+            std::ostringstream output;
+
+            emitter->set_buffer_size(size);
+            csv::convert(spec, *ingester, input, *emitter, output);
+
+            if (expect.empty())
+                expect = output.str();
+
+            if (output.str() != expect) {
+                std::cout << "FAILED: " << type << " output differs with a " <<
+                    size << " byte output buffer." << std::endl;
+                return false;
+            }
+        }
+
+        // Records must stay in the buffer until end() is called.
+        auto emitter(csv::Factory<csv::EmitterIface>::produce(type));
+        csv::Record record(spec, 0, { "A", "1", "2" });
+        std::ostringstream output;
+
+        emitter->begin(output, "", spec);
+        output.str("");
+        emitter->emit_record(output, spec, record);
+
+        if (!output.str().empty()) {
+            std::cout << "FAILED: " << type << " record written before end()." << std::endl;
+            return false;
+        }
+
+        emitter->end(output, spec);
+        if (output.str().empty()) {
+            std::cout << "FAILED: " << type << " record not written by end()." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Verify that generated data is deterministic, and that it
+// survives a CSV to CSV conversion unchanged.
+//
+static bool test_generator(void)
+{
+    csv::Specification spec({
+            { "First Field", "int" },
+            { "Second Field", "double" },
+            { "Third Field", "string" }
+        }, ',', 0);
+
+    csv::Generator generator1(spec, 4711);
+    csv::Generator generator2(spec, 4711);
+    std::ostringstream data1;
+    std::ostringstream data2;
+
+    std::size_t records(generator1.generate(data1, 100000));
+    generator2.generate(data2, 100000);
+
+    if (data1.str() != data2.str() || data1.str().length() < 100000) {
+        std::cout << "FAILED: Generated data is not deterministic." << std::endl;
+        return false;
+    }
+
+    auto ingester(csv::Factory<csv::IngestionIface>::produce("csv"));
+    auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+    std::istringstream input(data1.str());
+    std::ostringstream output;
+
+    if (csv::convert(spec, *ingester, input, *emitter, output) != records ||
+        output.str() != data1.str()) {
+        std::cout << "FAILED: Generated data did not survive a round trip." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//
+// Write data to a file through a csv::FdStreamBuf, and verify that
+// it reads back the same, both through buffered and direct reads
+// and writes.
+//
+static bool test_fd_stream(void)
+{
+    std::string data(parallel_test_data());
+    char file_name[] = "/tmp/csv_convert_test.XXXXXX";
+    int fd(mkstemp(file_name));
+
+    if (fd == -1) {
+        std::cout << "Could not create " << file_name << std::endl;
+        return false;
+    }
+    unlink(file_name);
+
+    {
+        // A small buffer, so that large writes bypass it.
+        csv::FdStreamBuf buffer(fd, 64);
+        std::ostream output(&buffer);
+
+        output << data.substr(0, 10);
+        output.write(data.data() + 10, 1000);
+        output << data.substr(1010) << std::flush;
+
+        if (!output) {
+            std::cout << "FAILED: Could not write through FdStreamBuf." << std::endl;
+            return false;
+        }
+    }
+
+    lseek(fd, 0, SEEK_SET);
+
+    csv::FdStreamBuf buffer(fd, 64);
+    std::istream input(&buffer);
+    std::string line;
+    std::string result("");
+    std::string block(1000, ' ');
+
+    // A line, a large block read, and then the rest line by line.
+    std::getline(input, line);
+    result = line + "\n";
+    input.read(&block[0], block.size());
+    result += block;
+
+    while(std::getline(input, line))
+        result += line + "\n";
+
+    close(fd);
+
+    if (result != data) {
+        std::cout << "FAILED: Data read through FdStreamBuf differs from data written." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//
+// Compress data as a gzip member. With bgzf set, the member is
+// written with the BC extra field of the BGZF format.
+//
+static std::string gzip_member(const std::string& data, bool bgzf)
+{
+    z_stream stream;
+    std::string compressed("");
+
+    memset(&stream, 0, sizeof(stream));
+    // Raw deflate data for BGZF, where the header is written below.
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, bgzf?-MAX_WBITS:16 + MAX_WBITS,
+                 8, Z_DEFAULT_STRATEGY);
+    compressed.resize(deflateBound(&stream, data.length()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = data.length();
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = compressed.length();
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (!bgzf)
+        return compressed;
+
+    std::size_t member_size(18 + compressed.length() + 8);
+    uint32_t crc(crc32(0, reinterpret_cast<const Bytef*>(data.data()), data.length()));
+    uint32_t size(data.length());
+    std::string member {
+        '\x1f', '\x8b', 8, 4, 0, 0, 0, 0, 0, '\xff', 6, 0, 'B', 'C', 2, 0,
+        char((member_size - 1) & 0xff), char((member_size - 1) >> 8)
+    };
+
+    member += compressed;
+    for(uint32_t value: { crc, size })
+        for(int shift = 0; shift < 32; shift += 8)
+            member.push_back(char(value >> shift));
+
+    return member;
+}
+
+//
+// Read data through a csv::DecompressStreamBuf, with a mix of
+// line and block reads.
+//
+static std::string decompress(const std::string& compressed,
+                              unsigned int thread_count,
+                              csv::Compression expect)
+{
+    std::istringstream source(compressed);
+    csv::DecompressStreamBuf buffer(source.rdbuf(), thread_count, 4096);
+    std::istream input(&buffer);
+    std::string line;
+    std::string result("");
+    std::string block(10000, ' ');
+
+    if (buffer.compression() != expect) {
+        std::cout << "FAILED: Compression format not detected." << std::endl;
+        return "";
+    }
+
+    std::getline(input, line);
+    result = line + "\n";
+    input.read(&block[0], block.size());
+    result += block;
+
+    while(std::getline(input, line))
+        result += line + "\n";
+
+    return result;
+}
+
+//
+// Verify that plain, multi-member, and BGZF gzip data decompresses
+// to the original, with one and with multiple threads.
+//
+static bool test_decompress(void)
+{
+    std::string data(parallel_test_data());
+    std::string gzip("");
+    std::string bgzf("");
+
+    // Two members, and BGZF members of at most 1000 bytes each
+    // followed by an empty end of file member.
+    gzip = gzip_member(data.substr(0, data.length() / 3), false) +
+        gzip_member(data.substr(data.length() / 3), false);
+
+    for(std::size_t pos = 0; pos < data.length(); pos += 1000)
+        bgzf += gzip_member(data.substr(pos, 1000), true);
+
+    bgzf += gzip_member("", true);
+
+    for(unsigned int thread_count: { 1, 4 }) {
+        if (decompress(data, thread_count, csv::Compression::NONE) != data ||
+            decompress(gzip, thread_count, csv::Compression::GZIP) != data ||
+            decompress(bgzf, thread_count, csv::Compression::GZIP) != data) {
+            std::cout << "FAILED: Decompressed data with " << thread_count <<
+                " threads differs from the original." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Decode a file written by the "columnar" emitter into CSV lines.
+//
+static bool decode_columnar(const std::string& data, std::string& result)
+{
+    std::size_t pos(0);
+    auto varint([&](void) {
+        uint64_t value(0);
+
+        for(int shift = 0; pos < data.length(); shift += 7) {
+            uint8_t byte(data[pos++]);
+
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        return value;
+    });
+    auto fixed([&](std::size_t size) {
+        uint64_t value(0);
+
+        for(std::size_t i = 0; i < size; ++i)
+            value |= uint64_t(uint8_t(data[pos++])) << (i * 8);
+
+        return value;
+    });
+    auto string([&](void) {
+        std::size_t length(varint());
+
+        pos += length;
+        return data.substr(pos - length, length);
+    });
+
+    if (data.length() < 13 || data.compare(0, 4, "CSVC") || data.compare(data.length() - 4, 4, "CSVC"))
+        return false;
+
+    // Read the schema and row group offsets from the footer.
+    pos = data.length() - 8;
+    pos = data.length() - 8 - fixed(4);
+
+    std::vector<csv::FieldType> types(varint());
+    for(auto& type: types) {
+        string();
+        type = csv::FieldType(data[pos++]);
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> groups(varint());
+    for(auto& group: groups) {
+        group.first = varint();
+        group.second = varint();
+    }
+
+    for(const auto& group: groups) {
+        std::vector<std::vector<std::string>> columns;
+
+        pos = group.first;
+        if (varint() != group.second)
+            return false;
+
+        // Decode each column to strings.
+        for(auto type: types) {
+            auto encoding(csv::EmitterColumnar::Encoding(data[pos++]));
+            std::size_t end(varint());
+            std::vector<std::string> column(group.second, "");
+            std::vector<std::string> dictionary;
+            uint64_t previous(0);
+
+            end += pos;
+            if (encoding == csv::EmitterColumnar::Encoding::DICTIONARY) {
+                dictionary.resize(varint());
+                for(auto& value: dictionary)
+                    value = string();
+            }
+
+            for(auto& value: column) {
+                uint64_t bits(0);
+                double dbl(0.0);
+
+                switch(encoding) {
+                case csv::EmitterColumnar::Encoding::DELTA_VARINT:
+                    bits = varint();
+                    previous += (bits >> 1) ^ -(bits & 1);
+                    csv::append_int64(value, previous);
+                    break;
+
+                case csv::EmitterColumnar::Encoding::RAW:
+                    bits = fixed(8);
+                    memcpy(&dbl, &bits, sizeof(dbl));
+                    csv::append_double(value, dbl);
+                    break;
+
+                case csv::EmitterColumnar::Encoding::XOR: {
+                    uint8_t control(data[pos++]);
+
+                    bits = fixed(8 - (control >> 4) - (control & 0xf)) << ((control & 0xf) * 8);
+                    previous ^= bits;
+                    memcpy(&dbl, &previous, sizeof(dbl));
+                    csv::append_double(value, dbl);
+                    break;
+                }
+
+                case csv::EmitterColumnar::Encoding::PLAIN:
+                    value = string();
+                    break;
+
+                case csv::EmitterColumnar::Encoding::DICTIONARY:
+                    value = dictionary.at(varint());
+                    break;
+                }
+            }
+
+            if (pos != end)
+                return false;
+
+            columns.push_back(column);
+        }
+
+        for(uint64_t row = 0; row < group.second; ++row) {
+            for(std::size_t field = 0; field < columns.size(); ++field) {
+                if (field)
+                    result += ',';
+                result += columns[field][row];
+            }
+            result += '\n';
+        }
+    }
+    return true;
+}
+
+//
+// Verify that data written by the "columnar" emitter decodes to
+// the same records as written by the "csv" emitter, for each
+// encoding, across several row groups.
+//
+static bool test_columnar(void)
+{
+    csv::Specification spec({
+            { "Id", "int" },
+            { "Value", "double" },
+            { "Color", "string" },
+            { "Random Int", "int" },
+            { "Random Double", "double" },
+            { "Random String", "string" }
+        }, ',', 0);
+    csv::Specification random_spec({
+            { "Random Int", "int" },
+            { "Random Double", "double" },
+            { "Random String", "string" }
+        }, ',', 0);
+    static const char* colors[] = { "red", "green", "blue" };
+    csv::Generator generator(random_spec, 4711);
+    std::string data("");
+
+    // Sorted integers, regular doubles, and few distinct strings,
+    // followed by random values.
+    for(int row = 0; row < 150000; ++row) {
+        data += std::to_string(1000 + row * 3) + "," + std::to_string(row * 0.5) + "," +
+            colors[row % 3] + ",";
+        generator.append_record(data);
+    }
+
+    for(unsigned int thread_count: { 1, 4 }) {
+        auto emitter(csv::Factory<csv::EmitterIface>::produce("columnar"));
+        auto csv_emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+        std::ostringstream output;
+        std::ostringstream csv_output;
+        std::string decoded("");
+
+        csv::convert(spec, data.data(), data.length(), *emitter, output, thread_count);
+        csv::convert(spec, data.data(), data.length(), *csv_emitter, csv_output, thread_count);
+
+        if (!decode_columnar(output.str(), decoded) || decoded != csv_output.str()) {
+            std::cout << "FAILED: Columnar data with " << thread_count <<
+                " threads does not decode to the original records." << std::endl;
+            return false;
+        }
+
+        if (output.str().length() >= data.length()) {
+            std::cout << "FAILED: Columnar data is not smaller than CSV." << std::endl;
+            return false;
+        }
+    }
+
+    // Records emitted one by one.
+    auto emitter(csv::Factory<csv::EmitterIface>::produce("columnar"));
+    auto ingester(csv::Factory<csv::IngestionIface>::produce("csv"));
+    std::istringstream input(data);
+    std::ostringstream output;
+    std::shared_ptr<csv::Record> record;
+    std::size_t record_index(0);
+    std::string decoded("");
+
+    emitter->begin(output, "", spec);
+    while((record = ingester->ingest_record(input, spec, record_index++)))
+        emitter->emit_record(output, spec, *record);
+    emitter->end(output, spec);
+
+    auto csv_emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+    std::ostringstream csv_output;
+
+    csv::convert(spec, data.data(), data.length(), *csv_emitter, csv_output, 1);
+    if (!decode_columnar(output.str(), decoded) || decoded != csv_output.str()) {
+        std::cout << "FAILED: Columnar records do not decode to the original records." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//
+// Verify that strings with quotes, backslashes, separators, and
+// control characters are escaped by the text emitters, and that
+// CSV output reads back as the same records.
+//
+static bool test_escape(void)
+{
+    csv::Specification spec({
+            { "Text", "string" },
+            { "Control", "string" },
+            { "Count", "int" }
+        }, ',', '\\');
+    std::string data("");
+
+    for(int i = 0; i < 1000; ++i)
+        data += "Say \"hi\"\\, o/\\\nbye " + std::to_string(i) + ",\x01\x1f\t,7\n";
+
+    // CSV output is the original data.
+    for(unsigned int threads: { 1, 4 }) {
+        auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+        std::ostringstream output;
+
+        csv::convert(spec, data.data(), data.size(), *emitter, output, threads);
+        if (output.str() != data) {
+            std::cout << "FAILED: Escaped CSV output with " << threads << " threads differs." << std::endl;
+            return false;
+        }
+    }
+
+    // Readers of streams continue records over escaped newlines.
+    for(const char* type: { "csv", "csv-mmap" }) {
+        auto ingester(csv::Factory<csv::IngestionIface>::produce(type));
+        auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+        std::istringstream input(data);
+        std::ostringstream output;
+
+        csv::convert(spec, *ingester, input, *emitter, output);
+        if (output.str() != data) {
+            std::cout << "FAILED: Escaped CSV output of the " << type << " reader differs." << std::endl;
+            return false;
+        }
+    }
+
+    static const std::pair<const char*, const char*> expect[] = {
+        { "json",
+          "[\n"
+          "{\n"
+          "    \"Text\": \"Say \\\"hi\\\", o/\\nbye 0\",\n"
+          "    \"Control\": \"\\u0001\\u001f\\t\",\n"
+          "    \"Count\": 7\n"
+          "}\n"
+          "]\n" },
+        { "yaml",
+          "- Text: \"Say \\\"hi\\\", o/\\nbye 0\"\n"
+          "  Control: \"\\u0001\\u001f\\t\"\n"
+          "  Count: 7\n"
+          "\n" }
+    };
+    std::string line(data.substr(0, data.find(",7\n") + 3));
+
+    for(const auto& [ type, text ]: expect) {
+        auto emitter(csv::Factory<csv::EmitterIface>::produce(type));
+        std::ostringstream output;
+
+        csv::convert(spec, line.data(), line.size(), *emitter, output, 1);
+        if (output.str() != text) {
+            std::cout << "FAILED: Escaped " << type << " output differs:" << std::endl << output.str() << std::endl;
+            return false;
+        }
+    }
+
+    // Field names are escaped as well.
+    csv::Specification named_spec({
+            { "Say \"hi\"", "string" },
+            { "a\\b", "int" }
+        }, ',', '\\');
+    static const std::pair<const char*, const char*> expect_named[] = {
+        { "json",
+          "[\n"
+          "{\n"
+          "    \"Say \\\"hi\\\"\": \"x\",\n"
+          "    \"a\\\\b\": 1\n"
+          "}\n"
+          "]\n" },
+        { "yaml",
+          "- \"Say \\\"hi\\\"\": \"x\"\n"
+          "  \"a\\\\b\": 1\n"
+          "\n" },
+        { "jsonl",
+          "{\"Say \\\"hi\\\"\":\"x\",\"a\\\\b\":1}\n" }
+    };
+
+    for(const auto& [ type, text ]: expect_named) {
+        auto emitter(csv::Factory<csv::EmitterIface>::produce(type));
+        std::ostringstream output;
+
+        csv::convert(named_spec, "x,1\n", 4, *emitter, output, 1);
+        if (output.str() != text) {
+            std::cout << "FAILED: Escaped " << type << " field names differ:" << std::endl << output.str() << std::endl;
+            return false;
+        }
+    }
+
+    // YAML names that could be read as YAML syntax are quoted.
+    csv::Specification yaml_spec({
+            { "#c", "string" },
+            { "- d", "string" },
+            { " e ", "string" },
+            { "f: g", "string" },
+            { "First-Field.1", "int" }
+        }, ',', '\\');
+    auto yaml_emitter(csv::Factory<csv::EmitterIface>::produce("yaml"));
+    std::ostringstream yaml;
+
+    csv::convert(yaml_spec, "1,2,3,4,5\n", 10, *yaml_emitter, yaml, 1);
+    if (yaml.str() !=
+        "- \"#c\": \"1\"\n"
+        "  \"- d\": \"2\"\n"
+        "  \" e \": \"3\"\n"
+        "  \"f: g\": \"4\"\n"
+        "  First-Field.1: 5\n"
+        "\n") {
+        std::cout << "FAILED: YAML field names are not quoted:" << std::endl << yaml.str() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//
+// Verify that the "jsonl" emitter writes one compact object per
+// line, and that batches formatted by the worker threads of the
+// parallel conversions are concatenated in order.
+//
+static bool test_jsonl(void)
+{
+    csv::Specification spec({
+            { "Name", "string" },
+            { "Count", "int" },
+            { "Value", "double" }
+        }, ',', '\\');
+    std::string data("");
+    std::string expect("");
+
+    for(int i = 0; i < 20000; ++i) {
+        data += "say \"" + std::to_string(i) + "\"\\, ok," + std::to_string(i) + "," + std::to_string(i) + ".5\n";
+        expect += "{\"Name\":\"say \\\"" + std::to_string(i) + "\\\", ok\",\"Count\":" + std::to_string(i) +
+            ",\"Value\":" + std::to_string(i) + ".5}\n";
+    }
+
+    auto ingester(csv::Factory<csv::IngestionIface>::produce("csv"));
+    auto emitter(csv::Factory<csv::EmitterIface>::produce("jsonl"));
+    std::istringstream input(data);
+    std::ostringstream output;
+
+    csv::convert(spec, *ingester, input, *emitter, output);
+    if (output.str() != expect) {
+        std::cout << "FAILED: JSON Lines output differs." << std::endl;
+        return false;
+    }
+
+    // Small chunks and blocks, so that many are formatted in parallel.
+    for(unsigned int threads: { 1, 4 }) {
+        auto parallel_emitter(csv::Factory<csv::EmitterIface>::produce("jsonl"));
+        auto pipelined_emitter(csv::Factory<csv::EmitterIface>::produce("jsonl"));
+        std::istringstream pipelined_input(data);
+        std::ostringstream parallel;
+        std::ostringstream pipelined;
+
+        parallel_emitter->set_buffer_size(4096);
+        csv::convert(spec, data.data(), data.size(), *parallel_emitter, parallel, threads, 10000);
+        csv::convert(spec, pipelined_input, *pipelined_emitter, pipelined, threads, 0, 1000);
+
+        if (parallel.str() != expect || pipelined.str() != expect) {
+            std::cout << "FAILED: JSON Lines output with " << threads << " threads differs." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Convert in parallel straight to a file, with each worker
+// writing its chunk at its own position, and verify that the
+// file holds the same data as a serial conversion. Files opened
+// for appending, and emitters that cannot format in parallel,
+// are written through a stream instead.
+//
+static bool test_positional(void)
+{
+    const csv::Specification& spec(parallel_test_spec());
+    std::string data(parallel_test_data());
+
+    for(const char* type: { "csv", "yaml", "jsonl", "json" }) {
+        auto emitter(csv::Factory<csv::EmitterIface>::produce(type));
+        std::ostringstream serial;
+        uint32_t serial_count(csv::convert(spec, data.data(), data.size(), *emitter, serial, 1));
+
+        for(int flags: { 0, O_APPEND }) {
+            for(unsigned int threads: { 1, 4 }) {
+                char file_name[] = "/tmp/csv_convert_test.XXXXXX";
+                int fd(mkstemp(file_name));
+
+                // The output follows data already in the file.
+                if (fd == -1 || write(fd, "head\n", 5) != 5 ||
+                    (flags && fcntl(fd, F_SETFL, flags) == -1)) {
+                    std::cout << "Could not create " << file_name << std::endl;
+                    return false;
+                }
+                unlink(file_name);
+
+                uint32_t count(csv::convert(spec, data.data(), data.size(), *emitter, fd, threads, 1000));
+                off_t end(lseek(fd, 0, SEEK_CUR));
+                std::string written(end, '\0');
+
+                if (pread(fd, &written[0], end, 0) != end)
+                    written.clear();
+                close(fd);
+
+                if (count != serial_count || written != "head\n" + serial.str()) {
+                    std::cout << "FAILED: positional convert to " << type << " with " << threads <<
+                        " threads and flags " << flags << " differs." << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//
+// Convert data with invalid records through each reader and
+// convert(), with records skipped and quarantined, and verify that
+// the valid records are converted and the invalid ones reported
+// with their line numbers in input order.
+//
+static bool test_errors(void)
+{
+    const csv::Specification& spec(parallel_test_spec());
+    auto emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+    std::string data("");
+    std::string valid("");
+    std::string expect_quarantine("");
+    std::ostringstream expect;
+
+    for(int i = 0; i < 3000; ++i) {
+        std::string line("A" + std::to_string(i) + "\\,x," + std::to_string(i * 3) + "," + std::to_string(i) + ".5");
+
+        if (i % 97 == 5) {
+            line = "B" + std::to_string(i) + "," + std::to_string(i);
+            expect_quarantine += std::to_string(i + 1) + "\tIncorrect number of fields: 2. Expected: 3\t" + line + "\n";
+        } else if (i % 89 == 7) {
+            line = "C" + std::to_string(i) + ",x" + std::to_string(i) + ",1.5";
+            expect_quarantine += std::to_string(i + 1) + "\tToken for field Second Field: x" +
+                std::to_string(i) + " is not an integer.\t" + line + "\n";
+        } else
+            valid += line + "\n";
+
+        data += line + "\n";
+    }
+    csv::convert(spec, valid.data(), valid.size(), *emitter, expect, 1);
+
+    for(auto policy: { csv::ErrorPolicy::SKIP, csv::ErrorPolicy::QUARANTINE }) {
+        // Serial, through each reader.
+        for(const char* type: { "csv", "csv-mmap" }) {
+            auto ingester(csv::Factory<csv::IngestionIface>::produce(type));
+            std::ostringstream quarantine;
+            csv::ErrorHandler errors(policy, &quarantine);
+            std::istringstream input(data);
+            std::ostringstream result;
+
+            ingester->set_error_handler(errors);
+            csv::convert(spec, *ingester, input, *emitter, result);
+
+            if (result.str() != expect.str() || errors.error_count() != 65 ||
+                quarantine.str() != (policy == csv::ErrorPolicy::QUARANTINE?expect_quarantine:"")) {
+                std::cout << "FAILED: " << type << " reader did not reject invalid records." << std::endl;
+                return false;
+            }
+        }
+
+        for(unsigned int threads: { 1, 4 }) {
+            std::ostringstream parallel_quarantine;
+            std::ostringstream pipelined_quarantine;
+            std::ostringstream positional_quarantine;
+            csv::ErrorHandler parallel_errors(policy, &parallel_quarantine);
+            csv::ErrorHandler pipelined_errors(policy, &pipelined_quarantine);
+            csv::ErrorHandler positional_errors(policy, &positional_quarantine);
+            std::istringstream input(data);
+            std::ostringstream parallel;
+            std::ostringstream pipelined;
+            char file_name[] = "/tmp/csv_convert_test.XXXXXX";
+            int fd(mkstemp(file_name));
+
+            if (fd == -1) {
+                std::cout << "Could not create " << file_name << std::endl;
+                return false;
+            }
+            unlink(file_name);
+
+            csv::convert(spec, data.data(), data.size(), *emitter, parallel, threads, 1000, &parallel_errors);
+            csv::convert(spec, input, *emitter, pipelined, threads, 0, 1000, &pipelined_errors);
+            csv::convert(spec, data.data(), data.size(), *emitter, fd, threads, 1000, &positional_errors);
+
+            off_t end(lseek(fd, 0, SEEK_CUR));
+            std::string positional(end, '\0');
+
+            if (pread(fd, &positional[0], end, 0) != end)
+                positional.clear();
+            close(fd);
+
+            if (parallel.str() != expect.str() || pipelined.str() != expect.str() || positional != expect.str() ||
+                parallel_quarantine.str() != pipelined_quarantine.str() ||
+                positional_quarantine.str() != pipelined_quarantine.str() ||
+                pipelined_quarantine.str() != (policy == csv::ErrorPolicy::QUARANTINE?expect_quarantine:"") ||
+                parallel_errors.error_count() != 65 || pipelined_errors.error_count() != 65 ||
+                positional_errors.error_count() != 65) {
+                std::cout << "FAILED: parallel convert with " << threads <<
+                    " threads did not reject invalid records." << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//
+// Convert quoted data through each reader and convert(), and verify
+// that the output is identical, and that CSV output quotes the
+// fields that need it, reading back as the input.
+//
+static bool test_quoted(void)
+{
+    static const csv::Specification spec({
+            { "Name", "string" },
+            { "Count", "int" },
+            { "Value", "double" }
+        }, ',', 0, {}, "", '"');
+    auto csv_emitter(csv::Factory<csv::EmitterIface>::produce("csv"));
+    auto jsonl_emitter(csv::Factory<csv::EmitterIface>::produce("jsonl"));
+    std::string data("");
+    std::ostringstream expect;
+
+    for(int i = 0; i < 5000; ++i) {
+        if (i % 3 == 0)
+            data += "\"say \"\"" + std::to_string(i) + "\"\", ok\"";
+        else if (i % 7 == 0)
+            data += "\"two\nlines " + std::to_string(i) + "\"";
+        else
+            data += "plain " + std::to_string(i);
+        data += "," + std::to_string(i) + ",\"" + std::to_string(i) + ".5\"\n";
+    }
+
+    // The first record, as read by every reader.
+    expect << "{\"Name\":\"say \\\"0\\\", ok\",\"Count\":0,\"Value\":0.5}\n";
+
+    for(const char* type: { "csv", "csv-mmap" }) {
+        auto ingester(csv::Factory<csv::IngestionIface>::produce(type));
+        std::istringstream input(data);
+        std::ostringstream result;
+
+        csv::convert(spec, *ingester, input, *jsonl_emitter, result);
+
+        if (result.str().compare(0, expect.str().length(), expect.str()) ||
+            result.str().find("\"two\\nlines 7\"") == std::string::npos) {
+            std::cout << "FAILED: " << type << " reader did not read quoted fields." << std::endl;
+            return false;
+        }
+
+        if (std::string(type) == "csv")
+            expect.str(result.str());
+        else if (result.str() != expect.str()) {
+            std::cout << "FAILED: " << type << " reader differs." << std::endl;
+            return false;
+        }
+    }
+
+    // Memory mapped.
+    char file_name[] = "/tmp/csv_convert_test.XXXXXX";
+    int fd(mkstemp(file_name));
+
+    if (fd == -1 || write(fd, data.data(), data.length()) != ssize_t(data.length())) {
+        std::cout << "Could not create " << file_name << std::endl;
+        return false;
+    }
+    close(fd);
+
+    {
+        auto ingester(csv::Factory<csv::IngestionIface>::produce("csv-mmap"));
+        std::istringstream input("");
+        std::ostringstream result;
+
+        ingester->open_file(file_name);
+        csv::convert(spec, *ingester, input, *jsonl_emitter, result);
+        unlink(file_name);
+
+        if (result.str() != expect.str()) {
+            std::cout << "FAILED: memory mapped quoted file differs." << std::endl;
+            return false;
+        }
+    }
+
+    for(unsigned int threads: { 1, 4 }) {
+        std::istringstream input(data);
+        std::ostringstream parallel;
+        std::ostringstream pipelined;
+
+        csv::convert(spec, data.data(), data.size(), *jsonl_emitter, parallel, threads, 1000);
+        csv::convert(spec, input, *jsonl_emitter, pipelined, threads, 0, 1000);
+
+        if (parallel.str() != expect.str() || pipelined.str() != expect.str()) {
+            std::cout << "FAILED: parallel convert of quoted data with " << threads <<
+                " threads differs." << std::endl;
+            return false;
+        }
+    }
+
+    // CSV output reads back the same.
+    std::string quoted("");
+    std::ostringstream round_trip;
+
+    {
+        std::ostringstream result;
+
+        csv::convert(spec, data.data(), data.size(), *csv_emitter, result, 1);
+        quoted = result.str();
+        csv::convert(spec, quoted.data(), quoted.size(), *jsonl_emitter, round_trip, 1);
+    }
+
+    if (round_trip.str() != expect.str() ||
+        quoted.compare(0, 29, "\"say \"\"0\"\", ok\",0,0.5\nplain 1") ) {
+        std::cout << "FAILED: CSV output of quoted data does not read back the same: " <<
+            quoted.substr(0, 40) << std::endl;
+        return false;
+    }
+
+    // Rejected records with newlines, tabs, and backslashes are
+    // written to the quarantine stream as one escaped line, with
+    // the line number counting the newlines of earlier records.
+    std::string invalid("\"two\nlines\",1,2.5\n\"multi\nline\t\\\",zz,1\nok,2,3.5\n");
+    std::string expect_quarantine("3\tToken for field Count: zz is not an integer.\t"
+                                  "\"multi\\nline\\t\\\\\",zz,1\n");
+
+    for(const char* type: { "csv", "csv-mmap", "" }) {
+        std::ostringstream quarantine;
+        csv::ErrorHandler errors(csv::ErrorPolicy::QUARANTINE, &quarantine);
+        std::ostringstream result;
+
+        if (*type) {
+            auto ingester(csv::Factory<csv::IngestionIface>::produce(type));
+            std::istringstream input(invalid);
+
+            ingester->set_error_handler(errors);
+            csv::convert(spec, *ingester, input, *csv_emitter, result);
+        } else
+            csv::convert(spec, invalid.data(), invalid.size(), *csv_emitter, result, 4, 1, &errors);
+
+        if (result.str() != "\"two\nlines\",1,2.5\nok,2,3.5\n" || quarantine.str() != expect_quarantine) {
+            std::cout << "FAILED: quarantined quoted record differs: " << quarantine.str() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
 
 int main(int argc, char* argv[])
 {
@@ -83,6 +1562,64 @@ int main(int argc, char* argv[])
         std::cout << "Second pass:" <<std::endl << out_str_stream2.str() << std::endl<< std::endl;
         exit(255);
     }
+
+    if (!test_parallel())
+        exit(255);
+
+    if (!test_pipelined())
+        exit(255);
+
+    if (!test_projection())
+        exit(255);
+
+    if (!test_filter())
+        exit(255);
+
+    if (!test_static_spec())
+        exit(255);
+
+    if (!test_record_batch())
+        exit(255);
+
+    if (!test_record_pool())
+        exit(255);
+
+    if (!test_parse_numbers())
+        exit(255);
+
+    if (!test_double_round_trip())
+        exit(255);
+
+    if (!test_output_buffer())
+        exit(255);
+
+    if (!test_generator())
+        exit(255);
+
+    if (!test_fd_stream())
+        exit(255);
+
+    if (!test_decompress())
+        exit(255);
+
+    if (!test_columnar())
+        exit(255);
+
+    if (!test_escape())
+        exit(255);
+
+    if (!test_jsonl())
+        exit(255);
+
+    if (!test_positional())
+        exit(255);
+
+    if (!test_errors())
+        exit(255);
+
+    if (!test_quoted())
+        exit(255);
+
     std::cout << "pass." << std::endl;
     exit(0);
 }
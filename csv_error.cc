@@ -0,0 +1,104 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "csv_error.hh"
+#include "csv_stats.hh"
+#include <iostream>
+#include <stdlib.h>
+
+//
+// Write text to the quarantine stream with backslashes, tabs, and
+// newlines escaped, so that each record stays on one line of the
+// quarantine file, and its tab separated columns stay apart.
+//
+static void write_escaped(std::ostream& output, std::string_view text)
+{
+    std::size_t begin(0);
+
+    for(std::size_t index = 0; index < text.size(); ++index) {
+        const char* escape(nullptr);
+
+        switch(text[index]) {
+        case '\\': escape = "\\\\"; break;
+        case '\t': escape = "\\t"; break;
+        case '\n': escape = "\\n"; break;
+        case '\r': escape = "\\r"; break;
+        default: continue;
+        }
+
+        output.write(text.data() + begin, index - begin);
+        output << escape;
+        begin = index + 1;
+    }
+    output.write(text.data() + begin, text.size() - begin);
+}
+
+csv::ErrorHandler::ErrorHandler(ErrorPolicy policy,
+                                std::ostream* quarantine):
+    policy_(policy),
+    quarantine_(quarantine)
+{
+}
+
+void csv::ErrorHandler::report(std::size_t line,
+                               const std::string& reason,
+                               std::string_view text)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (policy_ == ErrorPolicy::FAIL) {
+        std::cerr << "line " << line << ": " << reason << std::endl;
+        exit(255);
+    }
+
+    CSV_STATS_ADD(RECORDS_REJECTED, 1);
+    ++error_count_;
+
+    if (policy_ == ErrorPolicy::QUARANTINE && quarantine_) {
+        *quarantine_ << line << '\t';
+        write_escaped(*quarantine_, reason);
+        *quarantine_ << '\t';
+        write_escaped(*quarantine_, text);
+        *quarantine_ << '\n';
+    }
+}
+
+std::size_t csv::ErrorHandler::error_count(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return error_count_;
+}
+
+csv::ErrorHandler& csv::ErrorHandler::fail(void)
+{
+    static ErrorHandler handler(ErrorPolicy::FAIL);
+
+    return handler;
+}
+
+std::string csv::field_count_error(const Specification& specification,
+                                   uint32_t field_count)
+{
+    return "Incorrect number of fields: " + std::to_string(field_count) +
+        ". Expected: " + std::to_string(specification.input_field_count());
+}
+
+std::string csv::field_value_error(const Specification::Field& field,
+                                   std::string_view token)
+{
+    return "Token for field " + field.name_ + ": " + std::string(token) + " is not " +
+        (field.type_ == csv::FieldType::INT64?"an integer.":"a double.");
+}
@@ -0,0 +1,141 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __CSV_ERROR_HH__
+#define __CSV_ERROR_HH__
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "specification.hh"
+
+namespace csv {
+    /// What to do with a record that cannot be converted.
+    enum class ErrorPolicy {
+        /// Print the error on stderr and exit the program with status 255.
+        FAIL,
+
+        /// Skip the record.
+        SKIP,
+
+        /// Skip the record, and write it to the quarantine stream.
+        QUARANTINE
+    };
+
+    /// A record that could not be converted.
+    //
+    /// Collected by the parallel csv::convert() functions while
+    /// parsing a chunk, and reported in input order once the line
+    /// number of the first line in the chunk is known.
+    ///
+    struct RecordError {
+        /// The line number of the first line of the record, starting at 1.
+        std::size_t line;
+
+        /// Why the record could not be converted.
+        std::string reason;
+
+        /// The line of input data, without its terminating newline.
+        std::string text;
+    };
+
+    /// Handle records that cannot be converted.
+    //
+    /// Ingesters, and the parallel csv::convert() functions, report
+    /// lines with the wrong number of fields or invalid field values
+    /// to an instance of this class, and continue with the next line
+    /// unless the policy is ErrorPolicy::FAIL.
+    ///
+    /// Records are reported only when they fail, so that the
+    /// conversion of valid records pays for nothing but the check
+    /// of the result of each parse.
+    ///
+    /// With ErrorPolicy::QUARANTINE, each failed record is written
+    /// to the quarantine stream as a line of the form
+    /// \code
+    /// <line-number>\t<reason>\t<input-line>
+    /// \endcode
+    /// with each backslash, tab, carriage return, and newline in the
+    /// reason and the input line written as \c \\\\, \c \\t, \c \\r, and
+    /// \c \\n, so that records spanning several lines of input, or
+    /// holding tabs, are still written as one line of three columns.
+    ///
+    /// report() may be called from several threads at once.
+    ///
+    class ErrorHandler {
+    public:
+        /// Constructor.
+        //
+        /// @param policy What to do with records that cannot be converted.
+        /// @param quarantine The stream to write failed records to
+        ///        with ErrorPolicy::QUARANTINE. Must outlive the handler.
+        ///
+        ErrorHandler(ErrorPolicy policy = ErrorPolicy::FAIL,
+                     std::ostream* quarantine = nullptr);
+
+        /// Report a record that could not be converted.
+        //
+        /// Returns, for the caller to skip the record, unless the
+        /// policy is ErrorPolicy::FAIL.
+        ///
+        /// @param line The line number of the first line of the record, starting at 1.
+        ///        Records with quoted or escaped newlines span several lines.
+        /// @param reason Why the record could not be converted.
+        /// @param text The line of input data.
+        ///
+        void report(std::size_t line,
+                    const std::string& reason,
+                    std::string_view text);
+
+        /// Report a record collected by a parallel conversion.
+        //
+        /// @param error The record, with its line number relative to the
+        ///        start of the chunk it was collected from.
+        /// @param first_line The line number of the first line of the chunk.
+        ///
+        void report(const RecordError& error, std::size_t first_line) {
+            report(first_line + error.line - 1, error.reason, error.text);
+        }
+
+        /// Return the policy provided to the constructor.
+        ErrorPolicy policy(void) const { return policy_; }
+
+        /// Return the number of records reported.
+        std::size_t error_count(void) const;
+
+        /// Return a handler with ErrorPolicy::FAIL.
+        //
+        /// Used when no other handler has been provided.
+        ///
+        static ErrorHandler& fail(void);
+
+    private:
+        ErrorPolicy policy_;
+        std::ostream* quarantine_;
+        std::size_t error_count_ { 0 };
+        mutable std::mutex mutex_;
+    };
+
+    /// Return the reason reported for a line with the wrong number of fields.
+    extern std::string field_count_error(const Specification& specification,
+                                         uint32_t field_count);
+
+    /// Return the reason reported for a token that is not a valid value of its field.
+    extern std::string field_value_error(const Specification::Field& field,
+                                         std::string_view token);
+};
+#endif
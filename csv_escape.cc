@@ -0,0 +1,117 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "csv_escape.hh"
+#include <cstring>
+
+csv::Escaper::Escaper(Style style,
+                      char escape_char,
+                      char separator_char,
+                      char quote_char):
+    style_(style),
+    escape_char_(escape_char),
+    quote_char_(quote_char)
+{
+    // Without an escape character, quote strings instead.
+    if (style_ == Style::PREFIX && !escape_char_)
+        style_ = Style::QUOTE;
+
+    // Without a quote character, there is no way to quote anything.
+    if (style_ == Style::QUOTE && !quote_char_)
+        style_ = Style::NONE;
+
+    // Search for the newline twice if we have no quote character.
+    uint8_t quote(quote_char_?quote_char_:'\n');
+
+    switch(style_) {
+    case Style::BACKSLASH:
+        special_ = { '"', '\\', '"', 0x20 };
+        break;
+
+    case Style::PREFIX:
+    case Style::QUOTE:
+        special_ = { uint8_t(separator_char), '\n', quote, 0 };
+        break;
+
+    default:
+        special_ = { 0, 0, 0, 0 };
+        break;
+    }
+}
+
+void csv::Escaper::append_escaped(std::string& output,
+                                  const char* begin,
+                                  const char* special,
+                                  const char* end) const
+{
+    static const char hex[] = "0123456789abcdef";
+
+    if (style_ == Style::QUOTE) {
+        append_quoted(output, begin, special, end);
+        return;
+    }
+
+    while(special != end) {
+        // Copy the run of plain characters in one go.
+        output.append(begin, special);
+
+        if (style_ == Style::PREFIX) {
+            output += escape_char_;
+            output += *special;
+        } else {
+            switch(*special) {
+            case '"':  output.append("\\\""); break;
+            case '\\': output.append("\\\\"); break;
+            case '\b': output.append("\\b"); break;
+            case '\f': output.append("\\f"); break;
+            case '\n': output.append("\\n"); break;
+            case '\r': output.append("\\r"); break;
+            case '\t': output.append("\\t"); break;
+            default: {
+                char escape[] = { '\\', 'u', '0', '0', hex[uint8_t(*special) >> 4], hex[*special & 0xf] };
+                output.append(escape, sizeof(escape));
+                break;
+            }
+            }
+        }
+        begin = special + 1;
+        special = find_special(begin, end, special_);
+    }
+    output.append(begin, end);
+}
+
+void csv::Escaper::append_quoted(std::string& output,
+                                 const char* begin,
+                                 const char* special,
+                                 const char* end) const
+{
+    output += quote_char_;
+
+    while(special != end) {
+        // Separators and newlines are written as is inside the quotes.
+        // Quotes are doubled.
+        const char* quote(static_cast<const char*>(memchr(special, quote_char_, end - special)));
+
+        if (!quote)
+            break;
+
+        output.append(begin, quote + 1);
+        output += quote_char_;
+        begin = quote + 1;
+        special = begin;
+    }
+    output.append(begin, end);
+    output += quote_char_;
+}
@@ -0,0 +1,112 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __CSV_ESCAPE_HH__
+#define __CSV_ESCAPE_HH__
+#include "csv_simd.hh"
+#include <string>
+#include <string_view>
+
+namespace csv {
+    /// Escape string values written by the emitters.
+    //
+    /// Instances of this class append a string to an output buffer,
+    /// escaping the characters that would otherwise end the string
+    /// or break the output format.
+    ///
+    /// The string is scanned with csv::find_special(), 16 to 64 bytes
+    /// at a time, and runs of characters that need no escaping are
+    /// copied to the output with a single append. Since most strings
+    /// contain nothing to escape, they are typically written with a
+    /// single scan and a single copy.
+    ///
+    class Escaper {
+    public:
+        /// How characters are escaped.
+        enum class Style {
+            /// Strings are written as is.
+            NONE,
+
+            /// JSON string escapes: \c \\", \c \\\\, \c \\n, \c \\u001f, etc.
+            /// Also used for YAML double quoted strings, which accept
+            /// the same escapes.
+            BACKSLASH,
+
+            /// The escape character is written before each separator,
+            /// newline, and quote, as read by csv::tokenize_line(). The
+            /// tokenizer has no way to read a literal escape
+            /// character, so it is not escaped.
+            PREFIX,
+
+            /// Strings with separators, newlines, or quotes are
+            /// enclosed in quotes, with each quote doubled, as read by
+            /// csv::StructuralTokenizer.
+            QUOTE
+        };
+
+        /// Constructor.
+        //
+        /// @param style How to escape characters.
+        /// @param escape_char The escape character of a Style::PREFIX escaper.
+        ///        If 0, the escaper uses Style::QUOTE instead.
+        /// @param separator_char The separator character of a Style::PREFIX or Style::QUOTE escaper.
+        /// @param quote_char The quote character of a Style::PREFIX or Style::QUOTE escaper.
+        ///        If 0, quotes are not escaped, and a Style::QUOTE escaper escapes nothing.
+        ///
+        Escaper(Style style = Style::NONE,
+                char escape_char = 0,
+                char separator_char = 0,
+                char quote_char = 0);
+
+        /// Append \a value, escaped, to \a output.
+        void append(std::string& output, std::string_view value) const {
+            if (style_ == Style::NONE) {
+                output.append(value);
+                return;
+            }
+
+            const char* end(value.data() + value.size());
+            const char* special(find_special(value.data(), end, special_));
+
+            // Common case: nothing to escape.
+            if (special == end) {
+                output.append(value);
+                return;
+            }
+
+            append_escaped(output, value.data(), special, end);
+        }
+
+        /// Return the style provided to the constructor.
+        Style style(void) const { return style_; }
+
+    private:
+        void append_escaped(std::string& output,
+                            const char* begin,
+                            const char* special,
+                            const char* end) const;
+
+        void append_quoted(std::string& output,
+                           const char* begin,
+                           const char* special,
+                           const char* end) const;
+
+        Style style_;
+        char escape_char_;
+        char quote_char_;
+        SpecialChars special_;
+    };
+};
+#endif
@@ -0,0 +1,50 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Number formatting shared by all emitters.
+#include "csv_format.hh"
+#include <charconv>
+
+char* csv::format_int64(char* buffer, int64_t value)
+{
+    return std::to_chars(buffer, buffer + max_number_length, value).ptr;
+}
+
+char* csv::format_double(char* buffer, double value)
+{
+    // Without a format or precision, std::to_chars() produces the
+    // shortest representation that round trips.
+    return std::to_chars(buffer, buffer + max_number_length, value).ptr;
+}
+
+//
+// The append functions format straight into the tail of the
+// output string, avoiding any temporary string.
+//
+void csv::append_int64(std::string& output, int64_t value)
+{
+    std::size_t length(output.length());
+
+    output.resize(length + max_number_length);
+    output.resize(format_int64(&output[length], value) - output.data());
+}
+
+void csv::append_double(std::string& output, double value)
+{
+    std::size_t length(output.length());
+
+    output.resize(length + max_number_length);
+    output.resize(format_double(&output[length], value) - output.data());
+}
@@ -0,0 +1,66 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __CSV_FORMAT_HH__
+#define __CSV_FORMAT_HH__
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace csv {
+    /// The maximum number of characters written by format_int64() and format_double().
+    constexpr std::size_t max_number_length = 32;
+
+    /// Format an integer value.
+    //
+    /// Writes the decimal representation of \a value, without any
+    /// locale specific formatting, to \a buffer.
+    ///
+    /// @param buffer The buffer to write to. Must hold at least max_number_length characters.
+    /// @param value The value to format.
+    ///
+    /// @return Pointer to the character after the last written character.
+    ///
+    extern char* format_int64(char* buffer, int64_t value);
+
+    /// Format a double value.
+    //
+    /// Writes the shortest representation of \a value that parses
+    /// back to exactly the same value to \a buffer. Fixed or
+    /// scientific notation is used, whichever is shorter.
+    ///
+    /// Formatting is locale independent, and no precision is lost
+    /// when the value is converted back by csv::parse_double().
+    ///
+    /// @param buffer The buffer to write to. Must hold at least max_number_length characters.
+    /// @param value The value to format.
+    ///
+    /// @return Pointer to the character after the last written character.
+    ///
+    extern char* format_double(char* buffer, double value);
+
+    /// Append a formatted integer value to a string.
+    //
+    /// See format_int64().
+    ///
+    extern void append_int64(std::string& output, int64_t value);
+
+    /// Append a formatted double value to a string.
+    //
+    /// See format_double().
+    ///
+    extern void append_double(std::string& output, double value);
+};
+#endif
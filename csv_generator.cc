@@ -0,0 +1,130 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "csv_generator.hh"
+#include "csv_format.hh"
+
+//
+// std::mt19937_64 produces the same sequence on all platforms,
+// while the standard distributions do not. Values are therefore
+// derived from the raw sequence.
+//
+csv::Generator::Generator(const Specification& specification,
+                          uint64_t seed,
+                          std::size_t max_string_length,
+                          double escape_density):
+    specification_(specification),
+    rng_(seed),
+    max_string_length_(max_string_length),
+    escape_threshold_(uint64_t(escape_density * 1000000))
+{
+}
+
+void csv::Generator::append_record(std::string& output)
+{
+    static const char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyz"
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+        "0123456789";
+    bool first_field(true);
+
+    for(const auto& field: specification_.input_fields()) {
+        if (!first_field)
+            output += specification_.separator_char();
+
+        first_field = false;
+
+        switch(field.type_) {
+        case csv::FieldType::INT64: {
+            // Pick a magnitude first, so that short and long
+            // numbers are equally common.
+            uint64_t value(rng_() >> next(64));
+
+            csv::append_int64(output, (rng_() & 1)?-int64_t(value >> 1):int64_t(value >> 1));
+            break;
+        }
+
+        case csv::FieldType::DOUBLE: {
+            // A 53 bit mantissa in 0.0 - 1.0, scaled by a random power of ten.
+            double value(double(rng_() >> 11) / double(uint64_t(1) << 53));
+            int exponent(int(next(13)) - 6);
+
+            for(; exponent > 0; --exponent)
+                value *= 10.0;
+
+            for(; exponent < 0; ++exponent)
+                value /= 10.0;
+
+            // Round some values, to mix short and long fractions.
+            if (rng_() & 1)
+                value = double(int64_t(value * 1000.0)) / 1000.0;
+
+            csv::append_double(output, (rng_() & 1)?-value:value);
+            break;
+        }
+
+        case csv::FieldType::STRING: {
+            std::size_t length(next(max_string_length_ + 1));
+            std::size_t start(output.length());
+            bool quote(false);
+
+            for(std::size_t i = 0; i < length; ++i) {
+                if (specification_.escape_char() && next(1000000) < escape_threshold_) {
+                    output += specification_.escape_char();
+                    output += specification_.separator_char();
+                    continue;
+                }
+
+                if (!specification_.escape_char() && specification_.quote_char() &&
+                    next(1000000) < escape_threshold_) {
+                    output += specification_.separator_char();
+                    quote = true;
+                    continue;
+                }
+                output += alphabet[next(sizeof(alphabet) - 1)];
+            }
+
+            // Quote strings with separators if there is no escape character.
+            if (quote) {
+                output.insert(start, 1, specification_.quote_char());
+                output += specification_.quote_char();
+            }
+            break;
+        }
+        }
+    }
+    output += '\n';
+}
+
+std::size_t csv::Generator::generate(std::ostream& output, std::size_t size)
+{
+    std::string block("");
+    std::size_t written(0);
+    std::size_t records(0);
+
+    block.reserve(1024*1024 + 4096);
+    while(written < size) {
+        block.clear();
+
+        while(block.length() < 1024*1024 && written + block.length() < size) {
+            append_record(block);
+            ++records;
+        }
+
+        output.write(block.data(), block.length());
+        written += block.length();
+    }
+    return records;
+}
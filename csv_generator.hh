@@ -0,0 +1,89 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __CSV_GENERATOR_HH__
+#define __CSV_GENERATOR_HH__
+#include "specification.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <ostream>
+#include <random>
+
+namespace csv {
+    /// A deterministic generator of synthetic CSV data.
+    //
+    /// Generates records matching the fields of a specification,
+    /// for benchmarks and tests. The same seed and settings always
+    /// produce the same data, on every platform.
+    ///
+    /// Field values are generated as follows:
+    ///
+    ///   - csv::FieldType::INT64 fields get integers of random magnitude,
+    ///     from single digits to the full 64 bit range.
+    ///   - csv::FieldType::DOUBLE fields get doubles of random magnitude
+    ///     and precision.
+    ///   - csv::FieldType::STRING fields get 0 to \c max_string_length
+    ///     alphanumeric characters. If the specification has an escape
+    ///     character, each character is replaced by an escaped
+    ///     separator with a probability of \c escape_density. Without
+    ///     one, but with a quote character, it is replaced by a
+    ///     separator, and strings with separators are quoted.
+    ///
+    /// Escaped newlines are never generated, since not all ingesters
+    /// support them.
+    ///
+    class Generator {
+    public:
+        /// Constructor.
+        //
+        /// @param specification The specification of the records to generate.
+        /// @param seed The seed of the pseudo random sequence.
+        /// @param max_string_length The maximum number of characters in a string field.
+        /// @param escape_density The probability, 0.0 - 1.0, of a string character being an escaped separator.
+        ///
+        Generator(const Specification& specification,
+                  uint64_t seed = 1,
+                  std::size_t max_string_length = 16,
+                  double escape_density = 0.0);
+
+        /// Append a single record, terminated by a newline, to \a output.
+        void append_record(std::string& output);
+
+        /// Write records to a stream.
+        //
+        /// Writes whole records to \a output until at least \a size
+        /// bytes have been written.
+        ///
+        /// @param output The stream to write to.
+        /// @param size The minimum number of bytes to write.
+        ///
+        /// @return The number of records written.
+        ///
+        std::size_t generate(std::ostream& output, std::size_t size);
+
+    private:
+        // Return a value in the range 0 - limit-1.
+        uint64_t next(uint64_t limit) { return rng_() % limit; }
+
+        const Specification& specification_;
+        std::mt19937_64 rng_;
+        std::size_t max_string_length_;
+
+        // escape_density scaled to the range of next(1000000).
+        uint64_t escape_threshold_;
+    };
+};
+#endif
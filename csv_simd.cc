@@ -0,0 +1,619 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Vectorized scanning functions with runtime CPU dispatch.
+#include "csv_simd.hh"
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CSV_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    typedef const char* (*FindFirstOfFunc)(const char*, const char*, uint8_t, uint8_t);
+    typedef const char* (*FindSpecialFunc)(const char*, const char*, const csv::SpecialChars&);
+    typedef std::size_t (*IndexStructureFunc)(const char*, const char*, const csv::StructuralChars&,
+                                              csv::StructuralState&, uint32_t*);
+
+    // Bitmasks of the characters in a 64 byte block, one bit per byte.
+    struct BlockMasks {
+        uint64_t separator;
+        uint64_t newline;
+        uint64_t quote;
+        uint64_t escape;
+    };
+
+    // Prefix XOR without carry-less multiplication. Bit i of the
+    // result is the XOR of bits 0 - i of 'bits'.
+    inline uint64_t prefix_xor_shift(uint64_t bits)
+    {
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+        return bits;
+    }
+
+    // Remove the escaped characters from 'masks', and return the
+    // quote mask to take the prefix XOR of. 'length' is the number
+    // of bytes in the block.
+    inline uint64_t resolve_escapes(BlockMasks& masks, csv::StructuralState& state, unsigned int length = 64)
+    {
+        // The character after a run of escape characters is escaped.
+        // Escape characters are never data themselves.
+        uint64_t escaped(((masks.escape << 1) | state.escaped) & ~masks.escape);
+
+        state.escaped = (masks.escape >> (length - 1)) & 1;
+        masks.separator &= ~escaped;
+        masks.newline &= ~escaped;
+        masks.quote &= ~escaped;
+        return masks.quote;
+    }
+
+    // Add the unquoted separators and newlines of a block at
+    // 'offset' to 'positions', given the prefix XOR of its quotes.
+    inline std::size_t add_structural(const BlockMasks& masks,
+                                      uint64_t quote_prefix,
+                                      csv::StructuralState& state,
+                                      uint32_t offset,
+                                      uint32_t* positions)
+    {
+        uint64_t quoted(quote_prefix ^ state.quoted);
+        uint64_t structural((masks.separator | masks.newline) & ~quoted);
+        uint64_t special(masks.quote | masks.escape);
+        std::size_t count(0);
+
+        state.quoted = uint64_t(int64_t(quoted) >> 63);
+
+        if (!positions)
+            return 0;
+
+        while(structural) {
+            unsigned int bit(__builtin_ctzll(structural));
+            uint64_t below((uint64_t(1) << bit) - 1);
+            uint32_t entry(offset + bit);
+
+            if (state.special || (special & below))
+                entry |= csv::structural_special;
+
+            if ((masks.newline >> bit) & 1)
+                entry |= csv::structural_newline;
+
+            positions[count++] = entry;
+            special &= ~below;
+            state.special = false;
+            structural &= structural - 1;
+        }
+        state.special |= special != 0;
+        return count;
+    }
+
+    // The masks of a 64 byte block, one byte at a time.
+    inline BlockMasks block_masks_scalar(const char* block, const csv::StructuralChars& chars)
+    {
+        BlockMasks masks { 0, 0, 0, 0 };
+
+        for(unsigned int i = 0; i < 64; ++i) {
+            uint8_t ch(block[i]);
+            uint64_t bit(uint64_t(1) << i);
+
+            if (ch == chars.separator) masks.separator |= bit;
+            if (ch == '\n') masks.newline |= bit;
+            if (chars.quote && ch == chars.quote) masks.quote |= bit;
+            if (chars.escape && ch == chars.escape) masks.escape |= bit;
+        }
+        return masks;
+    }
+
+    std::size_t index_structure_scalar(const char* begin,
+                                       const char* end,
+                                       const csv::StructuralChars& chars,
+                                       csv::StructuralState& state,
+                                       uint32_t* positions)
+    {
+        std::size_t count(0);
+        uint32_t offset(0);
+        char tail[64];
+
+        for(; end - begin >= 64; begin += 64, offset += 64) {
+            BlockMasks masks(block_masks_scalar(begin, chars));
+
+            count += add_structural(masks, prefix_xor_shift(resolve_escapes(masks, state)),
+                                    state, offset, positions?positions + count:nullptr);
+        }
+
+        // Pad the last block with bytes that match nothing.
+        if (begin != end) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, begin, end - begin);
+
+            BlockMasks masks(block_masks_scalar(tail, chars));
+            count += add_structural(masks, prefix_xor_shift(resolve_escapes(masks, state, end - begin)),
+                                    state, offset, positions?positions + count:nullptr);
+        }
+        return count;
+    }
+
+    const char* find_first_of_scalar(const char* begin,
+                                     const char* end,
+                                     uint8_t first,
+                                     uint8_t second)
+    {
+        for(; begin != end; ++begin) {
+            uint8_t ch(*begin);
+            if (ch == first || ch == second)
+                return begin;
+        }
+        return end;
+    }
+
+    const char* find_special_scalar(const char* begin,
+                                    const char* end,
+                                    const csv::SpecialChars& special)
+    {
+        for(; begin != end; ++begin) {
+            uint8_t ch(*begin);
+            if (ch == special.first || ch == special.second || ch == special.third || ch < special.below)
+                return begin;
+        }
+        return end;
+    }
+
+#ifdef CSV_SIMD_X86
+    __attribute__((target("sse2")))
+    const char* find_first_of_sse2(const char* begin,
+                                   const char* end,
+                                   uint8_t first,
+                                   uint8_t second)
+    {
+        const __m128i first_v(_mm_set1_epi8(first));
+        const __m128i second_v(_mm_set1_epi8(second));
+
+        while(end - begin >= 16) {
+            __m128i data(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)));
+            unsigned int mask(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(data, first_v),
+                                                             _mm_cmpeq_epi8(data, second_v))));
+            if (mask)
+                return begin + __builtin_ctz(mask);
+
+            begin += 16;
+        }
+        return find_first_of_scalar(begin, end, first, second);
+    }
+
+    // Unsigned byte comparison: ch < below if min(ch, below - 1) == ch.
+    // With below = 0, no byte matches.
+    __attribute__((target("sse2")))
+    const char* find_special_sse2(const char* begin,
+                                  const char* end,
+                                  const csv::SpecialChars& special)
+    {
+        const __m128i first_v(_mm_set1_epi8(special.first));
+        const __m128i second_v(_mm_set1_epi8(special.second));
+        const __m128i third_v(_mm_set1_epi8(special.third));
+        const __m128i below_v(_mm_set1_epi8(special.below - 1));
+        const __m128i below_on(_mm_set1_epi8(special.below?0xff:0));
+
+        while(end - begin >= 16) {
+            __m128i data(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)));
+            __m128i hit(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(data, first_v),
+                                                  _mm_cmpeq_epi8(data, second_v)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(data, third_v),
+                                                  _mm_and_si128(below_on,
+                                                                _mm_cmpeq_epi8(_mm_min_epu8(data, below_v), data)))));
+            unsigned int mask(_mm_movemask_epi8(hit));
+
+            if (mask)
+                return begin + __builtin_ctz(mask);
+
+            begin += 16;
+        }
+        return find_special_scalar(begin, end, special);
+    }
+
+    __attribute__((target("avx2")))
+    const char* find_first_of_avx2(const char* begin,
+                                   const char* end,
+                                   uint8_t first,
+                                   uint8_t second)
+    {
+        const __m256i first_v(_mm256_set1_epi8(first));
+        const __m256i second_v(_mm256_set1_epi8(second));
+
+        while(end - begin >= 32) {
+            __m256i data(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)));
+            unsigned int mask(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(data, first_v),
+                                                                   _mm256_cmpeq_epi8(data, second_v))));
+            if (mask)
+                return begin + __builtin_ctz(mask);
+
+            begin += 32;
+        }
+        // The SSE2 code is not VEX encoded. Clear the upper halves of
+        // the registers first, or it runs at a fraction of its speed.
+        _mm256_zeroupper();
+        return find_first_of_sse2(begin, end, first, second);
+    }
+
+    __attribute__((target("avx2")))
+    const char* find_special_avx2(const char* begin,
+                                  const char* end,
+                                  const csv::SpecialChars& special)
+    {
+        const __m256i first_v(_mm256_set1_epi8(special.first));
+        const __m256i second_v(_mm256_set1_epi8(special.second));
+        const __m256i third_v(_mm256_set1_epi8(special.third));
+        const __m256i below_v(_mm256_set1_epi8(special.below - 1));
+        const __m256i below_on(_mm256_set1_epi8(special.below?0xff:0));
+
+        while(end - begin >= 32) {
+            __m256i data(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)));
+            __m256i hit(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(data, first_v),
+                                                        _mm256_cmpeq_epi8(data, second_v)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(data, third_v),
+                                                        _mm256_and_si256(below_on,
+                                                                         _mm256_cmpeq_epi8(_mm256_min_epu8(data, below_v), data)))));
+            unsigned int mask(_mm256_movemask_epi8(hit));
+
+            if (mask)
+                return begin + __builtin_ctz(mask);
+
+            begin += 32;
+        }
+        _mm256_zeroupper();
+        return find_special_sse2(begin, end, special);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    const char* find_first_of_avx512(const char* begin,
+                                     const char* end,
+                                     uint8_t first,
+                                     uint8_t second)
+    {
+        const __m512i first_v(_mm512_set1_epi8(first));
+        const __m512i second_v(_mm512_set1_epi8(second));
+
+        while(begin != end) {
+            // Masked loads do not fault on bytes outside the mask,
+            // so the tail is handled without a scalar loop.
+            std::size_t len(end - begin);
+            __mmask64 load_mask(len >= 64?~__mmask64(0):((__mmask64(1) << len) - 1));
+            __m512i data(_mm512_maskz_loadu_epi8(load_mask, begin));
+            __mmask64 mask((_mm512_cmpeq_epi8_mask(data, first_v) |
+                            _mm512_cmpeq_epi8_mask(data, second_v)) & load_mask);
+
+            if (mask)
+                return begin + __builtin_ctzll(mask);
+
+            begin += (len >= 64)?64:len;
+        }
+        return end;
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    const char* find_special_avx512(const char* begin,
+                                    const char* end,
+                                    const csv::SpecialChars& special)
+    {
+        const __m512i first_v(_mm512_set1_epi8(special.first));
+        const __m512i second_v(_mm512_set1_epi8(special.second));
+        const __m512i third_v(_mm512_set1_epi8(special.third));
+        const __m512i below_v(_mm512_set1_epi8(special.below));
+
+        while(begin != end) {
+            std::size_t len(end - begin);
+            __mmask64 load_mask(len >= 64?~__mmask64(0):((__mmask64(1) << len) - 1));
+            __m512i data(_mm512_maskz_loadu_epi8(load_mask, begin));
+            __mmask64 mask((_mm512_cmpeq_epi8_mask(data, first_v) |
+                            _mm512_cmpeq_epi8_mask(data, second_v) |
+                            _mm512_cmpeq_epi8_mask(data, third_v) |
+                            _mm512_cmplt_epu8_mask(data, below_v)) & load_mask);
+
+            if (mask)
+                return begin + __builtin_ctzll(mask);
+
+            begin += (len >= 64)?64:len;
+        }
+        return end;
+    }
+
+    // Bitmask of the bytes in a 16 byte vector equal to 'ch', or 0 if 'enabled' is 0.
+    __attribute__((target("sse2")))
+    inline uint64_t mask_sse2(const __m128i data[4], __m128i ch, uint64_t enabled)
+    {
+        uint64_t mask(0);
+
+        for(unsigned int i = 0; i < 4; ++i)
+            mask |= uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(data[i], ch)))) << (16 * i);
+
+        return mask & enabled;
+    }
+
+    __attribute__((target("sse2")))
+    inline BlockMasks block_masks_sse2(const char* block, const csv::StructuralChars& chars)
+    {
+        __m128i data[4];
+
+        for(unsigned int i = 0; i < 4; ++i)
+            data[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+
+        return BlockMasks {
+            mask_sse2(data, _mm_set1_epi8(chars.separator), ~uint64_t(0)),
+            mask_sse2(data, _mm_set1_epi8('\n'), ~uint64_t(0)),
+            mask_sse2(data, _mm_set1_epi8(chars.quote), chars.quote?~uint64_t(0):0),
+            mask_sse2(data, _mm_set1_epi8(chars.escape), chars.escape?~uint64_t(0):0)
+        };
+    }
+
+    __attribute__((target("sse2")))
+    std::size_t index_structure_sse2(const char* begin,
+                                     const char* end,
+                                     const csv::StructuralChars& chars,
+                                     csv::StructuralState& state,
+                                     uint32_t* positions)
+    {
+        std::size_t count(0);
+        uint32_t offset(0);
+        char tail[64];
+
+        for(; end - begin >= 64; begin += 64, offset += 64) {
+            BlockMasks masks(block_masks_sse2(begin, chars));
+
+            count += add_structural(masks, prefix_xor_shift(resolve_escapes(masks, state)),
+                                    state, offset, positions?positions + count:nullptr);
+        }
+
+        if (begin != end) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, begin, end - begin);
+
+            BlockMasks masks(block_masks_sse2(tail, chars));
+            count += add_structural(masks, prefix_xor_shift(resolve_escapes(masks, state, end - begin)),
+                                    state, offset, positions?positions + count:nullptr);
+        }
+        return count;
+    }
+
+    // Prefix XOR as a carry-less multiplication by all ones.
+    __attribute__((target("pclmul")))
+    inline uint64_t prefix_xor_clmul(uint64_t bits)
+    {
+        return _mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, bits),
+                                                      _mm_set1_epi8(char(0xff)), 0));
+    }
+
+    __attribute__((target("avx2")))
+    inline uint64_t mask_avx2(__m256i low, __m256i high, __m256i ch, uint64_t enabled)
+    {
+        uint64_t mask(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, ch))) |
+                      (uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, ch)))) << 32));
+
+        return mask & enabled;
+    }
+
+    __attribute__((target("avx2")))
+    inline BlockMasks block_masks_avx2(const char* block, const csv::StructuralChars& chars)
+    {
+        __m256i low(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)));
+        __m256i high(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32)));
+
+        return BlockMasks {
+            mask_avx2(low, high, _mm256_set1_epi8(chars.separator), ~uint64_t(0)),
+            mask_avx2(low, high, _mm256_set1_epi8('\n'), ~uint64_t(0)),
+            mask_avx2(low, high, _mm256_set1_epi8(chars.quote), chars.quote?~uint64_t(0):0),
+            mask_avx2(low, high, _mm256_set1_epi8(chars.escape), chars.escape?~uint64_t(0):0)
+        };
+    }
+
+    __attribute__((target("avx2,pclmul")))
+    std::size_t index_structure_avx2(const char* begin,
+                                     const char* end,
+                                     const csv::StructuralChars& chars,
+                                     csv::StructuralState& state,
+                                     uint32_t* positions)
+    {
+        std::size_t count(0);
+        uint32_t offset(0);
+        char tail[64];
+
+        for(; end - begin >= 64; begin += 64, offset += 64) {
+            BlockMasks masks(block_masks_avx2(begin, chars));
+
+            count += add_structural(masks, prefix_xor_clmul(resolve_escapes(masks, state)),
+                                    state, offset, positions?positions + count:nullptr);
+        }
+
+        if (begin != end) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, begin, end - begin);
+
+            BlockMasks masks(block_masks_avx2(tail, chars));
+            count += add_structural(masks, prefix_xor_clmul(resolve_escapes(masks, state, end - begin)),
+                                    state, offset, positions?positions + count:nullptr);
+        }
+        return count;
+    }
+
+    __attribute__((target("avx512f,avx512bw,pclmul")))
+    std::size_t index_structure_avx512(const char* begin,
+                                       const char* end,
+                                       const csv::StructuralChars& chars,
+                                       csv::StructuralState& state,
+                                       uint32_t* positions)
+    {
+        const __m512i separator_v(_mm512_set1_epi8(chars.separator));
+        const __m512i newline_v(_mm512_set1_epi8('\n'));
+        const __m512i quote_v(_mm512_set1_epi8(chars.quote));
+        const __m512i escape_v(_mm512_set1_epi8(chars.escape));
+        const uint64_t quote_on(chars.quote?~uint64_t(0):0);
+        const uint64_t escape_on(chars.escape?~uint64_t(0):0);
+        std::size_t count(0);
+        uint32_t offset(0);
+
+        while(begin != end) {
+            // The masked load handles the last block without padding.
+            std::size_t len(end - begin);
+            __mmask64 load_mask(len >= 64?~__mmask64(0):((__mmask64(1) << len) - 1));
+            __m512i data(_mm512_maskz_loadu_epi8(load_mask, begin));
+            BlockMasks masks {
+                _mm512_cmpeq_epi8_mask(data, separator_v) & load_mask,
+                _mm512_cmpeq_epi8_mask(data, newline_v) & load_mask,
+                _mm512_cmpeq_epi8_mask(data, quote_v) & load_mask & quote_on,
+                _mm512_cmpeq_epi8_mask(data, escape_v) & load_mask & escape_on
+            };
+
+            count += add_structural(masks, prefix_xor_clmul(resolve_escapes(masks, state, len >= 64?64:len)),
+                                    state, offset, positions?positions + count:nullptr);
+
+            begin += (len >= 64)?64:len;
+            offset += 64;
+        }
+        return count;
+    }
+#endif
+
+    csv::SimdLevel detect_simd_level(void)
+    {
+#ifdef CSV_SIMD_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            return csv::SimdLevel::AVX512;
+
+        if (__builtin_cpu_supports("avx2"))
+            return csv::SimdLevel::AVX2;
+
+        if (__builtin_cpu_supports("sse2"))
+            return csv::SimdLevel::SSE2;
+#endif
+        return csv::SimdLevel::SCALAR;
+    }
+
+    FindFirstOfFunc find_first_of_func(csv::SimdLevel level)
+    {
+        switch(level) {
+#ifdef CSV_SIMD_X86
+        case csv::SimdLevel::AVX512:
+            return find_first_of_avx512;
+
+        case csv::SimdLevel::AVX2:
+            return find_first_of_avx2;
+
+        case csv::SimdLevel::SSE2:
+            return find_first_of_sse2;
+#endif
+        default:
+            return find_first_of_scalar;
+        }
+    }
+
+    FindSpecialFunc find_special_func(csv::SimdLevel level)
+    {
+        switch(level) {
+#ifdef CSV_SIMD_X86
+        case csv::SimdLevel::AVX512:
+            return find_special_avx512;
+
+        case csv::SimdLevel::AVX2:
+            return find_special_avx2;
+
+        case csv::SimdLevel::SSE2:
+            return find_special_sse2;
+#endif
+        default:
+            return find_special_scalar;
+        }
+    }
+
+    IndexStructureFunc index_structure_func(csv::SimdLevel level)
+    {
+#ifdef CSV_SIMD_X86
+        // The AVX2 and AVX-512 indexers also need carry-less multiplication.
+        if (level >= csv::SimdLevel::AVX2 && !__builtin_cpu_supports("pclmul"))
+            level = csv::SimdLevel::SSE2;
+#endif
+        switch(level) {
+#ifdef CSV_SIMD_X86
+        case csv::SimdLevel::AVX512:
+            return index_structure_avx512;
+
+        case csv::SimdLevel::AVX2:
+            return index_structure_avx2;
+
+        case csv::SimdLevel::SSE2:
+            return index_structure_sse2;
+#endif
+        default:
+            return index_structure_scalar;
+        }
+    }
+
+    // Selected at program startup.
+    const csv::SimdLevel supported_level(detect_simd_level());
+    csv::SimdLevel current_level(supported_level);
+    FindFirstOfFunc current_find_first_of(find_first_of_func(supported_level));
+    FindSpecialFunc current_find_special(find_special_func(supported_level));
+    IndexStructureFunc current_index_structure(index_structure_func(supported_level));
+}
+
+csv::SimdLevel csv::simd_level(void)
+{
+    return current_level;
+}
+
+csv::SimdLevel csv::simd_level_supported(void)
+{
+    return supported_level;
+}
+
+bool csv::set_simd_level(csv::SimdLevel level)
+{
+    if (level > supported_level)
+        return false;
+
+    current_level = level;
+    current_find_first_of = find_first_of_func(level);
+    current_find_special = find_special_func(level);
+    current_index_structure = index_structure_func(level);
+    return true;
+}
+
+const char* csv::find_first_of(const char* begin,
+                               const char* end,
+                               uint8_t first,
+                               uint8_t second)
+{
+    return current_find_first_of(begin, end, first, second);
+}
+
+const char* csv::find_special(const char* begin,
+                              const char* end,
+                              const csv::SpecialChars& special)
+{
+    return current_find_special(begin, end, special);
+}
+
+std::size_t csv::index_structure(const char* begin,
+                                 const char* end,
+                                 const csv::StructuralChars& chars,
+                                 csv::StructuralState& state,
+                                 uint32_t* positions)
+{
+    return current_index_structure(begin, end, chars, state, positions);
+}
@@ -0,0 +1,175 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __CSV_SIMD_HH__
+#define __CSV_SIMD_HH__
+#include <cstddef>
+#include <cstdint>
+
+namespace csv {
+    /// The instruction set used by the vectorized scanning functions.
+    //
+    /// The best level supported by the CPU is selected at program
+    /// startup. Levels are ordered from least to most capable.
+    ///
+    enum class SimdLevel {
+        SCALAR, SSE2, AVX2, AVX512
+    };
+
+    /// A set of characters to search for with find_special().
+    //
+    /// Matches bytes equal to any of \a first, \a second, and
+    /// \a third, and bytes, taken as unsigned, less than \a below.
+    /// Repeat a character to search for fewer than three, and set
+    /// \a below to 0 to not match any byte by value.
+    ///
+    struct SpecialChars {
+        uint8_t first;
+        uint8_t second;
+        uint8_t third;
+        uint8_t below;
+    };
+
+    /// The characters that structure CSV data, for index_structure().
+    //
+    /// Set \a escape or \a quote to 0 if not used.
+    ///
+    struct StructuralChars {
+        uint8_t separator;
+        uint8_t escape;
+        uint8_t quote;
+    };
+
+    /// Quote and escape state carried between calls to index_structure().
+    //
+    /// A default constructed state is the state at the start of a record.
+    ///
+    struct StructuralState {
+        /// All bits set if the next byte is inside quotes, else 0.
+        uint64_t quoted { 0 };
+
+        /// 1 if the next byte is escaped, else 0.
+        uint64_t escaped { 0 };
+
+        /// true if a quote or escape character was seen after the
+        /// last separator or newline.
+        bool special { false };
+    };
+
+    /// Set in an entry returned by index_structure() for a newline.
+    constexpr uint32_t structural_newline = uint32_t(1) << 31;
+
+    /// Set in an entry returned by index_structure() if the field
+    /// ending at the entry has quote or escape characters.
+    constexpr uint32_t structural_special = uint32_t(1) << 30;
+
+    /// The offset bits of an entry returned by index_structure().
+    constexpr uint32_t structural_offset_mask = structural_special - 1;
+
+    /// The largest range that index_structure() accepts.
+    constexpr std::size_t structural_max_size = structural_offset_mask;
+
+    /// Return the instruction set currently used by the scanning functions.
+    extern SimdLevel simd_level(void);
+
+    /// Return the most capable instruction set supported by the CPU.
+    extern SimdLevel simd_level_supported(void);
+
+    /// Select the instruction set to use by the scanning functions.
+    //
+    /// This is mainly used by tests to compare the output of the
+    /// different implementations.
+    ///
+    /// @param level The instruction set to use.
+    ///
+    /// @return true - The instruction set was selected.
+    /// @return false - \a level is not supported by the CPU.
+    ///
+    extern bool set_simd_level(SimdLevel level);
+
+    /// Find the first occurrence of either of two characters.
+    //
+    /// Scans the range \a begin - \a end, 16 to 64 bytes at a time
+    /// depending on simd_level(), for the first character that
+    /// equals \a first or \a second.
+    ///
+    /// Provide the same value for \a first and \a second to search
+    /// for a single character.
+    ///
+    /// @param begin Pointer to the first character to scan.
+    /// @param end Pointer to the character after the last character to scan.
+    /// @param first The first character to search for.
+    /// @param second The second character to search for.
+    ///
+    /// @return Pointer to the first matching character, or \a end if none was found.
+    ///
+    extern const char* find_first_of(const char* begin,
+                                     const char* end,
+                                     uint8_t first,
+                                     uint8_t second);
+
+    /// Find the first character of a set.
+    //
+    /// Scans the range \a begin - \a end, 16 to 64 bytes at a time
+    /// depending on simd_level(), for the first character in
+    /// \a special. Used to find characters that need escaping,
+    /// such as quotes, separators, and control characters.
+    ///
+    /// @param begin Pointer to the first character to scan.
+    /// @param end Pointer to the character after the last character to scan.
+    /// @param special The characters to search for.
+    ///
+    /// @return Pointer to the first matching character, or \a end if none was found.
+    ///
+    extern const char* find_special(const char* begin,
+                                    const char* end,
+                                    const SpecialChars& special);
+
+    /// Index the separators and newlines that structure CSV data.
+    //
+    /// Scans the range \a begin - \a end 64 bytes at a time, building
+    /// bitmasks of the separator, newline, quote, and escape
+    /// characters in each block. A character following an escape
+    /// character is escaped. Unescaped quotes toggle between quoted
+    /// and unquoted data, which is resolved for the whole block at
+    /// once with a prefix XOR of the quote mask, done with a carry-less
+    /// multiplication where the CPU supports it.
+    ///
+    /// The separators and newlines that are neither escaped nor
+    /// quoted are added to \a positions, in order, as their offset
+    /// from \a begin. Entries for newlines have structural_newline
+    /// set, and entries ending a field with quote or escape
+    /// characters have structural_special set.
+    ///
+    /// \a state is updated to the state at \a end, so that a range
+    /// can be indexed in pieces.
+    ///
+    /// @param begin Pointer to the first character to index.
+    /// @param end Pointer to the character after the last character to index.
+    ///        At most structural_max_size bytes after \a begin.
+    /// @param chars The separator, escape, and quote characters.
+    /// @param state The state at \a begin. Set to the state at \a end.
+    /// @param positions Storage for at least \a end - \a begin entries,
+    ///        or NULL to only update \a state.
+    ///
+    /// @return The number of entries added to \a positions.
+    ///
+    extern std::size_t index_structure(const char* begin,
+                                       const char* end,
+                                       const StructuralChars& chars,
+                                       StructuralState& state,
+                                       uint32_t* positions);
+};
+#endif
@@ -0,0 +1,150 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "csv_stats.hh"
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace {
+    // All running threads' statistics, and the totals of exited threads.
+    //
+    // Created on first use, so that it outlives every ThreadStats
+    // instance, including that of the main thread.
+    struct Registry {
+        std::mutex mutex;
+        std::vector<csv::stats::ThreadStats*> threads;
+
+        // Totals of exited threads, with timers in ticks.
+        uint64_t counters[std::size_t(csv::stats::Counter::COUNT)] {};
+        uint64_t ticks[std::size_t(csv::stats::Timer::COUNT)] {};
+
+        // Reference points to calibrate ticks against.
+        std::chrono::steady_clock::time_point start_time { std::chrono::steady_clock::now() };
+        uint64_t start_ticks { csv::stats::ticks() };
+    };
+
+    Registry& registry(void)
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    void accumulate(uint64_t* counters, uint64_t* ticks, const csv::stats::ThreadStats& stats)
+    {
+        for(std::size_t i = 0; i < std::size_t(csv::stats::Counter::COUNT); ++i)
+            counters[i] += stats.counters_[i].load(std::memory_order_relaxed);
+
+        for(std::size_t i = 0; i < std::size_t(csv::stats::Timer::COUNT); ++i)
+            ticks[i] += stats.ticks_[i].load(std::memory_order_relaxed);
+    }
+
+    const char* counter_names[] = {
+        "bytes_read",
+        "lines",
+        "int64_fields",
+        "double_fields",
+        "string_fields",
+        "records_emitted",
+        "bytes_written",
+        "record_allocations",
+        "records_filtered",
+        "records_rejected",
+        "pool_hits",
+        "pool_misses"
+    };
+
+    const char* timer_names[] = {
+        "read",
+        "tokenize",
+        "parse",
+        "emit"
+    };
+
+    static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == std::size_t(csv::stats::Counter::COUNT));
+    static_assert(sizeof(timer_names) / sizeof(timer_names[0]) == std::size_t(csv::stats::Timer::COUNT));
+}
+
+thread_local csv::stats::ThreadStats csv::stats::thread_stats;
+
+csv::stats::ThreadStats::ThreadStats(void)
+{
+    Registry& reg(registry());
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    reg.threads.push_back(this);
+}
+
+csv::stats::ThreadStats::~ThreadStats(void)
+{
+    Registry& reg(registry());
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    accumulate(reg.counters, reg.ticks, *this);
+    reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), this));
+}
+
+bool csv::stats::enabled(void)
+{
+#ifdef CSV_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+csv::stats::Snapshot csv::stats::snapshot(void)
+{
+    Registry& reg(registry());
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    Snapshot result;
+    uint64_t ticks[std::size_t(Timer::COUNT)];
+
+    std::copy(reg.counters, reg.counters + std::size_t(Counter::COUNT), result.counters_);
+    std::copy(reg.ticks, reg.ticks + std::size_t(Timer::COUNT), ticks);
+
+    for(auto stats: reg.threads)
+        accumulate(result.counters_, ticks, *stats);
+
+    // Calibrate ticks against the time elapsed since the registry was created.
+    double elapsed(std::chrono::duration<double>(std::chrono::steady_clock::now() - reg.start_time).count());
+    uint64_t elapsed_ticks(csv::stats::ticks() - reg.start_ticks);
+    double seconds_per_tick(elapsed_ticks?elapsed / elapsed_ticks:0.0);
+
+    for(std::size_t i = 0; i < std::size_t(Timer::COUNT); ++i)
+        result.seconds_[i] = ticks[i] * seconds_per_tick;
+
+    return result;
+}
+
+void csv::stats::report(std::ostream& output, double wall_seconds)
+{
+    Snapshot stats(snapshot());
+
+    output << "{ \"enabled\": " << (enabled()?"true":"false") <<
+        ", \"wall_seconds\": " << wall_seconds;
+
+    for(std::size_t i = 0; i < std::size_t(Counter::COUNT); ++i)
+        output << ", \"" << counter_names[i] << "\": " << stats.counters_[i];
+
+    for(std::size_t i = 0; i < std::size_t(Timer::COUNT); ++i)
+        output << ", \"" << timer_names[i] << "_seconds\": " << stats.seconds_[i];
+
+    if (wall_seconds > 0.0)
+        output << ", \"mb_per_s\": " << stats.counter(Counter::BYTES_READ) / wall_seconds / 1e6 <<
+            ", \"records_per_s\": " << stats.counter(Counter::LINES) / wall_seconds;
+
+    output << " }" << std::endl;
+}
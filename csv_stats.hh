@@ -0,0 +1,209 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Per-stage counters and timers.
+//
+// Instrumentation is done through the CSV_STATS_ADD() and
+// CSV_STATS_TIME() macros, which compile to nothing unless
+// CSV_STATS is defined. See the Makefile.
+//
+#ifndef __CSV_STATS_HH__
+#define __CSV_STATS_HH__
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace csv {
+    namespace stats {
+        /// Event counters.
+        enum class Counter {
+            BYTES_READ,        ///< Bytes of CSV data read.
+            LINES,             ///< CSV records read.
+            INT64_FIELDS,      ///< csv::FieldType::INT64 fields parsed.
+            DOUBLE_FIELDS,     ///< csv::FieldType::DOUBLE fields parsed.
+            STRING_FIELDS,     ///< csv::FieldType::STRING fields parsed.
+            RECORDS_EMITTED,   ///< Records formatted by emitters.
+            BYTES_WRITTEN,     ///< Bytes written by emitters.
+            RECORD_ALLOCATIONS,///< csv::Record objects created.
+            RECORDS_FILTERED,  ///< Records rejected by csv::Filter.
+            RECORDS_REJECTED,  ///< Records that could not be converted, see csv::ErrorHandler.
+            POOL_HITS,         ///< csv::RecordPool::acquire() calls that reused a record.
+            POOL_MISSES,       ///< csv::RecordPool::acquire() calls that created a record.
+            COUNT
+        };
+
+        /// Stage timers.
+        //
+        /// Timers accumulate the time spent in a stage by all threads,
+        /// so a stage run by multiple threads can accumulate more time
+        /// than the wall clock time of the conversion.
+        ///
+        enum class Timer {
+            READ,              ///< Reading and splitting input into records.
+            TOKENIZE,          ///< Splitting records into fields.
+            PARSE,             ///< Converting fields to their data types.
+            EMIT,              ///< Formatting and writing records.
+            COUNT
+        };
+
+        /// Return the current time in ticks.
+        //
+        /// Ticks are CPU timestamp counter cycles where available,
+        /// since reading them is several times faster than reading
+        /// std::chrono::steady_clock. They are converted to seconds
+        /// by snapshot().
+        ///
+        inline uint64_t ticks(void)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+        /// The counters and timers of a single thread.
+        //
+        /// Each thread updates its own instance, without any
+        /// synchronization with other threads. Instances are summed
+        /// up by snapshot().
+        ///
+        class ThreadStats {
+        public:
+            ThreadStats(void);
+
+            /// Merge the values into the totals of exited threads.
+            ~ThreadStats(void);
+
+            void add(Counter counter, uint64_t value) {
+                auto& total(counters_[std::size_t(counter)]);
+
+                // Only this thread writes. No read-modify-write needed.
+                total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+
+            /// Return true once every \a interval calls for \a timer.
+            bool sample(Timer timer, uint32_t interval) {
+                uint32_t& calls(calls_[std::size_t(timer)]);
+
+                if (++calls < interval)
+                    return false;
+
+                calls = 0;
+                return true;
+            }
+
+            void add_time(Timer timer, uint64_t ticks) {
+                auto& total(ticks_[std::size_t(timer)]);
+
+                total.store(total.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+            }
+
+            std::atomic<uint64_t> counters_[std::size_t(Counter::COUNT)] {};
+            std::atomic<uint64_t> ticks_[std::size_t(Timer::COUNT)] {};
+
+            /// Calls since the last sampled call, per timer.
+            uint32_t calls_[std::size_t(Timer::COUNT)] {};
+        };
+
+        /// The statistics of the calling thread.
+        extern thread_local ThreadStats thread_stats;
+
+        /// The sum of all threads' counters and timers.
+        struct Snapshot {
+            uint64_t counters_[std::size_t(Counter::COUNT)] {};
+            double seconds_[std::size_t(Timer::COUNT)] {};
+
+            uint64_t counter(Counter counter) const { return counters_[std::size_t(counter)]; }
+            double seconds(Timer timer) const { return seconds_[std::size_t(timer)]; }
+        };
+
+        /// Return true if statistics are compiled in through CSV_STATS.
+        extern bool enabled(void);
+
+        /// Return the sum of the statistics of all threads, running and exited.
+        //
+        /// May be called at any time, e.g. to report progress.
+        ///
+        extern Snapshot snapshot(void);
+
+        /// Write a snapshot() as a single line JSON object.
+        //
+        /// @param output The stream to write to.
+        /// @param wall_seconds Elapsed time, to report throughput with.
+        ///
+        extern void report(std::ostream& output, double wall_seconds);
+
+        /// The sampling interval of timers around short, frequent calls.
+        constexpr uint32_t sample_interval = 16;
+
+        /// Add the lifetime of an instance to a timer.
+        //
+        /// Reading the clock is costly compared to processing a single
+        /// record. Timers around per-record calls therefore only time
+        /// one in \a interval calls, adding \a interval times the
+        /// measured time.
+        ///
+        class ScopedTimer {
+        public:
+            ScopedTimer(Timer timer, uint32_t interval = 1):
+                timer_(timer)
+            {
+                if (thread_stats.sample(timer, interval)) {
+                    weight_ = interval;
+                    start_ = ticks();
+                }
+            }
+
+            ~ScopedTimer(void) {
+                if (weight_)
+                    thread_stats.add_time(timer_, (ticks() - start_) * weight_);
+            }
+
+        private:
+            Timer timer_;
+            uint32_t weight_ { 0 };
+            uint64_t start_ { 0 };
+        };
+    };
+};
+
+#ifdef CSV_STATS
+/// Add \a value to the counter csv::stats::Counter::\a counter.
+#define CSV_STATS_ADD(counter, value) \
+    csv::stats::thread_stats.add(csv::stats::Counter::counter, (value))
+
+/// Add the time until the end of the current scope to csv::stats::Timer::\a timer.
+#define CSV_STATS_TIME(timer) \
+    csv::stats::ScopedTimer csv_stats_timer_##timer(csv::stats::Timer::timer)
+
+/// As CSV_STATS_TIME(), but for per-record calls. Times one in csv::stats::sample_interval calls.
+#define CSV_STATS_TIME_SAMPLED(timer) \
+    csv::stats::ScopedTimer csv_stats_timer_##timer(csv::stats::Timer::timer, csv::stats::sample_interval)
+#else
+#define CSV_STATS_ADD(counter, value) do {} while(0)
+#define CSV_STATS_TIME(timer) do {} while(0)
+#define CSV_STATS_TIME_SAMPLED(timer) do {} while(0)
+#endif
+
+#endif
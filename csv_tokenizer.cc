@@ -0,0 +1,226 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "csv_tokenizer.hh"
+#include "csv_stats.hh"
+#include <algorithm>
+
+csv::StructuralTokenizer::StructuralTokenizer(uint8_t separator,
+                                              uint8_t escape,
+                                              uint8_t quote,
+                                              std::size_t window_size):
+    chars_ { separator, escape, quote },
+    window_size_(std::min(std::max(window_size, std::size_t(64)), structural_max_size)),
+    positions_(window_size_)
+{
+}
+
+void csv::StructuralTokenizer::reset(const char* begin, const char* end)
+{
+    state_ = StructuralState();
+    count_ = 0;
+    cursor_ = 0;
+    window_ = begin;
+    indexed_ = begin;
+    position_ = begin;
+    end_ = end;
+}
+
+void csv::StructuralTokenizer::index_window(void)
+{
+    window_ = indexed_;
+    indexed_ = window_ + std::min(std::size_t(end_ - window_), window_size_);
+    count_ = index_structure(window_, indexed_, chars_, state_, positions_.data());
+    cursor_ = 0;
+}
+
+uint32_t csv::StructuralTokenizer::next(std::vector<std::string_view>& result,
+                                        std::string& buffer,
+                                        std::string_view& record)
+{
+    CSV_STATS_TIME_SAMPLED(TOKENIZE);
+    const char* begin(position_);
+    const char* field_begin(position_);
+    bool special(false);
+
+    fields_.clear();
+
+    // Collect the fields up to the next newline in the index,
+    // indexing more of the data as needed.
+    while(true) {
+        if (cursor_ == count_) {
+            // The last record has no newline.
+            if (indexed_ == end_) {
+                fields_.push_back({ field_begin, end_, state_.special });
+                special |= state_.special;
+                position_ = end_;
+                break;
+            }
+            index_window();
+            continue;
+        }
+
+        uint32_t entry(positions_[cursor_++]);
+        const char* at(window_ + (entry & structural_offset_mask));
+
+        fields_.push_back({ field_begin, at, (entry & structural_special) != 0 });
+        special |= (entry & structural_special) != 0;
+        field_begin = at + 1;
+
+        if (entry & structural_newline) {
+            position_ = at + 1;
+            break;
+        }
+    }
+
+    record = std::string_view(begin, fields_.back().end - begin);
+
+    // Check for nil lines.
+    if (record.empty())
+        return 0;
+
+    // Unquoted data is never longer than the record, so reserving
+    // the record length up front ensures that views of earlier
+    // fields in the buffer remain valid.
+    if (special) {
+        buffer.clear();
+        if (buffer.capacity() < record.length())
+            buffer.reserve(record.length());
+    }
+
+    for(const auto& field: fields_) {
+        // Fast path. The field can be referenced directly in the data.
+        if (!field.special) {
+            result.emplace_back(field.begin, field.end - field.begin);
+            continue;
+        }
+
+        std::size_t start(buffer.length());
+
+        unquote(field.begin, field.end, buffer);
+        result.emplace_back(buffer.data() + start, buffer.length() - start);
+    }
+    return fields_.size();
+}
+
+void csv::StructuralTokenizer::unquote(const char* begin,
+                                       const char* end,
+                                       std::string& buffer) const
+{
+    // Search for the quote twice if we have no escape character, and vice versa.
+    uint8_t quote(chars_.quote?chars_.quote:chars_.escape);
+    uint8_t escape(chars_.escape?chars_.escape:chars_.quote);
+    bool quoted(false);
+
+    while(true) {
+        const char* hit(find_first_of(begin, end, quote, escape));
+
+        // Add the plain characters up to the hit in a single operation.
+        buffer.append(begin, hit);
+
+        if (hit == end)
+            return;
+
+        // Skip the escape characters, and add the next character,
+        // even if it is a quote.
+        if (chars_.escape && uint8_t(*hit) == chars_.escape) {
+            do {
+                ++hit;
+            } while(hit != end && uint8_t(*hit) == chars_.escape);
+
+            if (hit == end)
+                return;
+
+            buffer.push_back(*hit);
+            begin = hit + 1;
+            continue;
+        }
+
+        // Two quotes in a quoted part are a single quote character.
+        if (quoted && hit + 1 != end && uint8_t(hit[1]) == chars_.quote) {
+            buffer.push_back(*hit);
+            begin = hit + 2;
+            continue;
+        }
+
+        quoted = !quoted;
+        begin = hit + 1;
+    }
+}
+
+bool csv::read_record(std::istream& input,
+                      std::string& line,
+                      const StructuralChars& chars)
+{
+    StructuralState state;
+    std::string next;
+    std::size_t scanned(0);
+
+    if (!std::getline(input, line))
+        return false;
+
+    // Only the lines added since the last scan have to be scanned.
+    while(true) {
+        scan_structure(line.data() + scanned, line.data() + line.length(), chars, state);
+
+        // A quoted or escaped newline continues the record.
+        if (!(state.quoted || state.escaped) || !std::getline(input, next))
+            return true;
+
+        scanned = line.length();
+        line += '\n';
+        line += next;
+    }
+}
+
+const char* csv::find_record_end(const char* begin,
+                                 const char* end,
+                                 const StructuralChars& chars,
+                                 StructuralState& state)
+{
+    // Index a small window at a time, as the record end is
+    // usually near.
+    constexpr std::size_t window_size = 1024;
+    uint32_t positions[window_size];
+
+    while(begin != end) {
+        const char* window_end(begin + std::min(std::size_t(end - begin), window_size));
+        std::size_t count(index_structure(begin, window_end, chars, state, positions));
+
+        for(std::size_t i = 0; i < count; ++i) {
+            if (positions[i] & structural_newline) {
+                // A newline is neither quoted nor escaped. The next
+                // record starts from a clean state.
+                state = StructuralState();
+                return begin + (positions[i] & structural_offset_mask);
+            }
+        }
+        begin = window_end;
+    }
+    return end;
+}
+
+void csv::scan_structure(const char* begin,
+                         const char* end,
+                         const StructuralChars& chars,
+                         StructuralState& state)
+{
+    while(begin != end) {
+        const char* window_end(begin + std::min(std::size_t(end - begin), structural_max_size));
+
+        index_structure(begin, window_end, chars, state, nullptr);
+        begin = window_end;
+    }
+}
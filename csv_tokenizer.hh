@@ -0,0 +1,182 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __CSV_TOKENIZER_HH__
+#define __CSV_TOKENIZER_HH__
+#include "csv_simd.hh"
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace csv {
+    /// Tokenize CSV records with quoted fields.
+    //
+    /// Records are read in two passes. The first pass indexes a
+    /// window of the data at a time with csv::index_structure(),
+    /// resolving quotes and escapes for 64 bytes at a time. The
+    /// second pass walks the index, one entry per field, and cuts
+    /// the fields and records out of the data.
+    ///
+    /// A field is quoted by enclosing it in the quote character, in
+    /// which case it may hold separators and newlines. Two quote
+    /// characters in a quoted field are read as one. The escape
+    /// character, if any, escapes the next character both inside
+    /// and outside quotes, as read by csv::tokenize_line(). Every
+    /// unescaped quote character starts or ends a quoted part of a
+    /// field, so that \c a"b,c"d is read as the single field \c ab,cd.
+    ///
+    /// Fields without quote or escape characters are returned as
+    /// views into the data, without being looked at again. Fields
+    /// with them have their data written to a caller owned buffer.
+    ///
+    class StructuralTokenizer {
+    public:
+        /// Default number of bytes to index at a time.
+        static constexpr std::size_t default_window_size = 32*1024;
+
+        /// Constructor.
+        //
+        /// @param separator The separator character to use.
+        /// @param escape The escape character to use. 0 if no escape character is used.
+        /// @param quote The quote character to use. 0 if fields are not quoted.
+        /// @param window_size The number of bytes to index at a time.
+        ///
+        StructuralTokenizer(uint8_t separator,
+                            uint8_t escape,
+                            uint8_t quote,
+                            std::size_t window_size = default_window_size);
+
+        /// Start reading records from a memory range.
+        //
+        /// @param begin Pointer to the start of the first record.
+        /// @param end Pointer to the end of the data.
+        ///
+        void reset(const char* begin, const char* end);
+
+        /// Tokenize the next record.
+        //
+        /// Adds one view per field of the record to \a result, in
+        /// the same way as tokenize_line(std::string_view, ...). An
+        /// empty line has no fields.
+        ///
+        /// The returned views are valid until the data, or \a buffer,
+        /// is modified or destroyed.
+        ///
+        /// @param result The vector to add field views to. \
+        ///               Fields will be added after any existing elements in the vector.
+        /// @param buffer Caller owned storage for unquoted field data.
+        /// @param record Set to the text of the record, without its newline.
+        ///
+        /// @return The number of fields added to \a result.
+        ///
+        uint32_t next(std::vector<std::string_view>& result,
+                      std::string& buffer,
+                      std::string_view& record);
+
+        /// Return true if all records have been read.
+        bool done(void) const { return position_ == end_; }
+
+        /// Return the start of the next record.
+        const char* position(void) const { return position_; }
+
+    private:
+        /// A field, and whether it has quote or escape characters.
+        struct Field {
+            const char* begin;
+            const char* end;
+            bool special;
+        };
+
+        /// Index the next window of data.
+        void index_window(void);
+
+        /// Append the data of a field with quote or escape characters to \a buffer.
+        void unquote(const char* begin, const char* end, std::string& buffer) const;
+
+        StructuralChars chars_;
+        StructuralState state_;
+        std::size_t window_size_;
+        std::vector<uint32_t> positions_;
+        std::vector<Field> fields_;
+        std::size_t count_ { 0 };
+        std::size_t cursor_ { 0 };
+        const char* window_ { nullptr };
+        const char* indexed_ { nullptr };
+        const char* position_ { nullptr };
+        const char* end_ { nullptr };
+    };
+
+    /// Read a record that may span several lines from a stream.
+    //
+    /// Reads a line from \a input into \a line, and while it ends
+    /// inside a quoted field, or with an escape character, appends a
+    /// newline and the next line.
+    ///
+    /// @param input The stream to read from.
+    /// @param line Set to the record, without its newline.
+    /// @param chars The separator, escape, and quote characters.
+    ///
+    /// @return true - A record was read.
+    /// @return false - The input has reached its end.
+    ///
+    extern bool read_record(std::istream& input,
+                            std::string& line,
+                            const StructuralChars& chars);
+
+    /// Find the end of the record starting at \a begin, with quoted fields.
+    //
+    /// Searches for the first newline in the range \a begin - \a end
+    /// that is neither escaped nor quoted, with \a state being the
+    /// state at \a begin.
+    ///
+    /// @param begin Pointer to the first character to search.
+    /// @param end Pointer to the end of the data to search.
+    /// @param chars The separator, escape, and quote characters.
+    /// @param state The state at \a begin. Set to the state after the returned newline.
+    ///
+    /// @return Pointer to the terminating newline, or \a end if none was found.
+    ///
+    extern const char* find_record_end(const char* begin,
+                                       const char* end,
+                                       const StructuralChars& chars,
+                                       StructuralState& state);
+
+    /// Update \a state to the state at \a end.
+    //
+    /// @param begin Pointer to the first character to scan.
+    /// @param end Pointer to the end of the data to scan.
+    /// @param chars The separator, escape, and quote characters.
+    /// @param state The state at \a begin. Set to the state at \a end.
+    ///
+    extern void scan_structure(const char* begin,
+                               const char* end,
+                               const StructuralChars& chars,
+                               StructuralState& state);
+
+    /// Return the number of input lines a record spans.
+    //
+    /// A record is one line, plus one for each quoted or escaped
+    /// newline in it.
+    ///
+    /// @param record The text of the record, without its newline.
+    ///
+    inline std::size_t record_line_count(std::string_view record) {
+        return 1 + std::count(record.begin(), record.end(), '\n');
+    }
+};
+#endif
@@ -0,0 +1,528 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "decompress_stream.hh"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <zlib.h>
+
+#ifdef CSV_ZSTD
+#include <zstd.h>
+#endif
+
+//
+// The source stream buffer, with the ability to look ahead at
+// data before it is consumed.
+//
+class csv::DecompressStreamBuf::Source {
+public:
+    Source(std::streambuf* source):
+        source_(source)
+    {}
+
+    // Make at least 'size' bytes available to peek(), if the
+    // source holds that many. Returns the number of bytes available.
+    std::size_t fill(std::size_t size) {
+        std::size_t available(ahead_.length() - position_);
+
+        if (available < size) {
+            ahead_.erase(0, position_);
+            position_ = 0;
+            ahead_.resize(size);
+            ahead_.resize(available + source_->sgetn(&ahead_[available], size - available));
+        }
+        return ahead_.length() - position_;
+    }
+
+    // Return the bytes made available by fill().
+    const unsigned char* peek(void) const {
+        return reinterpret_cast<const unsigned char*>(ahead_.data() + position_);
+    }
+
+    // Read up to 'size' bytes. Returns fewer bytes only at end of data.
+    std::size_t read(char* data, std::size_t size) {
+        std::size_t done(std::min(size, ahead_.length() - position_));
+
+        std::memcpy(data, ahead_.data() + position_, done);
+        position_ += done;
+
+        if (done < size)
+            done += source_->sgetn(data + done, size - done);
+
+        return done;
+    }
+
+private:
+    std::streambuf* source_;
+    std::string ahead_ { "" };
+    std::size_t position_ { 0 };
+};
+
+//
+// Base class of the decompressors.
+//
+class csv::DecompressStreamBuf::Decoder {
+public:
+    virtual ~Decoder(void) = default;
+
+    // Decompress up to 'size' bytes to 'data'.
+    // Returns 0 only at the end of the data.
+    virtual std::size_t read(char* data, std::size_t size) = 0;
+};
+
+namespace {
+    using Source = csv::DecompressStreamBuf::Source;
+    using Decoder = csv::DecompressStreamBuf::Decoder;
+
+    // Report corrupt data and exit.
+    void corrupt(const char* format, const char* reason)
+    {
+        std::cout << "Could not decompress " << format << " input: " << reason << std::endl;
+        exit(255);
+    }
+
+    // zlib counts bytes in 32 bit integers.
+    std::size_t limit_size(std::size_t size)
+    {
+        return std::min(size, std::size_t(1) << 30);
+    }
+
+    //
+    // Uncompressed data.
+    //
+    class PassThroughDecoder: public Decoder {
+    public:
+        PassThroughDecoder(Source& source):
+            source_(source)
+        {}
+
+        std::size_t read(char* data, std::size_t size) override {
+            return source_.read(data, size);
+        }
+
+    private:
+        Source& source_;
+    };
+
+    //
+    // One or more gzip members, inflated in sequence.
+    //
+    class GzipDecoder: public Decoder {
+    public:
+        GzipDecoder(Source& source, std::size_t buffer_size):
+            source_(source),
+            input_(buffer_size)
+        {
+            std::memset(&stream_, 0, sizeof(stream_));
+
+            // 16 + MAX_WBITS: Expect a gzip header and trailer.
+            if (inflateInit2(&stream_, 16 + MAX_WBITS) != Z_OK)
+                corrupt("gzip", "could not initialize zlib");
+        }
+
+        ~GzipDecoder(void) {
+            inflateEnd(&stream_);
+        }
+
+        std::size_t read(char* data, std::size_t size) override {
+            size = limit_size(size);
+            stream_.next_out = reinterpret_cast<Bytef*>(data);
+            stream_.avail_out = size;
+
+            while(stream_.avail_out == size) {
+                if (!stream_.avail_in) {
+                    std::size_t count(source_.read(input_.data(), input_.size()));
+
+                    if (!count) {
+                        if (!member_end_)
+                            corrupt("gzip", "data is truncated");
+                        break;
+                    }
+                    stream_.next_in = reinterpret_cast<Bytef*>(input_.data());
+                    stream_.avail_in = count;
+                }
+
+                // Another member follows the one just completed.
+                if (member_end_) {
+                    inflateReset(&stream_);
+                    member_end_ = false;
+                }
+
+                int res(inflate(&stream_, Z_NO_FLUSH));
+
+                if (res == Z_STREAM_END)
+                    member_end_ = true;
+                else if (res != Z_OK && res != Z_BUF_ERROR)
+                    corrupt("gzip", stream_.msg?stream_.msg:"inflate failed");
+            }
+            return size - stream_.avail_out;
+        }
+
+    private:
+        Source& source_;
+        std::vector<char> input_;
+        z_stream stream_;
+        bool member_end_ { false };
+    };
+
+#ifdef CSV_ZSTD
+    //
+    // One or more zstd frames, decompressed in sequence.
+    //
+    class ZstdDecoder: public Decoder {
+    public:
+        ZstdDecoder(Source& source, std::size_t buffer_size):
+            source_(source),
+            input_(buffer_size),
+            stream_(ZSTD_createDStream())
+        {
+            if (!stream_ || ZSTD_isError(ZSTD_initDStream(stream_)))
+                corrupt("zstd", "could not initialize libzstd");
+        }
+
+        ~ZstdDecoder(void) {
+            ZSTD_freeDStream(stream_);
+        }
+
+        std::size_t read(char* data, std::size_t size) override {
+            ZSTD_outBuffer output { data, size, 0 };
+
+            while(!output.pos) {
+                if (in_.pos == in_.size) {
+                    std::size_t count(source_.read(input_.data(), input_.size()));
+
+                    if (!count) {
+                        // A non-zero hint means that a frame is incomplete.
+                        if (hint_)
+                            corrupt("zstd", "data is truncated");
+                        break;
+                    }
+                    in_ = { input_.data(), count, 0 };
+                }
+
+                hint_ = ZSTD_decompressStream(stream_, &output, &in_);
+                if (ZSTD_isError(hint_))
+                    corrupt("zstd", ZSTD_getErrorName(hint_));
+            }
+            return output.pos;
+        }
+
+    private:
+        Source& source_;
+        std::vector<char> input_;
+        ZSTD_DStream* stream_;
+        ZSTD_inBuffer in_ { nullptr, 0, 0 };
+        std::size_t hint_ { 0 };
+    };
+#endif
+
+    //
+    // gzip members recording their own size in a "BC" extra field,
+    // as written by bgzip, inflated in parallel.
+    //
+    // The calling thread reads whole members from the source into
+    // a window of slots, ahead of the member being returned. Worker
+    // threads inflate the slots in order of arrival.
+    //
+    class ParallelGzipDecoder: public Decoder {
+    public:
+        ParallelGzipDecoder(Source& source, unsigned int thread_count):
+            source_(source),
+            slots_(4 * thread_count)
+        {
+            for(unsigned int i = 0; i < thread_count; ++i)
+                workers_.emplace_back([this](void) { work(); });
+        }
+
+        ~ParallelGzipDecoder(void) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cond_.notify_all();
+
+            for(auto& thr: workers_)
+                thr.join();
+        }
+
+        std::size_t read(char* data, std::size_t size) override {
+            while(true) {
+                load();
+
+                if (next_serve_ == next_load_)
+                    return 0;
+
+                Slot& slot(slots_[next_serve_ % slots_.size()]);
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cond_.wait(lock, [&] { return slot.done; });
+                }
+
+                std::size_t count(std::min(size, slot.output.length() - served_));
+
+                std::memcpy(data, slot.output.data() + served_, count);
+                served_ += count;
+
+                // Release the slot once all of its output is returned.
+                if (served_ == slot.output.length()) {
+                    served_ = 0;
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    slot.done = false;
+                    ++next_serve_;
+                }
+
+                // Empty members, such as the bgzip end of file marker,
+                // produce no data. Move on to the next one.
+                if (count)
+                    return count;
+            }
+        }
+
+        // Return true if the member at the start of 'source' has a BC extra field.
+        static bool has_member_size(Source& source, std::size_t* member_size = nullptr) {
+            std::size_t available(source.fill(12));
+            const unsigned char* header(source.peek());
+
+            // Magic, deflate, and FEXTRA flag.
+            if (available < 12 || header[0] != 0x1f || header[1] != 0x8b ||
+                header[2] != 8 || !(header[3] & 4))
+                return false;
+
+            std::size_t extra_length(header[10] | (header[11] << 8));
+
+            if (source.fill(12 + extra_length) < 12 + extra_length)
+                return false;
+
+            header = source.peek();
+
+            // Search the extra subfields for BC.
+            for(std::size_t pos = 12; pos + 4 <= 12 + extra_length; ) {
+                std::size_t length(header[pos + 2] | (header[pos + 3] << 8));
+
+                if (header[pos] == 'B' && header[pos + 1] == 'C' && length == 2 &&
+                    pos + 6 <= 12 + extra_length) {
+                    if (member_size)
+                        *member_size = (header[pos + 4] | (header[pos + 5] << 8)) + 1;
+
+                    return true;
+                }
+                pos += 4 + length;
+            }
+            return false;
+        }
+
+    private:
+        struct Slot {
+            std::string member;
+            std::string output;
+            bool done { false };
+        };
+
+        // Read members into free slots.
+        void load(void) {
+            while(!eof_ && next_load_ < next_serve_ + slots_.size()) {
+                Slot& slot(slots_[next_load_ % slots_.size()]);
+                std::size_t member_size(0);
+
+                // End of data?
+                if (!source_.fill(1)) {
+                    eof_ = true;
+                    break;
+                }
+
+                if (!has_member_size(source_, &member_size))
+                    corrupt("gzip", "member without a BC extra field in bgzip data");
+
+                slot.member.resize(member_size);
+                if (source_.read(&slot.member[0], member_size) != member_size)
+                    corrupt("gzip", "data is truncated");
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    ++next_load_;
+                }
+                cond_.notify_all();
+            }
+        }
+
+        // Inflate members loaded by the reading thread.
+        void work(void) {
+            z_stream stream;
+
+            std::memset(&stream, 0, sizeof(stream));
+
+            // Raw deflate data. Header and trailer are handled below.
+            if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+                corrupt("gzip", "could not initialize zlib");
+
+            while(true) {
+                std::size_t sequence(0);
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+
+                    cond_.wait(lock, [&] { return stop_ || next_job_ < next_load_; });
+                    if (stop_)
+                        break;
+
+                    sequence = next_job_++;
+                }
+
+                Slot& slot(slots_[sequence % slots_.size()]);
+                const unsigned char* member(reinterpret_cast<const unsigned char*>(slot.member.data()));
+                std::size_t length(slot.member.length());
+                std::size_t header_length(12 + (member[10] | (member[11] << 8)));
+
+                if (length < header_length + 8)
+                    corrupt("gzip", "member is too short");
+
+                const unsigned char* trailer(member + length - 8);
+                uint32_t crc(trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (uint32_t(trailer[3]) << 24));
+                uint32_t output_size(trailer[4] | (trailer[5] << 8) | (trailer[6] << 16) | (uint32_t(trailer[7]) << 24));
+
+                // The trailer records the size of the inflated data.
+                slot.output.resize(output_size);
+                inflateReset(&stream);
+                stream.next_in = const_cast<Bytef*>(member + header_length);
+                stream.avail_in = length - header_length - 8;
+                stream.next_out = reinterpret_cast<Bytef*>(&slot.output[0]);
+                stream.avail_out = output_size;
+
+                if (inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.avail_out)
+                    corrupt("gzip", stream.msg?stream.msg:"member size mismatch");
+
+                if (crc32(0, reinterpret_cast<const Bytef*>(slot.output.data()), output_size) != crc)
+                    corrupt("gzip", "CRC mismatch");
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    slot.done = true;
+                }
+                cond_.notify_all();
+            }
+            inflateEnd(&stream);
+        }
+
+        Source& source_;
+        std::vector<Slot> slots_;
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        bool stop_ { false };
+        bool eof_ { false };
+
+        // Sequence numbers of the next member to read from the
+        // source, to inflate, and to return.
+        std::size_t next_load_ { 0 };
+        std::size_t next_job_ { 0 };
+        std::size_t next_serve_ { 0 };
+
+        // Bytes of the member being returned that have been returned.
+        std::size_t served_ { 0 };
+    };
+}
+
+csv::DecompressStreamBuf::DecompressStreamBuf(std::streambuf* source,
+                                              unsigned int thread_count,
+                                              std::size_t buffer_size):
+    source_(new Source(source)),
+    buffer_(buffer_size?buffer_size:default_buffer_size)
+{
+    std::size_t available(source_->fill(4));
+    const unsigned char* magic(source_->peek());
+
+    if (available >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        compression_ = Compression::GZIP;
+
+        if (thread_count > 1 && ParallelGzipDecoder::has_member_size(*source_)) {
+            parallel_ = true;
+            decoder_.reset(new ParallelGzipDecoder(*source_, thread_count));
+        } else
+            decoder_.reset(new GzipDecoder(*source_, buffer_.size()));
+
+    } else if (available >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+               magic[2] == 0x2f && magic[3] == 0xfd) {
+        compression_ = Compression::ZSTD;
+#ifdef CSV_ZSTD
+        decoder_.reset(new ZstdDecoder(*source_, buffer_.size()));
+#else
+        corrupt("zstd", "zstd support is not built in. Rebuild with 'make ZSTD=1'");
+#endif
+    } else
+        decoder_.reset(new PassThroughDecoder(*source_));
+
+    setg(buffer_.data(), buffer_.data(), buffer_.data());
+}
+
+csv::DecompressStreamBuf::~DecompressStreamBuf(void)
+{
+}
+
+csv::DecompressStreamBuf::int_type csv::DecompressStreamBuf::underflow(void)
+{
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    std::size_t size(decoder_->read(buffer_.data(), buffer_.size()));
+
+    if (!size)
+        return traits_type::eof();
+
+    setg(buffer_.data(), buffer_.data(), buffer_.data() + size);
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize csv::DecompressStreamBuf::xsgetn(char* data, std::streamsize size)
+{
+    std::streamsize done(0);
+
+    while(done < size) {
+        std::streamsize available(egptr() - gptr());
+
+        // Hand out buffered data first.
+        if (available) {
+            std::streamsize count(std::min(available, size - done));
+
+            std::memcpy(data + done, gptr(), count);
+            gbump(int(count));
+            done += count;
+            continue;
+        }
+
+        // Decompress large requests straight into the caller's memory.
+        if (std::size_t(size - done) >= buffer_.size()) {
+            std::size_t count(decoder_->read(data + done, size - done));
+
+            if (!count)
+                break;
+
+            done += count;
+            continue;
+        }
+
+        if (underflow() == traits_type::eof())
+            break;
+    }
+    return done;
+}
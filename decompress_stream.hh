@@ -0,0 +1,96 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __DECOMPRESS_STREAM_HH__
+#define __DECOMPRESS_STREAM_HH__
+#include <cstddef>
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+namespace csv {
+    /// Compression formats detected by csv::DecompressStreamBuf.
+    enum class Compression {
+        NONE, GZIP, ZSTD
+    };
+
+    /// A stream buffer transparently decompressing another stream buffer.
+    //
+    /// The format of the source data is detected by its magic bytes
+    /// when the instance is constructed:
+    ///
+    ///   - gzip data is inflated with zlib. Concatenated gzip members,
+    ///     as produced by e.g. \c pigz or \c bgzip, are decompressed
+    ///     one after the other.
+    ///   - zstd data is decompressed with libzstd, if built with
+    ///     \c CSV_ZSTD. Otherwise reading zstd data is an error.
+    ///   - Any other data is passed through unmodified.
+    ///
+    /// If more than one thread is requested, and the gzip members
+    /// record their own size in a \c BC extra field, as in the BGZF
+    /// format written by \c bgzip, the members are decompressed in
+    /// parallel by a pool of threads, and returned in order.
+    ///
+    /// Data is decompressed as it is read, without any temporary
+    /// files. Corrupt or truncated data is reported on stdout,
+    /// exiting the program.
+    ///
+    class DecompressStreamBuf: public std::streambuf {
+    public:
+        /// Default size of the read buffers.
+        static constexpr std::size_t default_buffer_size = 1024*1024;
+
+        /// Constructor.
+        //
+        /// Reads the first bytes of \a source to detect its format.
+        ///
+        /// @param source The stream buffer to read compressed data from.
+        /// @param thread_count The number of threads to decompress independent members with.
+        /// @param buffer_size The size of the read buffers.
+        ///
+        DecompressStreamBuf(std::streambuf* source,
+                            unsigned int thread_count = 1,
+                            std::size_t buffer_size = default_buffer_size);
+
+        /// Destructor. Stops any decompression threads.
+        ~DecompressStreamBuf(void);
+
+        DecompressStreamBuf(const DecompressStreamBuf&) = delete;
+        DecompressStreamBuf& operator=(const DecompressStreamBuf&) = delete;
+
+        /// Return the detected compression format.
+        Compression compression(void) const { return compression_; }
+
+        /// Return true if members are decompressed by multiple threads.
+        bool parallel(void) const { return parallel_; }
+
+    protected:
+        int_type underflow(void) override;
+        std::streamsize xsgetn(char* data, std::streamsize size) override;
+
+    public:
+        // Implementation classes, defined in decompress_stream.cc.
+        class Source;
+        class Decoder;
+
+    private:
+        std::unique_ptr<Source> source_;
+        std::unique_ptr<Decoder> decoder_;
+        std::vector<char> buffer_;
+        Compression compression_ { Compression::NONE };
+        bool parallel_ { false };
+    };
+};
+#endif
@@ -0,0 +1,269 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "emitter_columnar.hh"
+#include <iostream>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include "factory.hh"
+#include "factory_impl.hh"
+#include "csv_stats.hh"
+
+bool emitter_columnar_registration_ =
+    csv::Factory<csv::EmitterIface>::
+    register_producer("columnar",
+                      [](void) -> std::shared_ptr<csv::EmitterIface> {
+                          return std::make_shared<csv::EmitterColumnar>();
+                      });
+
+//
+// Helper functions. Not visible to the outside.
+//
+// Each appends an encoded value to 'out'.
+//
+static void append_varint(std::string& out, uint64_t value)
+{
+    while(value >= 0x80) {
+        out += char(value | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+static void append_fixed(std::string& out, uint64_t value, std::size_t size)
+{
+    for(std::size_t i = 0; i < size; ++i, value >>= 8)
+        out += char(value);
+}
+
+static void append_string(std::string& out, std::string_view value)
+{
+    append_varint(out, value.length());
+    out.append(value);
+}
+
+static uint64_t double_bits(double value)
+{
+    uint64_t bits;
+
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static csv::EmitterColumnar::Encoding encode_int64(std::string& out, const csv::RecordBatch& group, std::size_t field)
+{
+    uint64_t previous(0);
+
+    for(std::size_t row = 0; row < group.size(); ++row) {
+        uint64_t value(group.row(row).int64_value(field));
+        int64_t delta(value - previous);
+
+        // Zigzag: Small negative differences become small integers.
+        append_varint(out, (uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+        previous = value;
+    }
+    return csv::EmitterColumnar::Encoding::DELTA_VARINT;
+}
+
+static csv::EmitterColumnar::Encoding encode_double(std::string& out, const csv::RecordBatch& group, std::size_t field)
+{
+    std::size_t start(out.length());
+    uint64_t previous(0);
+
+    for(std::size_t row = 0; row < group.size(); ++row) {
+        uint64_t bits(double_bits(group.row(row).double_value(field)));
+        uint64_t value(bits ^ previous);
+        std::size_t leading(value?__builtin_clzll(value) / 8:8);
+        std::size_t trailing(value?__builtin_ctzll(value) / 8:0);
+
+        out += char((leading << 4) | trailing);
+        append_fixed(out, value >> (trailing * 8), 8 - leading - trailing);
+        previous = bits;
+    }
+
+    // Values without similarities are smaller stored raw.
+    if (out.length() - start <= group.size() * 8)
+        return csv::EmitterColumnar::Encoding::XOR;
+
+    out.resize(start);
+    for(std::size_t row = 0; row < group.size(); ++row)
+        append_fixed(out, double_bits(group.row(row).double_value(field)), 8);
+
+    return csv::EmitterColumnar::Encoding::RAW;
+}
+
+static csv::EmitterColumnar::Encoding encode_string(std::string& out, const csv::RecordBatch& group, std::size_t field)
+{
+    std::unordered_map<std::string_view, uint64_t> dictionary;
+    std::vector<std::string_view> values;
+    std::vector<uint64_t> indexes;
+    std::size_t start(out.length());
+
+    // Build a dictionary, unless there are too many distinct values
+    // for it to pay off.
+    indexes.reserve(group.size());
+    for(std::size_t row = 0; row < group.size() && values.size() <= group.size() / 2; ++row) {
+        std::string_view value(group.row(row).string_value(field));
+        auto res(dictionary.emplace(value, values.size()));
+
+        if (res.second)
+            values.push_back(value);
+
+        indexes.push_back(res.first->second);
+    }
+
+    if (values.size() <= group.size() / 2) {
+        append_varint(out, values.size());
+        for(const auto& value: values)
+            append_string(out, value);
+
+        for(uint64_t index: indexes)
+            append_varint(out, index);
+
+        std::size_t dictionary_size(out.length() - start);
+        std::size_t plain_size(0);
+
+        for(std::size_t row = 0; row < group.size() && plain_size <= dictionary_size; ++row)
+            plain_size += group.row(row).string_value(field).length() + 1;
+
+        if (dictionary_size < plain_size)
+            return csv::EmitterColumnar::Encoding::DICTIONARY;
+
+        out.resize(start);
+    }
+
+    for(std::size_t row = 0; row < group.size(); ++row)
+        append_string(out, group.row(row).string_value(field));
+
+    return csv::EmitterColumnar::Encoding::PLAIN;
+}
+
+bool csv::EmitterColumnar::begin(std::ostream& output,
+                                 const std::string& config,
+                                 const csv::Specification& specification)
+{
+    std::string& out(buffer_.data());
+    std::size_t start(out.length());
+
+    group_.reset(new csv::RecordBatch(specification, row_group_size));
+    groups_.clear();
+    offset_ = 0;
+
+    out.append("CSVC");
+    out += char(version);
+    offset_ += out.length() - start;
+    return true;
+}
+
+bool csv::EmitterColumnar::write_group(std::ostream& output)
+{
+    const csv::Specification& specification(group_->specification());
+    std::string& out(buffer_.data());
+    std::size_t start(out.length());
+    std::size_t field_index(0);
+
+    groups_.emplace_back(offset_, group_->size());
+    append_varint(out, group_->size());
+
+    for(const auto& field: specification.fields()) {
+        Encoding encoding;
+
+        column_.clear();
+
+        switch(field.type_) {
+        case csv::FieldType::INT64:
+            encoding = encode_int64(column_, *group_, field_index);
+            break;
+
+        case csv::FieldType::DOUBLE:
+            encoding = encode_double(column_, *group_, field_index);
+            break;
+
+        case csv::FieldType::STRING:
+            encoding = encode_string(column_, *group_, field_index);
+            break;
+
+        default:
+            std::cout << "Unknown data type: " << int(field.type_)  << std::endl;
+            exit(255);
+        }
+
+        out += char(encoding);
+        append_varint(out, column_.length());
+        out.append(column_);
+        ++field_index;
+    }
+
+    offset_ += out.length() - start;
+    group_->clear();
+    return buffer_.write_if_full(output);
+}
+
+bool csv::EmitterColumnar::emit_record(std::ostream& output,
+                                       const csv::Specification& specification,
+                                       const class Record& record)
+{
+    CSV_STATS_TIME_SAMPLED(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, 1);
+    group_->append(record);
+    return !group_->full() || write_group(output);
+}
+
+bool csv::EmitterColumnar::emit_batch(std::ostream& output,
+                                      const csv::Specification& specification,
+                                      const csv::RecordBatch& batch)
+{
+    CSV_STATS_TIME(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, batch.size());
+
+    for(std::size_t row = 0; row < batch.size(); ++row) {
+        group_->append(batch.row(row));
+
+        if (group_->full() && !write_group(output))
+            return false;
+    }
+    return true;
+}
+
+bool csv::EmitterColumnar::end(std::ostream& output,
+                               const csv::Specification& specification)
+{
+    if (!group_->empty() && !write_group(output))
+        return false;
+
+    std::string& out(buffer_.data());
+    std::size_t start(out.length());
+    uint64_t record_count(0);
+
+    append_varint(out, specification.fields().size());
+    for(const auto& field: specification.fields()) {
+        append_string(out, field.name_);
+        out += char(field.type_);
+    }
+
+    append_varint(out, groups_.size());
+    for(const auto& group: groups_) {
+        append_varint(out, group.first);
+        append_varint(out, group.second);
+        record_count += group.second;
+    }
+    append_varint(out, record_count);
+
+    append_fixed(out, out.length() - start, 4);
+    out.append("CSVC");
+    offset_ += out.length() - start;
+    return buffer_.flush(output);
+}
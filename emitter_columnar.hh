@@ -0,0 +1,181 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __EMITTER_COLUMNAR_HH__
+#define __EMITTER_COLUMNAR_HH__
+#include "emitter_iface.hh"
+#include "output_buffer.hh"
+#include "record_batch.hh"
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <vector>
+#include "factory.hh"
+
+namespace csv {
+    /// A column oriented binary emitter.
+    //
+    /// This class collects records into row groups, and writes each
+    /// row group column by column, with an encoding chosen per column
+    /// and row group to make the data compact:
+    ///
+    ///   - csv::FieldType::INT64 values are stored as the zigzag encoded
+    ///     difference to the previous value, as a variable length
+    ///     integer. Sorted or slowly changing values need a byte or two each.
+    ///   - csv::FieldType::DOUBLE values are stored either raw, or XOR:ed
+    ///     with the previous value, with leading and trailing zero bytes
+    ///     of the result left out. Whichever is smaller is used.
+    ///   - csv::FieldType::STRING values are stored either as length
+    ///     prefixed strings, or, for columns with few distinct values, as
+    ///     a dictionary followed by an index into it for each value.
+    ///
+    /// All integers in the format below are unsigned LEB128 variable
+    /// length integers (\c varint), unless noted otherwise.
+    ///
+    /// \code
+    ///   file:      "CSVC" version:u8 row-group* footer footer-size:u32le "CSVC"
+    ///   row-group: row-count column*
+    ///   column:    encoding:u8 size payload[size]
+    ///   footer:    field-count (name-size name type:u8)*
+    ///              row-group-count (offset row-count)* record-count
+    /// \endcode
+    ///
+    /// The footer offsets are the byte positions of each row group
+    /// from the start of the file. The field types are the values of
+    /// csv::FieldType, and the encodings the values of
+    /// EmitterColumnar::Encoding. Fixed size values are little endian.
+    ///
+    /// A reader locates the footer through the last eight bytes,
+    /// and can then load any row group, or any column in it,
+    /// without decoding the rest of the file.
+    ///
+    class EmitterColumnar: public EmitterIface {
+    public:
+        /// The format version written to the file header.
+        static constexpr uint8_t version = 1;
+
+        /// Number of records in each row group.
+        static constexpr std::size_t row_group_size = 65536;
+
+        /// Encodings of a column in a row group.
+        enum class Encoding: uint8_t {
+            /// INT64 zigzag encoded varint differences to the previous value.
+            DELTA_VARINT = 1,
+
+            /// DOUBLE values as 8 byte little endian IEEE 754 doubles.
+            RAW = 2,
+
+            /// DOUBLE values XOR:ed with the previous value. Each value is
+            /// a byte with the leading zero byte count in the upper four
+            /// bits and the trailing zero byte count in the lower four
+            /// bits, followed by the remaining bytes, little endian.
+            XOR = 3,
+
+            /// STRING values as varint length followed by the string.
+            PLAIN = 4,
+
+            /// STRING values as a varint count of distinct values, the
+            /// values in PLAIN encoding, and a varint index into them
+            /// for each record.
+            DICTIONARY = 5
+        };
+
+        /// Default constructor.
+        EmitterColumnar(void) = default;
+
+        /// Default destructor.
+        ~EmitterColumnar(void) = default;
+
+        /// Write the file header.
+        //
+        /// @param output The output file stream to write the header to.
+        /// @param config Not used
+        /// @param specification  Record specification of the row groups.
+        //
+        /// @return true - Header was successfully written.
+        /// @return false - Header could not be written.
+        ///
+        bool begin(std::ostream& output,
+                   const std::string& config,
+                   const csv::Specification& specification) override;
+
+        /// Add a single record to the current row group.
+        //
+        /// The row group is encoded and written once it holds
+        /// row_group_size records.
+        ///
+        /// @param output The output file stream to write full row groups to.
+        /// @param specification  Record specification to retrieve types from.
+        /// @param record The record to emit.
+        //
+        /// @return true - Record was successfully emitted.
+        /// @return false - Record data could not be emitted.
+        ///
+        bool emit_record(std::ostream& output,
+                         const csv::Specification& specification,
+                         const class Record& record) override;
+
+        /// Add a batch of records to the current row group.
+        //
+        /// @param output The output file stream to write full row groups to.
+        /// @param specification  Record specification to retrieve types from.
+        /// @param batch The records to emit.
+        //
+        /// @return true - Records were successfully emitted.
+        /// @return false - Record data could not be emitted.
+        ///
+        bool emit_batch(std::ostream& output,
+                        const csv::Specification& specification,
+                        const csv::RecordBatch& batch) override;
+
+        /// Return true, since emit_batch() is implemented natively.
+        bool has_native_batch(void) const override { return true; }
+
+        /// Set the number of bytes to collect before writing to the output stream.
+        void set_buffer_size(std::size_t size) override { buffer_.set_capacity(size); }
+
+        /// Write the last row group and the footer.
+        //
+        /// @param output The output file stream to write to.
+        /// @param specification  Record specification written to the footer.
+        //
+        /// @return true - The footer was successfully written.
+        /// @return false - The footer could not be written.
+        ///
+        bool end(std::ostream& output,
+                 const csv::Specification& specification) override;
+
+    private:
+        /// Encode the records in group_ as a row group, and clear it.
+        bool write_group(std::ostream& output);
+
+        /// Records of the row group being collected.
+        std::unique_ptr<csv::RecordBatch> group_;
+
+        /// Offset and record count of each written row group.
+        std::vector<std::pair<uint64_t, uint64_t>> groups_;
+
+        /// Bytes written since begin().
+        uint64_t offset_ { 0 };
+
+        /// Encoded row groups not yet written to the output stream.
+        csv::OutputBuffer buffer_;
+
+        /// Payload of the column being encoded.
+        std::string column_;
+    };
+};
+
+#endif
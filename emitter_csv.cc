@@ -17,6 +17,8 @@
 #include <iostream>
 #include "factory.hh"
 #include "factory_impl.hh"
+#include "csv_format.hh"
+#include "csv_stats.hh"
 
 
 //
@@ -45,52 +47,81 @@ bool csv::EmitterCSV::begin(std::ostream& output,
     return true;
 }
 
+//
+// Helper function. Not visible to the outside.
+//
+// Emit a single record, provided either as a csv::Record or as
+// a csv::RecordBatch::Row.
+//
+// The line is appended to 'line', which is the data of the
+// emitter's output buffer.
+//
+template <typename ROW>
+static void emit_row(std::string& line,
+                     const csv::Specification& specification,
+                     const ROW& row)
+{
+    const csv::Escaper& escaper(specification.escaper(csv::TextFormat::CSV));
+    std::size_t field_index(0);
+
+    // Separators and the newline are planned by the specification.
+    line.append(specification.record_prefix(csv::TextFormat::CSV));
+
+    for(const auto& field: specification.fields()) {
+        csv::append_value(line, field, row, field_index, escaper);
+        line.append(field.after(csv::TextFormat::CSV));
+        ++field_index;
+    }
+}
+
 bool csv::EmitterCSV::emit_record(std::ostream& output,
                                  const csv::Specification& specification,
                                  const class Record& record)
 {
-    std::string line {""};
-    bool first_field { true };
-    auto field_type_iter{ specification.fields().begin() };
-
-    for(const auto& field: record.fields()) {
-        // Do we need to add a separator
-        if (!first_field) 
-            line += specification.separator_char();
-
-        first_field = false;
-
-        // Convert the given data type of the record's field
-        // to a string field.
-        switch(field_type_iter->type_) {
-        case csv::FieldType::INT64:
-            line.append(std::to_string(std::get<int64_t>(field)));
-            break;
-
-        case csv::FieldType::DOUBLE:
-            line.append(std::to_string(std::get<double>(field)));
-            break;
-
-        case csv::FieldType::STRING:
-            line.append(std::get<std::string>(field));
-            break;
-
-        default:
-            std::cout << "Unknown data type: " << int(field_type_iter->type_)  << std::endl;
-            exit(255);
-        }
-        ++field_type_iter;
-    }
+    CSV_STATS_TIME_SAMPLED(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, 1);
+    emit_row(buffer_.data(), specification, record);
+    return buffer_.write_if_full(output);
+}
+
+bool csv::EmitterCSV::emit_batch(std::ostream& output,
+                                 const csv::Specification& specification,
+                                 const csv::RecordBatch& batch)
+{
+    CSV_STATS_TIME(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, batch.size());
 
-    // Add to output stream
-    output << line << std::endl;
+    for(std::size_t row = 0; row < batch.size(); ++row) {
+        emit_row(buffer_.data(), specification, batch.row(row));
+
+        if (!buffer_.write_if_full(output))
+            return false;
+    }
     return true;
 }
 
+void csv::EmitterCSV::format_batch(std::string& text,
+                                 const csv::Specification& specification,
+                                 const csv::RecordBatch& batch) const
+{
+    CSV_STATS_TIME(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, batch.size());
+
+    for(std::size_t row = 0; row < batch.size(); ++row)
+        emit_row(text, specification, batch.row(row));
+}
+
+bool csv::EmitterCSV::emit_formatted(std::ostream& output,
+                                   const csv::Specification& specification,
+                                   const std::string& text)
+{
+    return buffer_.append(output, text);
+}
+
 bool csv::EmitterCSV::end(std::ostream& output,
                            const csv::Specification& specification)
 {
-    return true;
+    return buffer_.flush(output);
 }
 
 
@@ -0,0 +1,29 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "emitter_iface.hh"
+#include "record.hh"
+#include "record_batch.hh"
+
+bool csv::EmitterIface::emit_batch(std::ostream& output,
+                                   const csv::Specification& specification,
+                                   const csv::RecordBatch& batch)
+{
+    for(std::size_t row = 0; row < batch.size(); ++row) {
+        if (!emit_record(output, specification, csv::Record(specification, batch.row(row))))
+            return false;
+    }
+    return true;
+}
@@ -19,9 +19,9 @@
 #include <string>
 #include "specification.hh"
 #include "record.hh"
+#include "record_batch.hh"
 #include <ostream>
 namespace csv {
-
     /// An interface class to emit records to an output stream.
     //
     /// This class can be subclassed to suppport JSON, YAML, and other
@@ -47,6 +47,11 @@ namespace csv {
     /// Each record is written out through their own call to emit_record()
     ///
     /// The end() call is used to write data footers and clean up.
+    ///
+    /// Emitters should not write to \a output for each record, but
+    /// collect the formatted records in a csv::OutputBuffer that is
+    /// written out when full, and at end(). Neither should they flush
+    /// \a output for each record, e.g. through \c std::endl.
     class EmitterIface {
 
     public:
@@ -79,31 +84,25 @@ namespace csv {
         ///
         /// A typical sequence to write out a single record would be:
         /// \code
-        ///     auto field_type_iter { specification.fields().begin() };
-        ///     for(const auto& field: record.fields()) {
-	///
-	///         // Convert record field to string.
-        ///         // The name of the field is available in field_type->name_
-	///         switch(field_type_iter->type_) {
-	///           case csv::FieldType::INT64:
-	///             write_field(std::to_string(std::get<int64_t>(field)));
-	///             break;
-	///
-	///           case csv::FieldType::DOUBLE:
-	///             write_field(std::to_string(std::get<double>(field)));
-	///             break;
-	///
-	///           case csv::FieldType::STRING:
-	///             write_field(std::get<std::string>(field));
-	///             break;
-	///         }
-	///         ++field_type_iter;
+        ///     std::size_t field_index(0);
+        ///
+        ///     line.append(specification.record_prefix(csv::TextFormat::CSV));
+        ///     for(const auto& field: specification.fields()) {
+        ///         // Format and escape the value with the function planned for its type,
+        ///         // and add the separator, or the newline after the last field.
+        ///         csv::append_value(line, field, record, field_index++,
+        ///                           specification.escaper(csv::TextFormat::CSV));
+        ///         line.append(field.after(csv::TextFormat::CSV));
         ///     }
         /// \endcode
         ///
-        /// The record iterator field is advanced in lockstep with the
-        /// specification field_type_iter, enabling the code to determine
-        /// of the name and data type of each field being written.
+        /// The name and data type of each field being written is
+        /// available in \c field.name_ and \c field.type_ for
+        /// formats not planned by csv::Specification.
+        ///
+        /// Numbers should be formatted with the functions in csv_format.hh,
+        /// which are locale independent and format doubles without
+        /// any loss of precision.
         ///
         /// @param output The output file stream to emit the record to to.
         /// @param specification  Record specification.
@@ -115,6 +114,96 @@ namespace csv {
                                  const csv::Specification& specification,
                                  const class Record& record)  = 0;
 
+        /// Emit a batch of records to an output stream.
+        //
+        /// This method emits all records in \a batch, in order, with
+        /// the same output as if emit_record() had been called
+        /// once for each of them.
+        ///
+        /// The default implementation copies each row of \a batch into
+        /// a csv::Record and calls emit_record() with it. Subclasses
+        /// should redefine it to format the batch rows directly, and have
+        /// has_native_batch() return true.
+        ///
+        /// @param output The output file stream to emit the records to to.
+        /// @param specification  Record specification.
+        /// @param batch The records to emit.
+        //
+        /// @return true - Records were successfully emitted.
+        /// @return false - Record data could not be emitted.
+        virtual bool emit_batch(std::ostream& output,
+                                const csv::Specification& specification,
+                                const csv::RecordBatch& batch);
+
+        /// Return true if emit_batch() is implemented natively.
+        //
+        /// csv::convert() reads records batch by batch if both the
+        /// ingester and the emitter implement batches natively.
+        ///
+        virtual bool has_native_batch(void) const { return false; }
+
+        /// Return true if format_batch() and emit_formatted() are implemented.
+        //
+        /// Emitters whose output for a batch does not depend on the
+        /// batches emitted before it return true, and the parallel
+        /// csv::convert() functions then format each batch in the
+        /// worker thread that parsed it, leaving only the write of
+        /// the formatted text to the thread emitting in order.
+        ///
+        /// The output of begin() is written before, and that of end()
+        /// after, all formatted batches. Since the batches may be
+        /// written straight to a file descriptor, see the positional
+        /// csv::convert(), an emitter returning true must not leave
+        /// output of begin() in its own buffers.
+        ///
+        virtual bool has_parallel_format(void) const { return false; }
+
+        /// Format a batch of records without writing it.
+        //
+        /// Appends the records in \a batch to \a text, with the same
+        /// output as emit_batch(). Called concurrently from several
+        /// threads, each with its own batch and text, so it must not
+        /// modify the emitter.
+        ///
+        /// The default implementation does nothing.
+        ///
+        /// @param text The string to append the formatted records to.
+        /// @param specification  Record specification.
+        /// @param batch The records to format.
+        ///
+        virtual void format_batch(std::string& text,
+                                  const csv::Specification& specification,
+                                  const csv::RecordBatch& batch) const {}
+
+        /// Emit records formatted by format_batch().
+        //
+        /// Called in the original order of the batches, by a single
+        /// thread, between begin() and end().
+        ///
+        /// The default implementation writes \a text unbuffered.
+        ///
+        /// @param output The output file stream to emit the records to to.
+        /// @param specification  Record specification.
+        /// @param text Records formatted by format_batch().
+        ///
+        /// @return true - Records were successfully emitted.
+        /// @return false - Record data could not be emitted.
+        virtual bool emit_formatted(std::ostream& output,
+                                    const csv::Specification& specification,
+                                    const std::string& text) {
+            output.write(text.data(), text.length());
+            return output.good();
+        }
+
+        /// Set the number of bytes to buffer before writing to the output stream.
+        //
+        /// Larger buffers result in fewer, larger writes to the
+        /// output stream. The default implementation does nothing.
+        ///
+        /// @param size The number of bytes to collect before writing them out.
+        ///
+        virtual void set_buffer_size(std::size_t size) {}
+
         /// Emit footer data and clean up.
         //
         /// Allows for emitter to write out footer data and clean up.
@@ -17,6 +17,8 @@
 #include <iostream>
 #include "factory.hh"
 #include "factory_impl.hh"
+#include "csv_format.hh"
+#include "csv_stats.hh"
 #include "emitter_factory_impl.hh"
 
 
@@ -46,69 +48,73 @@ bool csv::EmitterJSON::begin(std::ostream& output,
     //
     // Emit the start of an array.
     //
-    output << "[" << std::endl;
-    return true;
+    buffer_.data().append("[\n");
+    return buffer_.write_if_full(output);
+}
+
+//
+// Helper function. Not visible to the outside.
+//
+// Emit a single record, provided either as a csv::Record or as
+// a csv::RecordBatch::Row.
+//
+// The record is appended to 'output', which is the data of the
+// emitter's output buffer.
+//
+template <typename ROW>
+static void emit_row(std::string& output,
+                     const csv::Specification& specification,
+                     const ROW& row)
+{
+    const csv::Escaper& escaper(specification.escaper(csv::TextFormat::JSON));
+    std::size_t field_index(0);
+
+    // If this is not the first record, add a comma.
+    if (row.index() > 0)
+        output.append(",\n");
+
+    // The braces, field names, quotes, and commas are
+    // planned by the specification.
+    output.append(specification.record_prefix(csv::TextFormat::JSON));
+
+    for(const auto& field: specification.fields()) {
+        csv::append_value(output, field, row, field_index, escaper);
+        output.append(field.after(csv::TextFormat::JSON));
+        ++field_index;
+    }
 }
 
 bool csv::EmitterJSON::emit_record(std::ostream& output,
                                  const csv::Specification& specification,
                                  const class Record& record)
 {
-    auto field_type_iter{ specification.fields().begin() };
+    CSV_STATS_TIME_SAMPLED(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, 1);
+    emit_row(buffer_.data(), specification, record);
+    return buffer_.write_if_full(output);
+}
 
-    // Start with a new object.
-    // If this is not the first record, add a comma.
-    if (record.index() > 0)
-        output << "," << std::endl << "{" << std::endl;
-    else
-        output << "{" << std::endl;
-
-    for(const auto& field: record.fields()) {
-
-
-        // Emit the field name.
-        output << "    \"" << field_type_iter->name_ << "\": ";
-
-        // Convert the given data type of the record's field
-        // to a string field.
-        switch(field_type_iter->type_) {
-        case csv::FieldType::INT64:
-            output << std::get<int64_t>(field);
-            break;
-
-        case csv::FieldType::DOUBLE:
-            output << std::get<double>(field);
-            break;
-
-        case csv::FieldType::STRING:
-            output << "\"" << std::get<std::string>(field) << "\"";
-            break;
-
-        default:
-            std::cout << "Unknown data type: " << int(field_type_iter->type_)  << std::endl;
-            exit(255);
-        }
-        ++field_type_iter;
-
-        // Is this the last element in the object?
-        // If not, add a trailing comma.
-        //
-        if (field_type_iter != specification.fields().end()) 
-            output << "," << std::endl;
-        else
-            output << std::endl;
+bool csv::EmitterJSON::emit_batch(std::ostream& output,
+                                  const csv::Specification& specification,
+                                  const csv::RecordBatch& batch)
+{
+    CSV_STATS_TIME(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, batch.size());
 
-    }
-    output << "}" << std::endl;
+    for(std::size_t row = 0; row < batch.size(); ++row) {
+        emit_row(buffer_.data(), specification, batch.row(row));
 
+        if (!buffer_.write_if_full(output))
+            return false;
+    }
     return true;
 }
 
 bool csv::EmitterJSON::end(std::ostream& output,
                            const csv::Specification& specification)
 {
-    output << "]" << std::endl;
-    return true;
+    buffer_.data().append("]\n");
+    return buffer_.flush(output);
 }
 
 
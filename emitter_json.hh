@@ -21,6 +21,7 @@
 #ifndef __JSON_EMITTER_HH__
 #define __JSON_EMITTER_HH__
 #include "emitter_iface.hh"
+#include "output_buffer.hh"
 #include <string>
 #include <memory>
 #include <fstream>
@@ -88,10 +89,33 @@ namespace csv {
                          const csv::Specification& specification,
                          const class Record& record) override;
 
+        /// Emit a batch of JSON records to an output stream.
+        //
+        /// Formats the rows of \a batch directly, producing the same
+        /// output as emit_record().
+        ///
+        /// @param output The output file stream to emit the records to to.
+        /// @param specification  Record specification to retrieve name and type from.
+        /// @param batch The records to emit.
+        //
+        /// @return true - Records were successfully emitted.
+        /// @return false - Record data could not be emitted.
+        ///
+        bool emit_batch(std::ostream& output,
+                        const csv::Specification& specification,
+                        const csv::RecordBatch& batch) override;
+
+        /// Return true, since emit_batch() is implemented natively.
+        bool has_native_batch(void) const override { return true; }
+
+        /// Set the number of bytes to collect before writing to the output stream.
+        void set_buffer_size(std::size_t size) override { buffer_.set_capacity(size); }
+
         /// Emit the JSON footer.
         //
         /// This call emits a single \c "]" to \a output to close out
-        /// the JSON object array opened up by begin().
+        /// the JSON object array opened up by begin(), and writes out
+        /// all records collected by the output buffer.
         ///
         /// @return true - Footer was successfully emitted.
         /// @return false - Footer could not be emitted.
@@ -99,6 +123,8 @@ namespace csv {
         bool end(std::ostream& output,
                  const csv::Specification& specification) override;
     private:
+        /// Formatted records not yet written to the output stream.
+        csv::OutputBuffer buffer_;
     };
 };
 
@@ -0,0 +1,112 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "emitter_jsonl.hh"
+#include <iostream>
+#include "factory.hh"
+#include "factory_impl.hh"
+#include "csv_stats.hh"
+
+
+bool emitter_jsonl_registration_ =
+    csv::Factory<csv::EmitterIface>::
+    register_producer("jsonl",
+                      [](void) -> std::shared_ptr<csv::EmitterIface> {
+                          return std::make_shared<csv::EmitterJSONL>();
+                      });
+
+
+bool csv::EmitterJSONL::begin(std::ostream& output,
+                              const std::string& config,
+                              const csv::Specification& specification)
+{
+    return true;
+}
+
+//
+// Helper function. Not visible to the outside.
+//
+// Emit a single record, provided either as a csv::Record or as
+// a csv::RecordBatch::Row, as a line appended to 'output'.
+//
+// Nothing but the record itself is written, so that lines
+// formatted by different threads can be concatenated.
+//
+template <typename ROW>
+static void emit_row(std::string& output,
+                     const csv::Specification& specification,
+                     const ROW& row)
+{
+    const csv::Escaper& escaper(specification.escaper(csv::TextFormat::JSONL));
+    std::size_t field_index(0);
+
+    output.append(specification.record_prefix(csv::TextFormat::JSONL));
+
+    for(const auto& field: specification.fields()) {
+        csv::append_value(output, field, row, field_index, escaper);
+        output.append(field.after(csv::TextFormat::JSONL));
+        ++field_index;
+    }
+}
+
+bool csv::EmitterJSONL::emit_record(std::ostream& output,
+                                    const csv::Specification& specification,
+                                    const class Record& record)
+{
+    CSV_STATS_TIME_SAMPLED(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, 1);
+    emit_row(buffer_.data(), specification, record);
+    return buffer_.write_if_full(output);
+}
+
+bool csv::EmitterJSONL::emit_batch(std::ostream& output,
+                                   const csv::Specification& specification,
+                                   const csv::RecordBatch& batch)
+{
+    CSV_STATS_TIME(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, batch.size());
+
+    for(std::size_t row = 0; row < batch.size(); ++row) {
+        emit_row(buffer_.data(), specification, batch.row(row));
+
+        if (!buffer_.write_if_full(output))
+            return false;
+    }
+    return true;
+}
+
+void csv::EmitterJSONL::format_batch(std::string& text,
+                                     const csv::Specification& specification,
+                                     const csv::RecordBatch& batch) const
+{
+    CSV_STATS_TIME(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, batch.size());
+
+    for(std::size_t row = 0; row < batch.size(); ++row)
+        emit_row(text, specification, batch.row(row));
+}
+
+bool csv::EmitterJSONL::emit_formatted(std::ostream& output,
+                                       const csv::Specification& specification,
+                                       const std::string& text)
+{
+    return buffer_.append(output, text);
+}
+
+bool csv::EmitterJSONL::end(std::ostream& output,
+                            const csv::Specification& specification)
+{
+    return buffer_.flush(output);
+}
@@ -0,0 +1,105 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __JSONL_EMITTER_HH__
+#define __JSONL_EMITTER_HH__
+#include "emitter_iface.hh"
+#include "output_buffer.hh"
+#include <string>
+#include "factory.hh"
+
+namespace csv {
+    /// A JSON Lines Emitter class.
+    //
+    /// This class emits each record as a compact JSON object on a
+    /// line of its own:
+    /// \code
+    /// {"<field-name-1>":<value>,"<field-name-2>":<value>,...}
+    /// \endcode
+    ///
+    /// Unlike csv::EmitterJSON, there is no enclosing array and no
+    /// separator between records, so the output of a batch does not
+    /// depend on the records before it. Batches are formatted by the
+    /// worker threads of the parallel csv::convert() functions, see
+    /// has_parallel_format().
+    ///
+    class EmitterJSONL: public EmitterIface {
+    public:
+        /// Default constructor.
+        EmitterJSONL(void) = default;
+
+        /// Default destructor.
+        ~EmitterJSONL(void) = default;
+
+        /// Start emitting. Nothing is written.
+        bool begin(std::ostream& output,
+                   const std::string& config,
+                   const csv::Specification& specification) override;
+
+        /// Emit a single record as a line to an output stream.
+        //
+        /// The field name/value pairs are written in the same order
+        /// that they appear in the vector returned by record.fields().
+        /// String values are quoted and escaped.
+        ///
+        /// @param output The output file stream to emit the record to to.
+        /// @param specification  Record specification to retrieve name and type from.
+        /// @param record The record to emit.
+        //
+        /// @return true - Record was successfully emitted.
+        /// @return false - Record data could not be emitted.
+        ///
+        bool emit_record(std::ostream& output,
+                         const csv::Specification& specification,
+                         const class Record& record) override;
+
+        /// Emit a batch of records to an output stream.
+        //
+        /// Formats the rows of \a batch directly, producing the same
+        /// output as emit_record().
+        ///
+        bool emit_batch(std::ostream& output,
+                        const csv::Specification& specification,
+                        const csv::RecordBatch& batch) override;
+
+        /// Return true, since emit_batch() is implemented natively.
+        bool has_native_batch(void) const override { return true; }
+
+        /// Return true, since each batch is formatted independently.
+        bool has_parallel_format(void) const override { return true; }
+
+        /// Format the rows of \a batch into \a text.
+        void format_batch(std::string& text,
+                          const csv::Specification& specification,
+                          const csv::RecordBatch& batch) const override;
+
+        /// Emit records formatted by format_batch(), after any records buffered before them.
+        bool emit_formatted(std::ostream& output,
+                            const csv::Specification& specification,
+                            const std::string& text) override;
+
+        /// Set the number of bytes to collect before writing to the output stream.
+        void set_buffer_size(std::size_t size) override { buffer_.set_capacity(size); }
+
+        /// Write out all records collected by the output buffer.
+        bool end(std::ostream& output,
+                 const csv::Specification& specification) override;
+    private:
+        /// Formatted records not yet written to the output stream.
+        csv::OutputBuffer buffer_;
+    };
+};
+
+#endif
@@ -17,6 +17,8 @@
 #include <iostream>
 #include "factory.hh"
 #include "factory_impl.hh"
+#include "csv_format.hh"
+#include "csv_stats.hh"
 
 
 //
@@ -44,54 +46,82 @@ bool csv::EmitterYAML::begin(std::ostream& output,
     return true;
 }
 
-bool csv::EmitterYAML::emit_record(std::ostream& output,
-                                 const csv::Specification& specification,
-                                 const class Record& record)
+//
+// Helper function. Not visible to the outside.
+//
+// Emit a single record, provided either as a csv::Record or as
+// a csv::RecordBatch::Row.
+//
+// The record is appended to 'output', which is the data of the
+// emitter's output buffer.
+//
+template <typename ROW>
+static void emit_row(std::string& output,
+                     const csv::Specification& specification,
+                     const ROW& row)
 {
-    auto field_type_iter{ specification.fields().begin() };
-    bool first_element = true;
-    static std::string first_elem_hdr("- ");
-    static std::string elem_hdr("  ");
+    const csv::Escaper& escaper(specification.escaper(csv::TextFormat::YAML));
+    std::size_t field_index(0);
 
+    // The element headers, field names, and quotes are
+    // planned by the specification.
+    output.append(specification.record_prefix(csv::TextFormat::YAML));
 
-    for(const auto& field: record.fields()) {
-
-        // Emit the element name, with the correct header
-        output << (first_element?first_elem_hdr:elem_hdr) << field_type_iter->name_ << ": ";
+    for(const auto& field: specification.fields()) {
+        csv::append_value(output, field, row, field_index, escaper);
+        output.append(field.after(csv::TextFormat::YAML));
+        ++field_index;
+    }
+}
 
-        first_element = false;
+bool csv::EmitterYAML::emit_record(std::ostream& output,
+                                 const csv::Specification& specification,
+                                 const class Record& record)
+{
+    CSV_STATS_TIME_SAMPLED(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, 1);
+    emit_row(buffer_.data(), specification, record);
+    return buffer_.write_if_full(output);
+}
 
-        // Convert the given data type of the record's field
-        // to a string field.
-        switch(field_type_iter->type_) {
-        case csv::FieldType::INT64:
-            output << std::get<int64_t>(field) << std::endl;
-            break;
+bool csv::EmitterYAML::emit_batch(std::ostream& output,
+                                  const csv::Specification& specification,
+                                  const csv::RecordBatch& batch)
+{
+    CSV_STATS_TIME(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, batch.size());
 
-        case csv::FieldType::DOUBLE:
-            output << std::get<double>(field) << std::endl;
-            break;
+    for(std::size_t row = 0; row < batch.size(); ++row) {
+        emit_row(buffer_.data(), specification, batch.row(row));
 
-        case csv::FieldType::STRING:
-            output << "\"" <<std::get<std::string>(field) << "\"" << std::endl;
-            break;
+        if (!buffer_.write_if_full(output))
+            return false;
+    }
+    return true;
+}
 
-        default:
-            std::cout << "Unknown data type: " << int(field_type_iter->type_)  << std::endl;
-            exit(255);
-        }
+void csv::EmitterYAML::format_batch(std::string& text,
+                                 const csv::Specification& specification,
+                                 const csv::RecordBatch& batch) const
+{
+    CSV_STATS_TIME(EMIT);
+    CSV_STATS_ADD(RECORDS_EMITTED, batch.size());
 
-        ++field_type_iter;
-    }
-    output << std::endl;
+    for(std::size_t row = 0; row < batch.size(); ++row)
+        emit_row(text, specification, batch.row(row));
+}
 
-    return true;
+bool csv::EmitterYAML::emit_formatted(std::ostream& output,
+                                   const csv::Specification& specification,
+                                   const std::string& text)
+{
+    return buffer_.append(output, text);
 }
 
 bool csv::EmitterYAML::end(std::ostream& output,
                            const csv::Specification& specification)
 {
-    return true;
+    return buffer_.flush(output);
 }
 
 
@@ -21,6 +21,7 @@
 #ifndef __YAML_EMITTER_HH__
 #define __YAML_EMITTER_HH__
 #include "emitter_iface.hh"
+#include "output_buffer.hh"
 #include <string>
 #include <memory>
 #include <fstream>
@@ -84,18 +85,58 @@ namespace csv {
                          const csv::Specification& specification,
                          const class Record& record) override;
 
-        /// No-op
+        /// Emit a batch of YAML records to an output stream.
         //
-        /// This call does nothing since no YAML footers are needed.
+        /// Formats the rows of \a batch directly, producing the same
+        /// output as emit_record().
+        ///
+        /// @param output The output file stream to emit the records to to.
+        /// @param specification  Record specification to retrieve name and type from.
+        /// @param batch The records to emit.
         //
-        /// @param output Not used
+        /// @return true - Records were successfully emitted.
+        /// @return false - Record data could not be emitted.
+        ///
+        bool emit_batch(std::ostream& output,
+                        const csv::Specification& specification,
+                        const csv::RecordBatch& batch) override;
+
+        /// Return true, since emit_batch() is implemented natively.
+        bool has_native_batch(void) const override { return true; }
+
+        /// Return true, since records are written without separators between them.
+        bool has_parallel_format(void) const override { return true; }
+
+        /// Format the rows of \a batch into \a text.
+        void format_batch(std::string& text,
+                          const csv::Specification& specification,
+                          const csv::RecordBatch& batch) const override;
+
+        /// Emit records formatted by format_batch(), after any records buffered before them.
+        bool emit_formatted(std::ostream& output,
+                            const csv::Specification& specification,
+                            const std::string& text) override;
+
+        /// Set the number of bytes to collect before writing to the output stream.
+        void set_buffer_size(std::size_t size) override { buffer_.set_capacity(size); }
+
+        /// Write out any buffered records.
+        //
+        /// No YAML footers are needed, so this call only writes out
+        /// the records collected by the output buffer and flushes
+        /// \a output.
+        //
+        /// @param output The output file stream to write buffered records to.
         /// @param specification  Not used
         //
-        /// @return true
+        /// @return true - Buffered records were successfully written.
+        /// @return false - Buffered records could not be written.
         ///
         bool end(std::ostream& output,
                  const csv::Specification& specification) override;
     private:
+        /// Formatted records not yet written to the output stream.
+        csv::OutputBuffer buffer_;
     };
 
 
@@ -0,0 +1,215 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "fd_stream.hh"
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+csv::FdStreamBuf::FdStreamBuf(int fd, std::size_t buffer_size):
+    fd_(fd),
+    buffer_size_(buffer_size?buffer_size:default_buffer_size)
+{
+}
+
+csv::FdStreamBuf::~FdStreamBuf(void)
+{
+    flush_buffer();
+}
+
+std::size_t csv::FdStreamBuf::read_some(char* data, std::size_t size)
+{
+    while(true) {
+        ssize_t res(::read(fd_, data, size));
+
+        if (res >= 0)
+            return res;
+
+        if (errno != EINTR)
+            return 0;
+    }
+}
+
+bool csv::FdStreamBuf::write_all(const char* data, std::size_t size)
+{
+    while(size) {
+        ssize_t res(::write(fd_, data, size));
+
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+
+bool csv::FdStreamBuf::flush_buffer(void)
+{
+    std::size_t size(pptr() - pbase());
+
+    if (!size)
+        return true;
+
+    setp(write_buffer_.data(), write_buffer_.data() + write_buffer_.size());
+    return write_all(write_buffer_.data(), size);
+}
+
+csv::FdStreamBuf::int_type csv::FdStreamBuf::underflow(void)
+{
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    if (read_buffer_.empty())
+        read_buffer_.resize(buffer_size_);
+
+    std::size_t size(read_some(read_buffer_.data(), read_buffer_.size()));
+
+    if (!size)
+        return traits_type::eof();
+
+    setg(read_buffer_.data(), read_buffer_.data(), read_buffer_.data() + size);
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize csv::FdStreamBuf::xsgetn(char* data, std::streamsize size)
+{
+    std::streamsize done(0);
+
+    while(done < size) {
+        std::streamsize available(egptr() - gptr());
+
+        // Hand out buffered data first.
+        if (available) {
+            std::streamsize count(std::min(available, size - done));
+
+            std::memcpy(data + done, gptr(), count);
+            gbump(int(count));
+            done += count;
+            continue;
+        }
+
+        // Read large requests straight into the caller's memory.
+        if (std::size_t(size - done) >= buffer_size_) {
+            std::size_t count(read_some(data + done, size - done));
+
+            if (!count)
+                break;
+
+            done += count;
+            continue;
+        }
+
+        if (underflow() == traits_type::eof())
+            break;
+    }
+    return done;
+}
+
+csv::FdStreamBuf::int_type csv::FdStreamBuf::overflow(int_type ch)
+{
+    if (write_buffer_.empty()) {
+        write_buffer_.resize(buffer_size_);
+        setp(write_buffer_.data(), write_buffer_.data() + write_buffer_.size());
+    } else if (!flush_buffer())
+        return traits_type::eof();
+
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize csv::FdStreamBuf::xsputn(const char* data, std::streamsize size)
+{
+    // Write large blocks straight from the caller's memory,
+    // after any data buffered ahead of them.
+    if (std::size_t(size) >= buffer_size_) {
+        if (!flush_buffer() || !write_all(data, size))
+            return 0;
+
+        return size;
+    }
+
+    if (epptr() - pptr() < size &&
+        traits_type::eq_int_type(overflow(traits_type::eof()), traits_type::eof()))
+        return 0;
+
+    std::memcpy(pptr(), data, size);
+    pbump(int(size));
+    return size;
+}
+
+int csv::FdStreamBuf::sync(void)
+{
+    return flush_buffer()?0:-1;
+}
+
+bool csv::set_pipe_size(int fd, std::size_t size)
+{
+#ifdef F_SETPIPE_SZ
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISFIFO(st.st_mode))
+        return false;
+
+    // Unprivileged processes are limited by /proc/sys/fs/pipe-max-size.
+    for(; size >= 65536; size /= 2) {
+        if (fcntl(fd, F_SETPIPE_SZ, int(size)) != -1)
+            return true;
+
+        if (errno != EPERM)
+            return false;
+    }
+#endif
+    return false;
+}
+
+bool csv::write_at(int fd, const char* data, std::size_t size, std::size_t offset)
+{
+    while(size) {
+        ssize_t res(::pwrite(fd, data, size, offset));
+
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+        data += res;
+        size -= res;
+        offset += res;
+    }
+    return true;
+}
+
+bool csv::supports_write_at(int fd)
+{
+    struct stat st;
+    int flags(fcntl(fd, F_GETFL));
+
+    // pwrite(2) ignores the offset of files opened for appending.
+    if (flags == -1 || (flags & O_APPEND))
+        return false;
+
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
@@ -0,0 +1,123 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __FD_STREAM_HH__
+#define __FD_STREAM_HH__
+#include <cstddef>
+#include <streambuf>
+#include <vector>
+
+namespace csv {
+    /// A stream buffer reading from and writing to a file descriptor.
+    //
+    /// Used to attach a std::istream or std::ostream to stdin and
+    /// stdout, or any other pipe or file descriptor, with raw
+    /// read(2) and write(2) calls.
+    ///
+    /// Data is read and written in blocks of up to the buffer size.
+    /// Reads and writes of at least the buffer size bypass the buffer
+    /// and go straight to the file descriptor, so that e.g. the
+    /// blocks written by a csv::OutputBuffer are not copied again.
+    ///
+    /// The buffers are allocated on first use, so an instance that is
+    /// only read from never allocates a write buffer, and vice versa.
+    ///
+    /// The file descriptor is not closed by the destructor.
+    ///
+    class FdStreamBuf: public std::streambuf {
+    public:
+        /// Default size of the read and write buffers.
+        static constexpr std::size_t default_buffer_size = 1024*1024;
+
+        /// Constructor.
+        //
+        /// @param fd The file descriptor to read from or write to.
+        /// @param buffer_size The size of the read and write buffers.
+        ///
+        FdStreamBuf(int fd, std::size_t buffer_size = default_buffer_size);
+
+        /// Destructor. Writes out any buffered data.
+        ~FdStreamBuf(void);
+
+        FdStreamBuf(const FdStreamBuf&) = delete;
+        FdStreamBuf& operator=(const FdStreamBuf&) = delete;
+
+        /// Return the file descriptor.
+        int fd(void) const { return fd_; }
+
+    protected:
+        int_type underflow(void) override;
+        std::streamsize xsgetn(char* data, std::streamsize size) override;
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char* data, std::streamsize size) override;
+        int sync(void) override;
+
+    private:
+        // Read up to 'size' bytes. Returns 0 at end of file or on error.
+        std::size_t read_some(char* data, std::size_t size);
+
+        // Write all of 'size' bytes. Returns false on error.
+        bool write_all(const char* data, std::size_t size);
+
+        // Write out the put area.
+        bool flush_buffer(void);
+
+        int fd_;
+        std::size_t buffer_size_;
+        std::vector<char> read_buffer_;
+        std::vector<char> write_buffer_;
+    };
+
+    /// Write data at a position in a file.
+    //
+    /// Writes all of \a size bytes with pwrite(2), retrying partial
+    /// writes, without moving the file offset of \a fd. Several
+    /// threads can write to different parts of the same file at
+    /// the same time.
+    ///
+    /// @param fd The file descriptor to write to.
+    /// @param data The data to write.
+    /// @param size The number of bytes to write.
+    /// @param offset The position in the file to write the first byte to.
+    ///
+    /// @return true - All data was written.
+    /// @return false - The data could not be written.
+    ///
+    extern bool write_at(int fd, const char* data, std::size_t size, std::size_t offset);
+
+    /// Return true if positional writes to \a fd end up where requested.
+    //
+    /// That is the case for files not opened with \c O_APPEND,
+    /// but not for pipes, sockets, and terminals.
+    ///
+    extern bool supports_write_at(int fd);
+
+    /// Enlarge the kernel buffer of a pipe.
+    //
+    /// Larger pipe buffers let the processes on each side of a pipe
+    /// transfer more data per context switch.
+    ///
+    /// If \a size exceeds the limit for unprivileged processes,
+    /// progressively smaller sizes are tried.
+    ///
+    /// @param fd The file descriptor of one end of the pipe.
+    /// @param size The requested buffer size in bytes.
+    ///
+    /// @return true - The pipe buffer was enlarged.
+    /// @return false - \a fd is not a pipe, or the buffer could not be enlarged.
+    ///
+    extern bool set_pipe_size(int fd, std::size_t size);
+};
+#endif
@@ -0,0 +1,283 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "filter.hh"
+#include "csv_common.hh"
+#include "csv_error.hh"
+#include <iostream>
+#include <cctype>
+#include <stdlib.h>
+
+csv::Filter::Filter(const Specification& specification,
+                    const std::string& expression):
+    input_fields_(&specification.input_fields()),
+    expression_(expression)
+{
+    parse_or();
+
+    if (!peek_token().empty())
+        error("Unexpected '" + peek_token() + "'");
+}
+
+void csv::Filter::error(const std::string& message) const
+{
+    std::cout << "Filter: " << expression_ << std::endl;
+    std::cout << "Filter: " << message << " at position " << position_ << "." << std::endl;
+    exit(255);
+}
+
+std::string csv::Filter::peek_token(void)
+{
+    std::size_t position(position_);
+    std::string token(next_token());
+
+    position_ = position;
+    return token;
+}
+
+//
+// Tokens are returned with their quotes, so that the parser
+// can tell a quoted name or string from other tokens.
+// The quoted characters are returned unescaped.
+//
+std::string csv::Filter::next_token(void)
+{
+    static const std::string operators[] = { "==", "!=", "<=", ">=", "&&", "||", "<", ">", "(", ")" };
+    const std::string& expr(expression_);
+    std::string token("");
+
+    while(position_ < expr.length() && isspace(uint8_t(expr[position_])))
+        ++position_;
+
+    if (position_ == expr.length())
+        return token;
+
+    char ch(expr[position_]);
+
+    // Quoted string or field name.
+    if (ch == '"' || ch == '`') {
+        token += expr[position_++];
+
+        while(position_ < expr.length() && expr[position_] != ch) {
+            if (expr[position_] == '\\' && position_ + 1 < expr.length())
+                ++position_;
+
+            token += expr[position_++];
+        }
+
+        if (position_ == expr.length())
+            error("Unterminated " + std::string(1, ch));
+
+        ++position_;
+        return token;
+    }
+
+    // Number.
+    if (isdigit(uint8_t(ch)) || ch == '-' || ch == '+' || ch == '.') {
+        while(position_ < expr.length() &&
+              (isalnum(uint8_t(expr[position_])) || expr[position_] == '.' ||
+               ((expr[position_] == '-' || expr[position_] == '+') &&
+                (token.empty() || token.back() == 'e' || token.back() == 'E'))))
+            token += expr[position_++];
+
+        return token;
+    }
+
+    // Field name.
+    if (isalpha(uint8_t(ch)) || ch == '_') {
+        while(position_ < expr.length() && (isalnum(uint8_t(expr[position_])) || expr[position_] == '_'))
+            token += expr[position_++];
+
+        return token;
+    }
+
+    for(const auto& op: operators) {
+        if (!expr.compare(position_, op.length(), op)) {
+            position_ += op.length();
+            return op;
+        }
+    }
+
+    error("Unexpected '" + std::string(1, ch) + "'");
+}
+
+std::size_t csv::Filter::parse_or(void)
+{
+    std::size_t left(parse_and());
+
+    while(peek_token() == "||") {
+        next_token();
+
+        std::size_t right(parse_and());
+
+        nodes_.push_back(Node { Operator::OR, left, right });
+        left = nodes_.size() - 1;
+    }
+    return left;
+}
+
+std::size_t csv::Filter::parse_and(void)
+{
+    std::size_t left(parse_comparison());
+
+    while(peek_token() == "&&") {
+        next_token();
+
+        std::size_t right(parse_comparison());
+
+        nodes_.push_back(Node { Operator::AND, left, right });
+        left = nodes_.size() - 1;
+    }
+    return left;
+}
+
+std::size_t csv::Filter::parse_comparison(void)
+{
+    static const std::pair<std::string, Operator> operators[] = {
+        { "==", Operator::EQ }, { "!=", Operator::NE },
+        { "<", Operator::LT }, { "<=", Operator::LE },
+        { ">", Operator::GT }, { ">=", Operator::GE }
+    };
+    std::string token(next_token());
+    Node node { Operator::EQ };
+
+    if (token == "(") {
+        std::size_t inner(parse_or());
+
+        if (next_token() != ")")
+            error("Missing ')'");
+
+        // Move the subexpression last, where the caller expects it.
+        nodes_.push_back(nodes_[inner]);
+        return nodes_.size() - 1;
+    }
+
+    // Field name.
+    if (token.empty() || !(isalpha(uint8_t(token[0])) || token[0] == '_' || token[0] == '`'))
+        error("Expected a field name");
+
+    std::string name(token[0] == '`'?token.substr(1):token);
+    auto field_iter(input_fields_->begin());
+
+    while(field_iter != input_fields_->end() && field_iter->name_ != name)
+        ++field_iter;
+
+    if (field_iter == input_fields_->end())
+        error("Unknown field " + name);
+
+    node.field_ = *field_iter;
+    node.token_ = field_iter - input_fields_->begin();
+
+    // Operator.
+    token = next_token();
+    auto op_iter(std::begin(operators));
+
+    while(op_iter != std::end(operators) && op_iter->first != token)
+        ++op_iter;
+
+    if (op_iter == std::end(operators))
+        error("Expected a comparison operator after " + name);
+
+    node.op_ = op_iter->second;
+
+    // Literal value.
+    token = next_token();
+
+    if (node.field_.type_ == csv::FieldType::STRING) {
+        if (token.empty() || token[0] != '"')
+            error("Expected a string to compare " + name + " with");
+
+        node.string_ = token.substr(1);
+    } else {
+        if (token.empty() || token[0] == '"' || token[0] == '`')
+            error("Expected a number to compare " + name + " with");
+
+        if (node.field_.type_ == csv::FieldType::INT64 && csv::parse_int64(token, node.int64_)) {
+            nodes_.push_back(node);
+            return nodes_.size() - 1;
+        }
+
+        if (!csv::parse_double(token, node.double_))
+            error("Expected a number to compare " + name + " with");
+
+        node.fractional_ = true;
+    }
+
+    nodes_.push_back(node);
+    return nodes_.size() - 1;
+}
+
+template <typename T>
+bool csv::Filter::compare(Operator op, const T& left, const T& right)
+{
+    switch(op) {
+    case Operator::EQ: return left == right;
+    case Operator::NE: return left != right;
+    case Operator::LT: return left < right;
+    case Operator::LE: return left <= right;
+    case Operator::GT: return left > right;
+    case Operator::GE: return left >= right;
+    default: return false;
+    }
+}
+
+bool csv::Filter::evaluate(std::size_t index,
+                           const std::vector<std::string_view>& tokens,
+                           std::string& error) const
+{
+    const Node& node(nodes_[index]);
+
+    switch(node.op_) {
+    case Operator::AND:
+        return evaluate(node.left_, tokens, error) && evaluate(node.right_, tokens, error);
+
+    // A left hand side that could not be compared fails the match.
+    case Operator::OR:
+        return evaluate(node.left_, tokens, error) ||
+            (error.empty() && evaluate(node.right_, tokens, error));
+
+    default:
+        break;
+    }
+
+    const std::string_view& t(tokens[node.token_]);
+
+    switch(node.field_.type_) {
+    case csv::FieldType::INT64: {
+        int64_t val(0);
+        if (!csv::parse_int64(t, val)) {
+            error = csv::field_value_error(node.field_, t);
+            return false;
+        }
+
+        if (node.fractional_)
+            return compare(node.op_, double(val), node.double_);
+
+        return compare(node.op_, val, node.int64_);
+    }
+
+    case csv::FieldType::DOUBLE: {
+        double val(0.0);
+        if (!csv::parse_double(t, val)) {
+            error = csv::field_value_error(node.field_, t);
+            return false;
+        }
+        return compare(node.op_, val, node.double_);
+    }
+
+    default:
+        return compare(node.op_, t, std::string_view(node.string_));
+    }
+}
@@ -0,0 +1,142 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __FILTER_HH__
+#define __FILTER_HH__
+#include "specification.hh"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace csv {
+    /// A compiled row filter expression.
+    //
+    /// Filters are evaluated on the tokens of a line, before any
+    /// record is built from them, so that lines that are filtered
+    /// out are never converted or emitted.
+    ///
+    /// An expression is one or more comparisons of a field with a
+    /// literal value, combined with \c && and \c ||, and grouped
+    /// with parentheses. \c && binds harder than \c ||.
+    ///
+    /// \code
+    ///     status == "ok" && (latency > 100 || retries >= 3)
+    /// \endcode
+    ///
+    /// The supported comparison operators are \c ==, \c !=, \c <,
+    /// \c <=, \c >, and \c >=. Field names containing other
+    /// characters than letters, digits, and underscores are quoted
+    /// with backticks, as in \c `First Field`.
+    ///
+    /// csv::FieldType::INT64 and csv::FieldType::DOUBLE fields are
+    /// compared with numbers, and csv::FieldType::STRING fields are
+    /// compared byte by byte with double quoted strings. A backslash
+    /// in a string quotes the next character.
+    ///
+    /// Only the tokens of the fields that a line is matched against
+    /// are converted. The right hand side of \c && and \c || is
+    /// only evaluated when needed.
+    ///
+    class Filter {
+    public:
+        /// Compile an expression.
+        //
+        /// Syntax errors and unknown fields are reported on stdout,
+        /// exiting the program.
+        ///
+        /// @param specification The specification whose input_fields() the expression refers to.
+        /// @param expression The expression to compile.
+        ///
+        Filter(const Specification& specification,
+               const std::string& expression);
+
+        /// Return true if a line matches the expression.
+        //
+        /// A token that is not a valid value of its numeric field
+        /// cannot be compared, and fails the match with \a error set
+        /// to the reason.
+        ///
+        /// @param tokens One token per field in Specification::input_fields(),
+        ///               as returned by csv::tokenize_line().
+        /// @param error Cleared, and set to the reason if a token cannot be compared.
+        ///
+        /// @return true - The line matches the expression.
+        /// @return false - The line does not match, or \a error is set.
+        ///
+        bool match(const std::vector<std::string_view>& tokens, std::string& error) const {
+            error.clear();
+            return evaluate(nodes_.size() - 1, tokens, error);
+        }
+
+    private:
+        enum class Operator {
+            EQ, NE, LT, LE, GT, GE, AND, OR
+        };
+
+        /// A comparison, or an AND or OR of two other nodes.
+        struct Node {
+            Operator op_;
+
+            /// Operands of AND and OR.
+            std::size_t left_ { 0 };
+            std::size_t right_ { 0 };
+
+            /// Compared field, and its input token index.
+            Specification::Field field_;
+            uint32_t token_ { 0 };
+
+            /// Literal values compared with.
+            int64_t int64_ { 0 };
+            double double_ { 0.0 };
+            std::string string_;
+
+            /// True if an INT64 field is compared with a fractional number.
+            bool fractional_ { false };
+        };
+
+        bool evaluate(std::size_t node,
+                      const std::vector<std::string_view>& tokens,
+                      std::string& error) const;
+
+        template <typename T>
+        static bool compare(Operator op, const T& left, const T& right);
+
+        // Recursive descent parser. Each returns the index of the parsed node.
+        std::size_t parse_or(void);
+        std::size_t parse_and(void);
+        std::size_t parse_comparison(void);
+
+        // Return the next token of the expression, and move past it.
+        std::string next_token(void);
+
+        // Return the next token of the expression.
+        std::string peek_token(void);
+
+        // Report a syntax error and exit.
+        [[noreturn]] void error(const std::string& message) const;
+
+        /// Fields that names in the expression are looked up in.
+        /// Only used while compiling.
+        const std::vector<Specification::Field>* input_fields_;
+
+        std::string expression_;
+        std::size_t position_ { 0 };
+
+        /// Compiled nodes. The last node is the root of the expression.
+        std::vector<Node> nodes_;
+    };
+};
+#endif
@@ -18,9 +18,8 @@
 #include <fstream>
 #include "factory.hh"
 #include "factory_impl.hh"
-#include "csv_common.hh"
 #include "specification.hh"
-#include "record.hh"
+#include "csv_stats.hh"
 #include "ingestion_factory_impl.hh"
 
 // Create a factory producer
@@ -33,37 +32,33 @@ bool ingestion_csv_registration_ =
                                                          });
 
 
-std::shared_ptr<csv::Record> csv::IngestionCSV::ingest_record(std::istream& input,
-                                                              const csv::Specification& specification,
-                                                              const std::size_t record_index)
+bool csv::IngestionCSV::next_line(std::istream& input,
+                                  const csv::Specification& specification)
 {
-    std::string line {""};
-    std::vector<std::string> fields;
-    uint32_t field_count(0);
+    const csv::StructuralChars chars { uint8_t(specification.separator_char()),
+                                       uint8_t(specification.escape_char()),
+                                       uint8_t(specification.quote_char()) };
 
-    // Read the next line.
-    if (!std::getline(input, line))
-        return NULL;
+    if (chars.quote && !tokenizer_)
+        tokenizer_.reset(new csv::StructuralTokenizer(chars.separator, chars.escape, chars.quote));
 
-    // Tokenize the line.
-    // Use the separator and escape char from the specification that
-    // is tied to the dataset.
-    //
-    field_count = csv::tokenize_line(line,
-                                     specification.separator_char(),
-                                     specification.escape_char(),
-                                     fields);
+    while(true) {
+        // Read the next line. A quoted field, or an escaped newline,
+        // may continue the record on the lines after it.
+        {
+            CSV_STATS_TIME_SAMPLED(READ);
+            if (!((chars.quote || chars.escape)?
+                  csv::read_record(input, line_, chars):
+                  bool(std::getline(input, line_))))
+                return false;
+        }
+        CSV_STATS_ADD(BYTES_READ, line_.length() + 1);
+        CSV_STATS_ADD(LINES, 1);
 
-    // Did we get the correct number of tokens?
-    //
-    if (field_count != specification.field_count()) {
-        std::cout << "IngestionCSV::ingest_record(): line: " << record_index+1 <<
-            ": Incorrect number of fields: "<< field_count <<
-            ". Expected: " << specification.field_count() << std::endl;
-        exit(255);
-    }
+        // Records with quoted or escaped newlines span several lines.
+        start_record(line_, chars.quote || chars.escape);
 
-    // Create a record and return it.
-    //
-    return std::make_shared<csv::Record>(specification, record_index, fields);
+        if (tokenize(specification))
+            return true;
+    }
 }
@@ -21,15 +21,43 @@
 #ifndef __INGESTION_CSV__
 #define __INGESTION_CSV__
 
-#include "ingestion_iface.hh"
+#include "ingestion_lines.hh"
+#include <string>
 
 namespace csv {
     /// Class to ingest CSV data
     //
     /// Intances of this class can read and parse CSV data from an input stream.
     ///
+    /// A single line is retrieved from the input stream and parsed
+    /// according to the data in the specification.
+    ///
+    /// The parsed fields of the CSV line will have their data types
+    /// determined by the corresponding element in the csv::Field vector
+    /// returned by specification.fields().
+    ///
+    /// The CSV line is assumed to have the same number of fields as
+    /// the number of elements returned by specification.fields().
+    ///
+    /// The line is assumed to have fields separated by the
+    /// character returned by specification.separator_char().
+    ///
+    /// Field data can be escaped by the character returned by
+    /// specification.escape_char(). If an escape character is
+    /// encoutered, the next character will be added to the field
+    /// data even if it is a separator character.
+    ///
+    /// White-spaces are removed before and after numerical values
+    /// (csv::FieldType::INT64 and csv::FieldType::DOUBLE) prior
+    /// to parsing the value. Strings retain their white spaces.
+    ///
+    /// If specification.quote_char() is set, fields enclosed in
+    /// it may hold separators and newlines, and are read by a
+    /// csv::StructuralTokenizer. A record continues on the next
+    /// line while it ends inside quotes.
+    ///
     class IngestionCSV:
-        public IngestionIface {
+        public IngestionLines {
     public:
         /// Default constructor.
         IngestionCSV(void) = default;
@@ -37,43 +65,14 @@ namespace csv {
         /// Default destructor.
         ~IngestionCSV(void) = default;
 
-        /// Read and parse a single CSV line.
-        //
-        /// A single line is retrieved from \a input and parsed according
-        /// to the data in \a specification.
-        ///
-        /// The parsed fields of the CSV line will have their data types
-        /// determined by the corresponding element in the csv::Field vector
-        /// returned by specification.fields().
-        ///
-        /// The CSV line is assumed to have the same number of fields as
-        /// the number of elements returned by specification.fields().
-        ///
-        /// The line is assumed to have fields separated by the
-        /// character returned by specification.separator_char().
-        ///
-        /// Field data can be escaped by the character returned by
-        /// specification.escape_char(). If an escape character is
-        /// encoutered, the next character will be added to the field
-        /// data even if it is a separator character.
-        ///
-        /// White-spaces are removed before and after numerical values
-        /// (csv::FieldType::INT64 and csv::FieldType::DOUBLE) prior
-        /// to parsing the value. Strings retain their white spaces.
-        ///
-        /// String quotes are not supported.
-        ///
-        /// @param input The input stream to read and parse a CSV line from
-        /// @param specification The specification to use when parsing the CSV data.
-        /// @param record_index The  index of the current record (starting at 0). Not used.
-        ///
-        /// @return A shared pointer to a newly created csv::Record with the parsed CSV data.
-        /// @return NULL input has reached an end.
-        ///
-        /// \bug There is no way for this function to report a failed CSV line parsing.
-        std::shared_ptr<csv::Record> ingest_record(std::istream& input,
-                                                   const csv::Specification& specification,
-                                                   const std::size_t record_index) override;
+    protected:
+        /// Read and tokenize the next line from \a input into fields_.
+        bool next_line(std::istream& input,
+                       const csv::Specification& specification) override;
+
+    private:
+        /// Line buffer, reused between records.
+        std::string line_;
     };
 };
 #endif
@@ -0,0 +1,122 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ingestion_csv_mmap.hh"
+#include <iostream>
+#include "factory.hh"
+#include "factory_impl.hh"
+#include "csv_common.hh"
+#include "specification.hh"
+#include "csv_stats.hh"
+
+// Create a factory producer
+// See emitter_json.hh for details
+//
+bool ingestion_csv_mmap_registration_ =
+    csv::Factory<csv::IngestionIface>::register_producer("csv-mmap",
+                                                         [](void) -> std::shared_ptr<csv::IngestionIface> {
+                                                             return std::make_shared<csv::IngestionCSVMMap>();
+                                                         });
+
+
+bool csv::IngestionCSVMMap::open_file(const std::string& file_name)
+{
+    if (!file_.open(file_name))
+        return false;
+
+    position_ = file_.data();
+    reset_line_number();
+    tokenizer_.reset();
+    return true;
+}
+
+bool csv::IngestionCSVMMap::next_line(std::istream& input,
+                                      const csv::Specification& specification)
+{
+    const csv::StructuralChars chars { uint8_t(specification.separator_char()),
+                                       uint8_t(specification.escape_char()),
+                                       uint8_t(specification.quote_char()) };
+
+    if (chars.quote && !tokenizer_) {
+        tokenizer_.reset(new csv::StructuralTokenizer(chars.separator, chars.escape, chars.quote));
+
+        if (file_.is_open())
+            tokenizer_->reset(position_, file_.data() + file_.size());
+    }
+
+    while(true) {
+        const char* begin(nullptr);
+        const char* end(nullptr);
+        uint32_t field_count(0);
+
+        // Quoted records in the mapped file are located and tokenized
+        // in a single pass over the index of the file.
+        if (tokenizer_ && file_.is_open()) {
+            if (tokenizer_->done())
+                return false;
+
+            begin = tokenizer_->position();
+            fields_.clear();
+            field_count = tokenizer_->next(fields_, buffer_, text_);
+            position_ = tokenizer_->position();
+
+            CSV_STATS_ADD(BYTES_READ, position_ - begin);
+            CSV_STATS_ADD(LINES, 1);
+            start_record(text_, true);
+
+            if (check_field_count(specification, field_count))
+                return true;
+            continue;
+        }
+
+        // Locate the next line.
+        {
+            CSV_STATS_TIME_SAMPLED(READ);
+
+            if (file_.is_open()) {
+                const char* file_end(file_.data() + file_.size());
+
+                // Have we consumed the entire file?
+                if (position_ == file_end)
+                    return false;
+
+                // Locate the end of the line, and move past its newline.
+                begin = position_;
+                end = csv::find_record_end(begin, file_end, specification.escape_char());
+                position_ = (end == file_end)?end:(end + 1);
+                CSV_STATS_ADD(BYTES_READ, position_ - begin);
+            } else {
+                // No file mapped. Fall back to the input stream.
+                if (!((chars.quote || chars.escape)?
+                      csv::read_record(input, line_, chars):
+                      bool(std::getline(input, line_))))
+                    return false;
+
+                begin = line_.data();
+                end = begin + line_.length();
+                CSV_STATS_ADD(BYTES_READ, line_.length() + 1);
+            }
+        }
+        CSV_STATS_ADD(LINES, 1);
+
+        // Records with quoted or escaped newlines span several lines.
+        start_record(std::string_view(begin, end - begin), chars.quote || chars.escape);
+
+        // Tokenize the line in place, with field views pointing
+        // directly into the mapped file.
+        if (tokenize(specification))
+            return true;
+    }
+}
@@ -0,0 +1,77 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __INGESTION_CSV_MMAP__
+#define __INGESTION_CSV_MMAP__
+
+#include "ingestion_lines.hh"
+#include "mapped_file.hh"
+#include <string>
+
+namespace csv {
+    /// Class to ingest CSV data from a memory mapped file.
+    //
+    /// Instances of this class parse CSV data with the same rules as
+    /// csv::IngestionCSV, but read the lines directly out of a file
+    /// mapped into memory by open_file(). No per-line read or copy is
+    /// done.
+    ///
+    /// A newline preceded by the escape character is treated as field
+    /// data and does not terminate the record.
+    ///
+    /// With a quote character in the specification, the records of
+    /// the mapped file are located and tokenized in a single pass by
+    /// a csv::StructuralTokenizer, and quoted newlines do not terminate
+    /// the record either.
+    ///
+    /// If open_file() has not been called, lines are read from the
+    /// input stream provided to ingest_record().
+    ///
+    class IngestionCSVMMap:
+        public IngestionLines {
+    public:
+        /// Default constructor.
+        IngestionCSVMMap(void) = default;
+
+        /// Default destructor.
+        ~IngestionCSVMMap(void) = default;
+
+        /// Memory map the file to ingest.
+        //
+        /// @param file_name The path of the file to map.
+        ///
+        /// @return true - The file was mapped.
+        /// @return false - The file could not be mapped.
+        ///
+        bool open_file(const std::string& file_name) override;
+
+    protected:
+        /// Read and tokenize the next line from the mapped file, or
+        /// from \a input if no file has been mapped, into fields_.
+        bool next_line(std::istream& input,
+                       const csv::Specification& specification) override;
+
+    private:
+        /// The mapped file.
+        MappedFile file_;
+
+        /// The start of the next line to parse in file_
+        const char* position_ { nullptr };
+
+        /// Line buffer used when reading from a stream.
+        std::string line_;
+    };
+};
+#endif
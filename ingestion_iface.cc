@@ -0,0 +1,43 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ingestion_iface.hh"
+#include "record.hh"
+#include "record_batch.hh"
+#include "csv_error.hh"
+
+csv::ErrorHandler& csv::IngestionIface::error_handler(void) const
+{
+    return error_handler_?*error_handler_:csv::ErrorHandler::fail();
+}
+
+std::size_t csv::IngestionIface::ingest_batch(std::istream& input,
+                                              const csv::Specification& specification,
+                                              const std::size_t record_index,
+                                              csv::RecordBatch& batch)
+{
+    batch.clear();
+    batch.set_first_index(record_index);
+
+    while(!batch.full()) {
+        auto record(ingest_record(input, specification, record_index + batch.size()));
+
+        if (!record)
+            break;
+
+        batch.append(*record);
+    }
+    return batch.size();
+}
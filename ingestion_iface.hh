@@ -22,10 +22,14 @@
 #define __INGESTION_IFACE__
 #include <istream>
 #include <memory>
+#include <string>
 namespace csv {
 
     class Specification;
     class Record;
+    class RecordBatch;
+    class RecordPool;
+    class ErrorHandler;
 
 
     /// An interface class to read records from an input stream.
@@ -39,26 +43,103 @@ namespace csv {
     ///
     class IngestionIface {
     public:
+        /// Attach the ingester directly to a file.
+        //
+        /// Ingesters that can process a file more efficiently than through
+        /// a std::istream, for example by memory mapping it, can redefine
+        /// this method to open \a file_name themselves.
+        ///
+        /// Once a file has been successfully opened, the \a input argument
+        /// to ingest_record() is ignored and records are read from
+        /// the opened file instead.
+        ///
+        /// The default implementation does nothing and returns false.
+        ///
+        /// @param file_name The path of the file to read records from.
+        ///
+        /// @return true - The file was opened and will be used by ingest_record().
+        /// @return false - The file could not be opened, or the ingester does not support files.
+        ///
+        virtual bool open_file(const std::string& file_name) { return false; }
+
         /// Read and parse a single record.
         //
         /// The implementation of this method shall:
         ///   - Read a single record from \a input
         ///   - Parse the read record according to \a specification
-        ///   - Return a newly created csv:Record object with the parsed data.
+        ///   - Return a csv:Record object with the parsed data, either newly
+        ///     created or recycled from the ingester's record_pool().
         //
         /// @param input The input stream to read and parse a record data from
         /// @param specification The specification to use when parsing the record data.
         /// @param record_index The index of the current record.
         ///                     Incremented by one for each call to ingest_record().
         ///
-        /// @return Shared pointer to a newly created csv::Record if record was parsed.
+        /// @return Shared pointer to a csv::Record if record was parsed. The record
+        ///         may be reused by the ingester once all references are released.
         /// @return NULL if \a input has reached its end.
-        //
-        /// \bug There is no way for this function to report a failed record parsing.
+        ///
+        /// Records that cannot be parsed are reported to error_handler()
+        /// and skipped.
+        ///
         virtual std::shared_ptr<csv::Record> ingest_record(std::istream& input,
                                                            const csv::Specification& specification,
                                                            const std::size_t record_index) = 0;
 
+        /// Read and parse a batch of records.
+        //
+        /// The implementation of this method shall:
+        ///   - Clear \a batch and set its first index to \a record_index
+        ///   - Read and parse records from \a input until \a batch is full or \a input has reached its end.
+        ///   - Return the number of records added to \a batch.
+        ///
+        /// The default implementation calls ingest_record() once for
+        /// each record and copies the returned records into \a batch.
+        /// Subclasses should redefine it to parse directly into \a batch,
+        /// and have has_native_batch() return true.
+        ///
+        /// @param input The input stream to read and parse record data from
+        /// @param specification The specification to use when parsing the record data.
+        /// @param record_index The index of the first record to read.
+        /// @param batch The batch to fill with records.
+        ///
+        /// @return The number of records in \a batch. 0 if \a input has reached its end.
+        ///
+        virtual std::size_t ingest_batch(std::istream& input,
+                                         const csv::Specification& specification,
+                                         const std::size_t record_index,
+                                         csv::RecordBatch& batch);
+
+        /// Return true if ingest_batch() is implemented natively.
+        //
+        /// csv::convert() reads records batch by batch if both the
+        /// ingester and the emitter implement batches natively.
+        ///
+        virtual bool has_native_batch(void) const { return false; }
+
+        /// Return the pool that ingest_record() recycles records from.
+        //
+        /// Ingesters that reuse records through a csv::RecordPool can
+        /// redefine this method to make the pool's hit and miss counters
+        /// available to the caller.
+        ///
+        /// @return The record pool used by the ingester.
+        /// @return NULL - The ingester does not use a record pool.
+        ///
+        virtual const csv::RecordPool* record_pool(void) const { return nullptr; }
+
+        /// Set the handler of records that cannot be parsed.
+        //
+        /// \a handler must outlive the ingester. Until a handler is
+        /// set, csv::ErrorHandler::fail() is used.
+        ///
+        void set_error_handler(csv::ErrorHandler& handler) { error_handler_ = &handler; }
+
+        /// Return the handler of records that cannot be parsed.
+        csv::ErrorHandler& error_handler(void) const;
+
+    private:
+        csv::ErrorHandler* error_handler_ { nullptr };
     };
 };
 #endif
@@ -0,0 +1,120 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ingestion_lines.hh"
+#include "csv_common.hh"
+#include "specification.hh"
+#include "record.hh"
+#include "record_batch.hh"
+#include "csv_error.hh"
+
+bool csv::IngestionLines::tokenize(const csv::Specification& specification)
+{
+    uint32_t field_count(0);
+
+    // Use the separator, escape, and quote char from the specification that
+    // is tied to the dataset.
+    //
+    fields_.clear();
+    if (tokenizer_) {
+        tokenizer_->reset(text_.data(), text_.data() + text_.length());
+        field_count = tokenizer_->next(fields_, buffer_, text_);
+    } else
+        field_count = csv::tokenize_line(text_,
+                                         specification.separator_char(),
+                                         specification.escape_char(),
+                                         fields_,
+                                         buffer_);
+
+    return check_field_count(specification, field_count);
+}
+
+bool csv::IngestionLines::check_field_count(const csv::Specification& specification,
+                                            uint32_t field_count)
+{
+    // Did we get the correct number of tokens?
+    //
+    if (field_count == specification.input_field_count())
+        return true;
+
+    error_handler().report(line_number_, csv::field_count_error(specification, field_count), text_);
+    return false;
+}
+
+bool csv::IngestionLines::accept(const csv::Specification& specification)
+{
+    if (specification.accept(fields_, error_))
+        return true;
+
+    // Lines that the filter could not be evaluated on are rejected.
+    if (!error_.empty())
+        error_handler().report(line_number_, error_, text_);
+    return false;
+}
+
+bool csv::IngestionLines::assign(csv::Record& record,
+                                 const csv::Specification& specification,
+                                 const std::size_t record_index)
+{
+    if (record.assign(specification, record_index, fields_, error_))
+        return true;
+
+    error_handler().report(line_number_, error_, text_);
+    return false;
+}
+
+bool csv::IngestionLines::append(csv::RecordBatch& batch)
+{
+    if (batch.append(fields_, error_))
+        return true;
+
+    error_handler().report(line_number_, error_, text_);
+    return false;
+}
+
+std::shared_ptr<csv::Record> csv::IngestionLines::ingest_record(std::istream& input,
+                                                                const csv::Specification& specification,
+                                                                const std::size_t record_index)
+{
+    while(next_line(input, specification)) {
+        // Skip lines rejected by the filter.
+        if (!accept(specification))
+            continue;
+
+        // Fill out a recycled record and return it.
+        // Records that cannot be converted go back to the pool.
+        //
+        auto record(pool_.acquire());
+        if (assign(*record, specification, record_index))
+            return record;
+    }
+    return NULL;
+}
+
+std::size_t csv::IngestionLines::ingest_batch(std::istream& input,
+                                              const csv::Specification& specification,
+                                              const std::size_t record_index,
+                                              csv::RecordBatch& batch)
+{
+    batch.clear();
+    batch.set_first_index(record_index);
+
+    // Parse the lines straight into the batch.
+    while(!batch.full() && next_line(input, specification))
+        if (accept(specification))
+            append(batch);
+
+    return batch.size();
+}
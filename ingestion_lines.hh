@@ -0,0 +1,173 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+//! \class IngestionLines
+//! Base class of ingesters that tokenize one record at a time
+//
+///
+//
+#ifndef __INGESTION_LINES__
+#define __INGESTION_LINES__
+
+#include "ingestion_iface.hh"
+#include "record_pool.hh"
+#include "csv_tokenizer.hh"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace csv {
+    /// Base class of ingesters that tokenize one record at a time.
+    //
+    /// Subclasses implement next_line(), which locates the next
+    /// record and tokenizes it into fields_. This class builds
+    /// records and batches from the tokens, recycles records through
+    /// a csv::RecordPool, and reports records that cannot be
+    /// converted to error_handler().
+    ///
+    class IngestionLines:
+        public IngestionIface {
+    public:
+        /// Read and parse a single record.
+        //
+        /// Records rejected by the specification's filter are skipped.
+        ///
+        /// @param input The input stream to read from.
+        /// @param specification The specification to use when parsing the CSV data.
+        /// @param record_index The  index of the current record (starting at 0).
+        ///
+        /// @return A shared pointer to a csv::Record, recycled from record_pool(),
+        ///         holding the parsed CSV data.
+        /// @return NULL input has reached an end.
+        ///
+        /// Lines that cannot be parsed are reported to error_handler() and skipped.
+        ///
+        std::shared_ptr<csv::Record> ingest_record(std::istream& input,
+                                                   const csv::Specification& specification,
+                                                   const std::size_t record_index) override;
+
+        /// Read and parse a batch of CSV lines.
+        //
+        /// Lines are parsed, with the same rules as ingest_record(),
+        /// directly into \a batch without creating any csv::Record objects.
+        ///
+        /// @param input The input stream to read and parse CSV lines from
+        /// @param specification The specification to use when parsing the CSV data.
+        /// @param record_index The index of the first record to read.
+        /// @param batch The batch to fill with records.
+        ///
+        /// @return The number of records in \a batch. 0 if \a input has reached its end.
+        ///
+        std::size_t ingest_batch(std::istream& input,
+                                 const csv::Specification& specification,
+                                 const std::size_t record_index,
+                                 csv::RecordBatch& batch) override;
+
+        /// Return true, since ingest_batch() is implemented natively.
+        bool has_native_batch(void) const override { return true; }
+
+        /// Return the pool that ingest_record() recycles records from.
+        const csv::RecordPool* record_pool(void) const override { return &pool_; }
+
+    protected:
+        /// Read and tokenize the next line into fields_.
+        //
+        /// Lines with the wrong number of fields are reported to
+        /// error_handler() and skipped.
+        ///
+        /// @return true - A line was tokenized.
+        /// @return false - The input has reached its end.
+        ///
+        virtual bool next_line(std::istream& input,
+                               const csv::Specification& specification) = 0;
+
+        /// Make \a text the current record, and advance the line number.
+        //
+        /// @param text The text of the record, without its newline.
+        /// @param multiline true if the record may hold quoted or escaped newlines.
+        ///
+        void start_record(std::string_view text, bool multiline) {
+            text_ = text;
+            line_number_ = next_line_number_;
+            next_line_number_ += multiline?csv::record_line_count(text):1;
+        }
+
+        /// Restart line numbering at the first line.
+        void reset_line_number(void) {
+            line_number_ = 0;
+            next_line_number_ = 1;
+        }
+
+        /// Tokenize the current record into fields_.
+        //
+        /// Uses tokenizer_ if the specification has a quote character,
+        /// else csv::tokenize_line().
+        ///
+        /// @return true - The record has the expected number of fields.
+        /// @return false - The record was reported to error_handler().
+        ///
+        bool tokenize(const csv::Specification& specification);
+
+        /// Check the number of fields of the current record.
+        //
+        /// @return true - \a field_count is the expected number of fields.
+        /// @return false - The record was reported to error_handler().
+        ///
+        bool check_field_count(const csv::Specification& specification,
+                               uint32_t field_count);
+
+        /// Field views of the current line, reused between records.
+        std::vector<std::string_view> fields_;
+
+        /// Unescaped field data of the current line, reused between records.
+        std::string buffer_;
+
+        /// The current line, as read from the input.
+        std::string_view text_;
+
+        /// Tokenizer of quoted fields, created if the specification has a quote character.
+        std::unique_ptr<csv::StructuralTokenizer> tokenizer_;
+
+    private:
+        /// Return true if the specification's filter accepts the current line.
+        //
+        /// Lines that the filter cannot be evaluated on are reported
+        /// to error_handler().
+        ///
+        bool accept(const csv::Specification& specification);
+
+        /// Convert the current line into a record, or report it to error_handler().
+        bool assign(csv::Record& record,
+                    const csv::Specification& specification,
+                    const std::size_t record_index);
+
+        /// Add the current line to a batch, or report it to error_handler().
+        bool append(csv::RecordBatch& batch);
+
+        /// The line number of the first line of the current record.
+        std::size_t line_number_ { 0 };
+
+        /// The line number of the first line of the next record.
+        std::size_t next_line_number_ { 1 };
+
+        /// Reason of the last failed conversion.
+        std::string error_;
+
+        /// Records returned by ingest_record(), reused once released.
+        RecordPool pool_;
+    };
+};
+#endif
@@ -0,0 +1,76 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "mapped_file.hh"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+csv::MappedFile::~MappedFile(void)
+{
+    close();
+}
+
+bool csv::MappedFile::open(const std::string& file_name)
+{
+    struct stat st;
+    int fd(-1);
+    void* addr(nullptr);
+
+    close();
+
+    fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    // mmap() does not accept zero length mappings.
+    if (st.st_size == 0) {
+        ::close(fd);
+        open_ = true;
+        return true;
+    }
+
+    addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+
+    if (addr == MAP_FAILED)
+        return false;
+
+    // We will walk the file front to back. Let the kernel read ahead.
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const char*>(addr);
+    size_ = st.st_size;
+    open_ = true;
+    return true;
+}
+
+void csv::MappedFile::close(void)
+{
+    if (data_)
+        munmap(const_cast<char*>(data_), size_);
+
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+}
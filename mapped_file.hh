@@ -0,0 +1,74 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __MAPPED_FILE_HH__
+#define __MAPPED_FILE_HH__
+#include <cstddef>
+#include <string>
+
+namespace csv {
+    /// A read-only memory mapping of an entire file.
+    //
+    /// Instances of this class map a complete file into memory
+    /// through mmap(), allowing its content to be parsed directly
+    /// without any read() calls or intermediate copies.
+    ///
+    /// The mapping is released when close() is called or when the
+    /// instance is destroyed.
+    ///
+    class MappedFile {
+    public:
+        /// Default constructor.
+        MappedFile(void) = default;
+
+        /// Destructor. Unmaps any mapped file.
+        ~MappedFile(void);
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /// Map a file into memory.
+        //
+        /// Any previously mapped file will be unmapped.
+        ///
+        /// An empty file is successfully opened, but will have
+        /// data() return NULL and size() return 0.
+        ///
+        /// @param file_name The path of the file to map.
+        ///
+        /// @return true - The file was mapped.
+        /// @return false - The file could not be opened or mapped.
+        ///
+        bool open(const std::string& file_name);
+
+        /// Unmap the file.
+        void close(void);
+
+        /// Return true if a file has been successfully opened.
+        bool is_open(void) const { return open_; }
+
+        /// Return a pointer to the first byte of the mapped file.
+        const char* data(void) const { return data_; }
+
+        /// Return the number of bytes in the mapped file.
+        std::size_t size(void) const { return size_; }
+
+    private:
+        const char* data_ { nullptr };
+        std::size_t size_ { 0 };
+        bool open_ { false };
+    };
+};
+#endif
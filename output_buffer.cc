@@ -0,0 +1,58 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "output_buffer.hh"
+#include "csv_stats.hh"
+
+void csv::OutputBuffer::set_capacity(std::size_t capacity)
+{
+    capacity_ = capacity;
+
+    // Leave some room for the record that pushes us over capacity,
+    // to avoid reallocating the buffer on every write out.
+    data_.reserve(capacity + capacity / 8);
+}
+
+bool csv::OutputBuffer::write(std::ostream& output)
+{
+    if (!data_.empty()) {
+        CSV_STATS_ADD(BYTES_WRITTEN, data_.length());
+        output.write(data_.data(), data_.length());
+        data_.clear();
+    }
+    return output.good();
+}
+
+bool csv::OutputBuffer::append(std::ostream& output, const std::string& text)
+{
+    if (text.length() < capacity_) {
+        data_.append(text);
+        return write_if_full(output);
+    }
+
+    if (!write(output))
+        return false;
+
+    CSV_STATS_ADD(BYTES_WRITTEN, text.length());
+    output.write(text.data(), text.length());
+    return output.good();
+}
+
+bool csv::OutputBuffer::flush(std::ostream& output)
+{
+    write(output);
+    output.flush();
+    return output.good();
+}
@@ -0,0 +1,105 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __OUTPUT_BUFFER_HH__
+#define __OUTPUT_BUFFER_HH__
+#include <cstddef>
+#include <string>
+#include <ostream>
+
+namespace csv {
+    /// A large contiguous buffer collecting emitter output.
+    //
+    /// Emitters append formatted records to data(), and call
+    /// write_if_full() after each record. Once capacity() bytes have
+    /// been collected, all buffered data is handed to the output
+    /// stream in a single write, which a std::ofstream passes on to
+    /// the operating system as one large write(2) call.
+    ///
+    /// Nothing is flushed per line or record. flush() is to be
+    /// called by the emitter's \c end() to write out any remaining data.
+    ///
+    class OutputBuffer {
+    public:
+        /// Default number of bytes to collect before writing to the output stream.
+        static constexpr std::size_t default_capacity = 1024*1024;
+
+        /// Constructor.
+        //
+        /// @param capacity The number of bytes to collect before writing them out.
+        ///
+        OutputBuffer(std::size_t capacity = default_capacity)
+        {
+            set_capacity(capacity);
+        }
+
+        /// Set the number of bytes to collect before writing them out.
+        void set_capacity(std::size_t capacity);
+
+        /// Return the number of bytes to collect before writing them out.
+        std::size_t capacity(void) const { return capacity_; }
+
+        /// Return the buffer that output is to be appended to.
+        std::string& data(void) { return data_; }
+
+        /// Write out the buffered data if capacity() has been reached.
+        //
+        /// @param output The stream to write to.
+        ///
+        /// @return true - No write was needed, or the data was successfully written.
+        /// @return false - The data could not be written to \a output.
+        ///
+        bool write_if_full(std::ostream& output) {
+            return data_.length() < capacity_ || write(output);
+        }
+
+        /// Add formatted text, such as a batch formatted by another thread.
+        //
+        /// Text shorter than capacity() is appended to the buffer.
+        /// Longer text is written to \a output right after the
+        /// buffered data, without being copied into the buffer.
+        ///
+        /// @param output The stream to write to.
+        /// @param text The text to add.
+        ///
+        /// @return true - The text was buffered or successfully written.
+        /// @return false - The data could not be written to \a output.
+        ///
+        bool append(std::ostream& output, const std::string& text);
+
+        /// Write out all buffered data.
+        //
+        /// @param output The stream to write to.
+        ///
+        /// @return true - The data was successfully written.
+        /// @return false - The data could not be written to \a output.
+        ///
+        bool write(std::ostream& output);
+
+        /// Write out all buffered data and flush \a output.
+        //
+        /// @param output The stream to write to and flush.
+        ///
+        /// @return true - The data was successfully written and flushed.
+        /// @return false - The data could not be written to \a output.
+        ///
+        bool flush(std::ostream& output);
+
+    private:
+        std::string data_;
+        std::size_t capacity_ { 0 };
+    };
+};
+#endif
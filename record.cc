@@ -14,77 +14,84 @@
 //
 
 #include "record.hh"
+#include "csv_common.hh"
+#include "csv_stats.hh"
+#include "csv_error.hh"
 #include <iostream>
 #include <stdlib.h>
-//
-// Helper function. Not visible to the outside.
-//
-static std::string strip_whitespaces(const std::string& str)
+csv::Record::Record(const Specification& specification,
+                    const std::size_t index,
+                    const std::vector<std::string_view>& tokens)
 {
-    // Strip out leading and trailing white spaces
-    std::size_t first_char = str.find_first_not_of (" \t", 0);
-    std::size_t last_char = str.find_last_not_of(" \t", std::string::npos);
-
-    // Calculate number of bytes to copy. Bear in mind that first_char and
-    // last_char may be std::string::npos, which needs conversion
-
-    first_char = (first_char == std::string::npos)?0:first_char;
-    last_char = (last_char == std::string::npos)?str.length():(last_char + 1);
-    std::size_t copy_len =  last_char - first_char;
-    std::string res { str.substr(first_char, copy_len) };
+    std::string error;
 
-//    std::cout << "Before [" << str << "] After [" << res << "]" << std::endl;
-    return res;
+    CSV_STATS_ADD(RECORD_ALLOCATIONS, 1);
+    if (!assign(specification, index, tokens, error)) {
+        std::cout << error << std::endl;
+        exit(255);
+    }
 }
 
-csv::Record::Record(const Specification& specification,
-                    const std::size_t index,
-                    const std::vector<std::string>& tokens):
-    index_(index)
+bool csv::Record::assign(const Specification& specification,
+                         const std::size_t index,
+                         const std::vector<std::string_view>& tokens,
+                         std::string& error)
 {
     auto field_iter(specification.fields().begin());
+    uint32_t type_fields[3] = { 0, 0, 0 };
+    CSV_STATS_TIME_SAMPLED(PARSE);
 
-    // We will assume that specification.data_types().size() == tokens.size()
+    index_ = index;
+
+    // Keep existing field values, and their storage, for reuse.
+    fields_.resize(specification.fields().size());
+    auto value_iter(fields_.begin());
+
+    // We will assume that specification.input_field_count() == tokens.size()
     // We will assume that the token length is non-zero.
-    for(const auto& t: tokens) {
-        switch(field_iter->type_) {
-        case csv::FieldType::INT64: {
-            std::string data { strip_whitespaces(t) };
-            char* endptr = 0;
-            int64_t val =  strtoll(data.c_str(), &endptr, 0);
-            if (*endptr) {
-                std::cout << "Token for field " << field_iter->name_ << ": " << data << " is not an integer." << std::endl;
-                exit(255);
-            }
-            fields_.push_back(val);
-            break;
+    // Tokens of fields not in the projection are never looked at.
+    for(uint32_t token_index: specification.projection()) {
+        const std::string_view& t(tokens[token_index]);
+
+        // Convert with the parse function planned for the field type.
+        if (!field_iter->parse_(t, *value_iter)) {
+            error = csv::field_value_error(*field_iter, t);
+            return false;
         }
+        ++type_fields[int(field_iter->type_)];
+        field_iter++;
+        value_iter++;
+    }
 
+    CSV_STATS_ADD(INT64_FIELDS, type_fields[int(csv::FieldType::INT64)]);
+    CSV_STATS_ADD(DOUBLE_FIELDS, type_fields[int(csv::FieldType::DOUBLE)]);
+    CSV_STATS_ADD(STRING_FIELDS, type_fields[int(csv::FieldType::STRING)]);
+    return true;
+}
 
-        case csv::FieldType::DOUBLE: {
-            char* endptr = 0;
-            std::string data { strip_whitespaces(t) };
+csv::Record::Record(const Specification& specification,
+                    const RecordBatch::Row& row):
+    index_(row.index())
+{
+    std::size_t field_index(0);
 
-            double val =  strtod(data.c_str(), &endptr);
-            if (*endptr) {
-                std::cout << "Token for field " << field_iter->name_ << ": " << data << " is not a double." << std::endl;
-                exit(255);
-            }
+    CSV_STATS_ADD(RECORD_ALLOCATIONS, 1);
+    fields_.reserve(specification.fields().size());
 
-            fields_.push_back(val);
+    for(const auto& field: specification.fields()) {
+        switch(field.type_) {
+        case csv::FieldType::INT64:
+            fields_.push_back(row.int64_value(field_index));
             break;
-        }
 
-        case csv::FieldType::STRING: 
-            fields_.push_back(t);
+        case csv::FieldType::DOUBLE:
+            fields_.push_back(row.double_value(field_index));
             break;
 
-
-        default:
-            std::cout << "Unknown data type: " << int(field_iter->type_)  << std::endl;
-            exit(255);
+        case csv::FieldType::STRING:
+            fields_.emplace_back(std::in_place_type<std::string>, row.string_value(field_index));
+            break;
         }
-        field_iter++;
+        ++field_index;
     }
 }
-
@@ -18,12 +18,15 @@
 //
 /// This class hosts a single CSV record, as provided by a ReaderIface
 /// implementation.
-//  Once constructed, an instance is immutable.
+//  Once constructed, an instance is immutable, unless it is
+//  reused through assign() by its csv::RecordPool.
 //
 #ifndef __RECORD_HH__
 #define __RECORD_HH__
 #include "specification.hh"
+#include "record_batch.hh"
 #include <variant>
+#include <string_view>
 #include <memory>
 #include <list>
 #include "emitter_iface.hh"
@@ -34,21 +37,110 @@
 namespace csv {
     class Record {
     public:
+        /// Construct a record from tokenized field data.
+        //
+        /// Each token is converted to the data type of the
+        /// corresponding field in specification.fields().
+        ///
+        /// \a tokens holds one token per field in
+        /// specification.input_fields(). Only the tokens selected by
+        /// specification.projection() are converted and stored.
+        ///
+        /// The program exits if a token is not a valid value of its
+        /// field. Use assign() to handle invalid values.
+        ///
+        /// @param specification The specification of the record.
+        /// @param index The index of the record.
+        /// @param tokens The field data, as returned by csv::tokenize_line().
+        ///
         Record(const Specification& specification,
                std::size_t index,
-               const std::vector<std::string>& tokens);
+               const std::vector<std::string_view>& tokens);
+
+        /// Construct a record from a row in a csv::RecordBatch.
+        //
+        /// The record will be a copy of the data and index of \a row.
+        ///
+        /// @param specification The specification of the record.
+        /// @param row The batch row to copy.
+        ///
+        Record(const Specification& specification,
+               const RecordBatch::Row& row);
+
+        /// Replace the content of the record with new tokenized field data.
+        //
+        /// Parses \a tokens with the same rules as the constructor. The
+        /// storage of the existing fields, including the capacity of
+        /// string fields, is reused, so that a record assigned
+        /// records of the same specification over and over again will,
+        /// once grown, not need any further heap allocations.
+        ///
+        /// @param specification The specification of the record.
+        /// @param index The index of the record.
+        /// @param tokens The field data, as returned by csv::tokenize_line().
+        /// @param error Set to the reason if a token could not be converted.
+        ///
+        /// @return true - All tokens were converted.
+        /// @return false - A token is not a valid value of its field. The record is
+        ///                 to be discarded.
+        ///
+        bool assign(const Specification& specification,
+                    std::size_t index,
+                    const std::vector<std::string_view>& tokens,
+                    std::string& error);
 
         /// Retrieve a single field. Throw an exception on type mismatch.
         template<typename T>
-        const T& field(int field_index) const { std::get<T>(fields_[field_index]); }
+        const T& field(int field_index) const { return std::get<T>(fields_[field_index]); }
+
+        const std::vector<csv::FieldValue>& fields(void) const { return fields_; };
+
+        /// Return the value of a csv::FieldType::INT64 field.
+        //
+        /// Provided, together with double_value() and string_value(),
+        /// with the same signature as csv::RecordBatch::Row so that
+        /// code can be written once for both records and batch rows.
+        ///
+        int64_t int64_value(std::size_t field_index) const { return std::get<int64_t>(fields_[field_index]); }
 
-        const std::vector<std::variant<int64_t, double, std::string> >& fields(void) const { return fields_; };
+        /// Return the value of a csv::FieldType::DOUBLE field.
+        double double_value(std::size_t field_index) const { return std::get<double>(fields_[field_index]); }
+
+        /// Return the value of a csv::FieldType::STRING field.
+        std::string_view string_value(std::size_t field_index) const { return std::get<std::string>(fields_[field_index]); }
 
         const std::size_t index() const { return index_; }
 
     private:
-        std::vector<std::variant<int64_t, double, std::string> > fields_;
-        std::size_t index_;
+        friend class RecordPool;
+
+        /// Construct an empty record. Used by csv::RecordPool.
+        Record(void) = default;
+
+        std::vector<csv::FieldValue> fields_;
+        std::size_t index_ { 0 };
     };
+
+    /// Append the formatted value of a field of a record.
+    //
+    /// Formats the value with the function planned for the field
+    /// by csv::Specification, without selecting on the field type.
+    /// Provided, together with the csv::RecordBatch::Row overload,
+    /// for emitters written once for both records and batch rows.
+    ///
+    /// @param output The string to append to.
+    /// @param field The specification of the field.
+    /// @param record The record holding the field.
+    /// @param index The index of the field in \a record.
+    /// @param escaper The escaper of string values, see Specification::escaper().
+    ///
+    inline void append_value(std::string& output,
+                             const Specification::Field& field,
+                             const Record& record,
+                             std::size_t index,
+                             const Escaper& escaper)
+    {
+        field.append_(output, record.fields()[index], escaper);
+    }
 };
 #endif
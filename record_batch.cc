@@ -0,0 +1,197 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "record_batch.hh"
+#include "record.hh"
+#include "csv_common.hh"
+#include "csv_stats.hh"
+#include "csv_error.hh"
+#include <iostream>
+#include <algorithm>
+
+csv::RecordBatch::RecordBatch(const Specification& specification,
+                              std::size_t capacity):
+    specification_(&specification),
+    columns_(specification.fields().size()),
+    capacity_(capacity)
+{
+    auto column_iter(columns_.begin());
+
+    for(const auto& field: specification.fields()) {
+        column_iter->type_ = field.type_;
+
+        switch(field.type_) {
+        case csv::FieldType::INT64:
+            column_iter->int64_.reserve(capacity);
+            break;
+
+        case csv::FieldType::DOUBLE:
+            column_iter->double_.reserve(capacity);
+            break;
+
+        case csv::FieldType::STRING:
+            column_iter->offsets_.reserve(capacity + 1);
+            column_iter->offsets_.push_back(0);
+            break;
+        }
+        ++column_iter;
+    }
+}
+
+void csv::RecordBatch::clear(void)
+{
+    for(auto& column: columns_) {
+        column.int64_.clear();
+        column.double_.clear();
+        column.bytes_.clear();
+
+        if (column.type_ == csv::FieldType::STRING) {
+            column.offsets_.clear();
+            column.offsets_.push_back(0);
+        }
+    }
+    size_ = 0;
+}
+
+void csv::RecordBatch::discard_partial(void)
+{
+    for(auto& column: columns_) {
+        column.int64_.resize(std::min(column.int64_.size(), size_));
+        column.double_.resize(std::min(column.double_.size(), size_));
+
+        if (column.type_ == csv::FieldType::STRING) {
+            column.offsets_.resize(size_ + 1);
+            column.bytes_.resize(column.offsets_.back());
+        }
+    }
+}
+
+bool csv::RecordBatch::append(const std::vector<std::string_view>& tokens,
+                              std::string& error)
+{
+    auto field_iter(specification_->fields().begin());
+    auto column_iter(columns_.begin());
+    uint32_t int64_fields(0);
+    uint32_t double_fields(0);
+    uint32_t string_fields(0);
+    CSV_STATS_TIME_SAMPLED(PARSE);
+
+    // We will assume that tokens.size() == specification_->input_field_count()
+    // Tokens of fields not in the projection are never looked at.
+    for(uint32_t token_index: specification_->projection()) {
+        const std::string_view& t(tokens[token_index]);
+
+        switch(column_iter->type_) {
+        case csv::FieldType::INT64: {
+            int64_t val(0);
+            if (!csv::parse_int64(t, val)) {
+                error = csv::field_value_error(*field_iter, t);
+                discard_partial();
+                return false;
+            }
+            column_iter->int64_.push_back(val);
+            ++int64_fields;
+            break;
+        }
+
+        case csv::FieldType::DOUBLE: {
+            double val(0.0);
+            if (!csv::parse_double(t, val)) {
+                error = csv::field_value_error(*field_iter, t);
+                discard_partial();
+                return false;
+            }
+            column_iter->double_.push_back(val);
+            ++double_fields;
+            break;
+        }
+
+        case csv::FieldType::STRING:
+            column_iter->bytes_.append(t);
+            column_iter->offsets_.push_back(column_iter->bytes_.length());
+            ++string_fields;
+            break;
+
+        default:
+            std::cout << "Unknown data type: " << int(column_iter->type_)  << std::endl;
+            exit(255);
+        }
+        ++field_iter;
+        ++column_iter;
+    }
+    ++size_;
+
+    CSV_STATS_ADD(INT64_FIELDS, int64_fields);
+    CSV_STATS_ADD(DOUBLE_FIELDS, double_fields);
+    CSV_STATS_ADD(STRING_FIELDS, string_fields);
+    return true;
+}
+
+void csv::RecordBatch::append(const Record& record)
+{
+    auto column_iter(columns_.begin());
+
+    for(const auto& field: record.fields()) {
+        switch(column_iter->type_) {
+        case csv::FieldType::INT64:
+            column_iter->int64_.push_back(std::get<int64_t>(field));
+            break;
+
+        case csv::FieldType::DOUBLE:
+            column_iter->double_.push_back(std::get<double>(field));
+            break;
+
+        case csv::FieldType::STRING:
+            column_iter->bytes_.append(std::get<std::string>(field));
+            column_iter->offsets_.push_back(column_iter->bytes_.length());
+            break;
+        }
+        ++column_iter;
+    }
+
+    // Records appended to an empty batch set the index of the batch.
+    if (!size_)
+        first_index_ = record.index();
+
+    ++size_;
+}
+
+void csv::RecordBatch::append(const Row& row)
+{
+    std::size_t field_index(0);
+
+    for(auto& column: columns_) {
+        switch(column.type_) {
+        case csv::FieldType::INT64:
+            column.int64_.push_back(row.int64_value(field_index));
+            break;
+
+        case csv::FieldType::DOUBLE:
+            column.double_.push_back(row.double_value(field_index));
+            break;
+
+        case csv::FieldType::STRING:
+            column.bytes_.append(row.string_value(field_index));
+            column.offsets_.push_back(column.bytes_.length());
+            break;
+        }
+        ++field_index;
+    }
+
+    if (!size_)
+        first_index_ = row.index();
+
+    ++size_;
+}
@@ -0,0 +1,205 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __RECORD_BATCH_HH__
+#define __RECORD_BATCH_HH__
+#include "specification.hh"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace csv {
+    class Record;
+
+    /// A batch of records stored column by column.
+    //
+    /// Instances of this class hold up to capacity() records with the
+    /// layout given by Specification::fields(). Instead of storing a
+    /// variant per field, each field is stored in its own column:
+    ///
+    ///   - csv::FieldType::INT64 fields in a contiguous \c int64_t array.
+    ///   - csv::FieldType::DOUBLE fields in a contiguous \c double array.
+    ///   - csv::FieldType::STRING fields as an array of offsets into a
+    ///     single byte arena holding the string data of all rows.
+    ///
+    /// clear() empties the batch without releasing any memory, so
+    /// that a batch reused for many records will, once grown, not
+    /// need any further heap allocations.
+    ///
+    /// Individual records are accessed through the light weight
+    /// RecordBatch::Row view returned by row().
+    ///
+    class RecordBatch {
+    public:
+        /// Default number of records that a batch is sized for.
+        static constexpr std::size_t default_capacity = 4096;
+
+        /// A read-only view of a single record in a batch.
+        //
+        /// The view is valid until the batch it was retrieved from
+        /// is modified or destroyed.
+        ///
+        class Row {
+        public:
+            Row(const RecordBatch& batch, std::size_t row):
+                batch_(&batch),
+                row_(row)
+            {}
+
+            /// Return the index of the record.
+            std::size_t index(void) const { return batch_->first_index_ + row_; }
+
+            /// Return the batch that the record is stored in.
+            const RecordBatch& batch(void) const { return *batch_; }
+
+            /// Return the position of the record in batch().
+            std::size_t position(void) const { return row_; }
+
+            /// Return the value of a csv::FieldType::INT64 field.
+            int64_t int64_value(std::size_t field) const { return batch_->columns_[field].int64_[row_]; }
+
+            /// Return the value of a csv::FieldType::DOUBLE field.
+            double double_value(std::size_t field) const { return batch_->columns_[field].double_[row_]; }
+
+            /// Return the value of a csv::FieldType::STRING field.
+            std::string_view string_value(std::size_t field) const {
+                const Column& column(batch_->columns_[field]);
+
+                return std::string_view(column.bytes_.data() + column.offsets_[row_],
+                                        column.offsets_[row_ + 1] - column.offsets_[row_]);
+            }
+
+        private:
+            const RecordBatch* batch_;
+            std::size_t row_;
+        };
+
+        /// Constructor.
+        //
+        /// Sets up one column for each field in specification.fields(),
+        /// with storage reserved for \a capacity records.
+        ///
+        /// @param specification The specification of the records to store.
+        /// @param capacity The number of records that the batch holds when full().
+        ///
+        RecordBatch(const Specification& specification,
+                    std::size_t capacity = default_capacity);
+
+        /// Remove all records, retaining allocated memory.
+        void clear(void);
+
+        /// Parse and add a record.
+        //
+        /// Each token is converted to the data type of the
+        /// corresponding field, with the same rules as
+        /// csv::Record::Record(). Tokens of fields not in the
+        /// projection of the specification are skipped.
+        ///
+        /// If a token is not a valid value of its field, the batch is
+        /// left as it was before the call.
+        ///
+        /// @param tokens The field data, as returned by csv::tokenize_line().
+        /// @param error Set to the reason if a token could not be converted.
+        ///
+        /// @return true - The record was added.
+        /// @return false - A token is not a valid value of its field.
+        ///
+        bool append(const std::vector<std::string_view>& tokens,
+                    std::string& error);
+
+        /// Add a copy of a record.
+        void append(const Record& record);
+
+        /// Add a copy of a record stored in another batch.
+        //
+        /// The batch of \a row must have the same specification.
+        ///
+        void append(const Row& row);
+
+        /// Return a view of the record at position \a row.
+        Row row(std::size_t row) const { return Row(*this, row); }
+
+        /// Return the number of records in the batch.
+        std::size_t size(void) const { return size_; }
+
+        /// Return the number of records the batch is sized for.
+        std::size_t capacity(void) const { return capacity_; }
+
+        /// Return true if the batch holds no records.
+        bool empty(void) const { return size_ == 0; }
+
+        /// Return true if the batch holds capacity() or more records.
+        bool full(void) const { return size_ >= capacity_; }
+
+        /// Return the index of the first record in the batch.
+        std::size_t first_index(void) const { return first_index_; }
+
+        /// Set the index of the first record in the batch.
+        //
+        /// The remaining records are indexed consecutively after it.
+        ///
+        void set_first_index(std::size_t index) { first_index_ = index; }
+
+        /// Return the specification of the stored records.
+        const Specification& specification(void) const { return *specification_; }
+
+    private:
+        /// Storage of a single field for all records in the batch.
+        //
+        /// Only the members matching type_ are used.
+        ///
+        struct Column {
+            FieldType type_;
+
+            /// csv::FieldType::INT64 values.
+            std::vector<int64_t> int64_;
+
+            /// csv::FieldType::DOUBLE values.
+            std::vector<double> double_;
+
+            /// csv::FieldType::STRING start offsets into bytes_.
+            /// Holds size() + 1 elements, with the last one being
+            /// the end of the last string.
+            std::vector<std::size_t> offsets_;
+
+            /// csv::FieldType::STRING data of all records.
+            std::string bytes_;
+        };
+
+        /// Remove the values appended to columns after the last record.
+        void discard_partial(void);
+
+        const Specification* specification_;
+        std::vector<Column> columns_;
+        std::size_t capacity_;
+        std::size_t size_ { 0 };
+        std::size_t first_index_ { 0 };
+    };
+
+    /// Append the formatted value of a field of a batch row.
+    //
+    /// See csv::append_value(std::string&, const Specification::Field&, const Record&, std::size_t, const Escaper&).
+    ///
+    inline void append_value(std::string& output,
+                             const Specification::Field& field,
+                             const RecordBatch::Row& row,
+                             std::size_t index,
+                             const Escaper& escaper)
+    {
+        field.append_batch_(output, row.batch(), row.position(), index, escaper);
+    }
+};
+#endif
@@ -0,0 +1,51 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "record_pool.hh"
+#include "record.hh"
+#include "csv_stats.hh"
+#include <atomic>
+
+std::shared_ptr<csv::Record> csv::RecordPool::acquire(void)
+{
+    // Search for a record only referenced by us, starting with the
+    // one after the last record handed out. Records are usually released
+    // in the order they were acquired, so the first probe will normally hit.
+    for(std::size_t i = 0; i < records_.size(); ++i) {
+        std::shared_ptr<Record>& record(records_[next_]);
+
+        next_ = (next_ + 1 == records_.size())?0:(next_ + 1);
+
+        if (record.use_count() == 1) {
+            // use_count() is a relaxed load. Order the accesses made
+            // by the thread that released the record before ours.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            CSV_STATS_ADD(POOL_HITS, 1);
+            ++hits_;
+            return record;
+        }
+    }
+
+    // All records are in use. Create a new one.
+    CSV_STATS_ADD(POOL_MISSES, 1);
+    ++misses_;
+    std::shared_ptr<Record> record(new Record());
+    CSV_STATS_ADD(RECORD_ALLOCATIONS, 1);
+
+    if (records_.size() < max_size_)
+        records_.push_back(record);
+
+    return record;
+}
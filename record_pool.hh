@@ -0,0 +1,89 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __RECORD_POOL_HH__
+#define __RECORD_POOL_HH__
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace csv {
+    class Record;
+
+    /// A pool of recycled csv::Record objects.
+    //
+    /// Ingesters return records as shared pointers, which are
+    /// normally released by the caller right after the record has
+    /// been emitted. Instead of allocating a new record, and a new
+    /// shared pointer control block, for each ingested line, an
+    /// ingester can acquire() a record from a pool and fill it
+    /// out with Record::assign().
+    ///
+    /// The pool keeps a shared pointer to each of its records. A
+    /// record is free for reuse once the pool holds the only
+    /// reference to it, i.e. when all callers have released it.
+    ///
+    /// A pool is not thread safe, but records acquired from it
+    /// may be released from any thread. acquire() issues an acquire
+    /// fence before reusing a record, so that the releasing thread's
+    /// accesses to it happen before the record is filled out again.
+    ///
+    class RecordPool {
+    public:
+        /// Default maximum number of records kept by a pool.
+        static constexpr std::size_t default_max_size = 64;
+
+        /// Constructor.
+        //
+        /// @param max_size The maximum number of records to keep for reuse.
+        ///
+        RecordPool(std::size_t max_size = default_max_size):
+            max_size_(max_size)
+        {}
+
+        /// Acquire a record.
+        //
+        /// Returns a record that is no longer referenced outside
+        /// the pool. If no such record exists, a new record is
+        /// created and, if the pool has not reached its maximum size,
+        /// kept for later reuse.
+        ///
+        /// The returned record holds the data it was last assigned,
+        /// and is to be filled out by a Record::assign() call.
+        ///
+        /// @return A record that is not referenced by anyone else.
+        ///
+        std::shared_ptr<Record> acquire(void);
+
+        /// Return the number of acquire() calls that reused a record.
+        //
+        /// The hits and misses of all pools are also counted in
+        /// csv::stats::Counter::POOL_HITS and POOL_MISSES, and
+        /// reported by csv_convert --stats.
+        ///
+        uint64_t hits(void) const { return hits_; }
+
+        /// Return the number of acquire() calls that created a new record.
+        uint64_t misses(void) const { return misses_; }
+
+    private:
+        std::vector<std::shared_ptr<Record> > records_;
+        std::size_t max_size_;
+        std::size_t next_ { 0 };
+        uint64_t hits_ { 0 };
+        uint64_t misses_ { 0 };
+    };
+};
+#endif
@@ -14,7 +14,14 @@
 //
 
 #include "specification.hh"
+#include "filter.hh"
+#include "csv_stats.hh"
+#include "csv_common.hh"
+#include "csv_format.hh"
+#include "record_batch.hh"
 #include <iostream>
+#include <algorithm>
+#include <cctype>
 
 
 std::map<std::string, csv::FieldType> csv::Specification::enum_string_map_ = {
@@ -28,10 +35,13 @@ std::map<std::string, csv::FieldType> csv::Specification::enum_string_map_ = {
 
 csv::Specification::Specification(const std::vector<std::tuple<std::string, std::string> >& spec,
                                   const char separator_char,
-                                  const char escape_char):
+                                  const char escape_char,
+                                  const std::vector<std::string>& projection,
+                                  const std::string& filter,
+                                  const char quote_char):
     separator_char_(separator_char),
     escape_char_(escape_char),
-    field_count_(spec.size())
+    quote_char_(quote_char)
 {
     for(auto t: spec) {
         // Did we have a correct type?
@@ -41,6 +51,238 @@ csv::Specification::Specification(const std::vector<std::tuple<std::string, std:
         }
 
         // Add field name
-        fields_.push_back({std::get<0>(t), enum_string_map_[std::get<1>(t)]});
+        input_fields_.push_back({std::get<0>(t), enum_string_map_[std::get<1>(t)]});
+    }
+
+    // Without a projection, all fields are emitted.
+    if (projection.empty()) {
+        for(uint32_t index = 0; index < input_fields_.size(); ++index)
+            projection_.push_back(index);
+    }
+
+    for(const auto& name: projection) {
+        auto field_iter(std::find_if(input_fields_.begin(), input_fields_.end(),
+                                     [&](const Field& field) { return field.name_ == name; }));
+
+        if (field_iter == input_fields_.end()) {
+            std::cout << "Projected field not specified: " << name << std::endl;
+            exit(255);
+        }
+        projection_.push_back(field_iter - input_fields_.begin());
+    }
+
+    for(auto& field: input_fields_)
+        plan_field(field);
+
+    for(uint32_t index: projection_)
+        fields_.push_back(input_fields_[index]);
+
+    field_count_ = fields_.size();
+    plan_output();
+
+    if (!filter.empty())
+        filter_ = std::make_shared<const csv::Filter>(*this, filter);
+}
+
+bool csv::Specification::filter_match(const std::vector<std::string_view>& tokens, std::string& error) const
+{
+    if (filter_->match(tokens, error))
+        return true;
+
+    // Lines that could not be matched are counted as rejected.
+    if (error.empty())
+        CSV_STATS_ADD(RECORDS_FILTERED, 1);
+    return false;
+}
+
+//
+// Parse and format functions of each field type, referenced
+// by the plan of each field.
+//
+namespace {
+    bool parse_int64_value(std::string_view token, csv::FieldValue& value)
+    {
+        int64_t val(0);
+
+        if (!csv::parse_int64(token, val))
+            return false;
+
+        value = val;
+        return true;
+    }
+
+    bool parse_double_value(std::string_view token, csv::FieldValue& value)
+    {
+        double val(0.0);
+
+        if (!csv::parse_double(token, val))
+            return false;
+
+        value = val;
+        return true;
+    }
+
+    bool parse_string_value(std::string_view token, csv::FieldValue& value)
+    {
+        // Assign to an existing string to reuse its capacity.
+        if (auto str = std::get_if<std::string>(&value))
+            str->assign(token);
+        else
+            value.emplace<std::string>(token);
+
+        return true;
+    }
+
+    void append_int64_value(std::string& output, const csv::FieldValue& value,
+                            const csv::Escaper& escaper)
+    {
+        csv::append_int64(output, std::get<int64_t>(value));
+    }
+
+    void append_double_value(std::string& output, const csv::FieldValue& value,
+                             const csv::Escaper& escaper)
+    {
+        csv::append_double(output, std::get<double>(value));
+    }
+
+    void append_string_value(std::string& output, const csv::FieldValue& value,
+                             const csv::Escaper& escaper)
+    {
+        escaper.append(output, std::get<std::string>(value));
+    }
+
+    void append_int64_batch(std::string& output, const csv::RecordBatch& batch,
+                            std::size_t row, std::size_t field,
+                            const csv::Escaper& escaper)
+    {
+        csv::append_int64(output, batch.row(row).int64_value(field));
+    }
+
+    void append_double_batch(std::string& output, const csv::RecordBatch& batch,
+                             std::size_t row, std::size_t field,
+                            const csv::Escaper& escaper)
+    {
+        csv::append_double(output, batch.row(row).double_value(field));
+    }
+
+    void append_string_batch(std::string& output, const csv::RecordBatch& batch,
+                             std::size_t row, std::size_t field,
+                            const csv::Escaper& escaper)
+    {
+        escaper.append(output, batch.row(row).string_value(field));
+    }
+}
+
+void csv::Specification::plan_field(Field& field)
+{
+    switch(field.type_) {
+    case csv::FieldType::INT64:
+        field.parse_ = parse_int64_value;
+        field.append_ = append_int64_value;
+        field.append_batch_ = append_int64_batch;
+        break;
+
+    case csv::FieldType::DOUBLE:
+        field.parse_ = parse_double_value;
+        field.append_ = append_double_value;
+        field.append_batch_ = append_double_batch;
+        break;
+
+    case csv::FieldType::STRING:
+        field.parse_ = parse_string_value;
+        field.append_ = append_string_value;
+        field.append_batch_ = append_string_batch;
+        break;
+    }
+}
+
+//
+// The emitters write a record as the record prefix, followed by
+// the value and the text after it of each field. The text
+// between two values combines the end of one field, such as a
+// closing quote, with the start of the next, such as its name.
+//
+//
+// Return true if a field name can be written as a plain YAML key.
+// Names starting with anything but a letter, digit, or underscore,
+// ending with a space, or holding anything but those, spaces,
+// dashes, and dots, may be read as YAML syntax, and are quoted.
+//
+static bool yaml_plain_name(const std::string& name)
+{
+    if (name.empty() || name.back() == ' ' ||
+        !(std::isalnum(uint8_t(name.front())) || name.front() == '_'))
+        return false;
+
+    for(char c: name)
+        if (!(std::isalnum(uint8_t(c)) || c == '_' || c == ' ' || c == '-' || c == '.'))
+            return false;
+
+    return true;
+}
+
+void csv::Specification::plan_output(void)
+{
+    static const std::string record_end[] = { "\n", "}\n", "\n", "}\n" };
+    std::string prefix[std::size_t(TextFormat::COUNT)];
+
+    escaper_[std::size_t(TextFormat::CSV)] = Escaper(Escaper::Style::PREFIX, escape_char_, separator_char_, quote_char_);
+    escaper_[std::size_t(TextFormat::JSON)] = Escaper(Escaper::Style::BACKSLASH);
+    escaper_[std::size_t(TextFormat::YAML)] = Escaper(Escaper::Style::BACKSLASH);
+    escaper_[std::size_t(TextFormat::JSONL)] = Escaper(Escaper::Style::BACKSLASH);
+
+    // JSON objects start with a brace, after a comma separating
+    // them from the previous object that the emitter writes.
+    prefix[std::size_t(TextFormat::JSON)] = "{\n";
+    prefix[std::size_t(TextFormat::JSONL)] = "{";
+
+    for(std::size_t index = 0; index <= fields_.size(); ++index) {
+        Field* previous(index?&fields_[index - 1]:nullptr);
+        std::string quote(previous && previous->type_ == csv::FieldType::STRING?"\"":"");
+
+        // Close the previous field.
+        if (previous) {
+            prefix[std::size_t(TextFormat::CSV)].clear();
+            prefix[std::size_t(TextFormat::JSON)] = quote + ((index == fields_.size())?"\n":",\n");
+            prefix[std::size_t(TextFormat::YAML)] = quote + "\n";
+            prefix[std::size_t(TextFormat::JSONL)] = quote + ((index == fields_.size())?"":",");
+        }
+
+        if (index == fields_.size()) {
+            for(std::size_t format = 0; format < std::size_t(TextFormat::COUNT); ++format)
+                prefix[format] += record_end[format];
+        } else {
+            const Field& field(fields_[index]);
+            std::string name;
+
+            quote = (field.type_ == csv::FieldType::STRING)?"\"":"";
+
+            // Names are escaped like string values.
+            escaper_[std::size_t(TextFormat::JSON)].append(name, field.name_);
+
+            // <value-1>,<value-2>,...<value-N>
+            if (index)
+                prefix[std::size_t(TextFormat::CSV)] = std::string(1, separator_char_);
+
+            //     "<name>": <value>,
+            prefix[std::size_t(TextFormat::JSON)] += "    \"" + name + "\": " + quote;
+
+            // - <name>: <value>
+            //   <name>: <value>
+            // Names that could be read as YAML syntax are double quoted.
+            prefix[std::size_t(TextFormat::YAML)] += (index?"  ":"- ") +
+                (yaml_plain_name(field.name_)?name:"\"" + name + "\"") + ": " + quote;
+
+            // {"<name>":<value>,...}
+            prefix[std::size_t(TextFormat::JSONL)] += "\"" + name + "\":" + quote;
+        }
+
+        // The text leading up to this value follows the previous one.
+        for(std::size_t format = 0; format < std::size_t(TextFormat::COUNT); ++format) {
+            if (previous)
+                previous->after_[format] = prefix[format];
+            else
+                record_prefix_[format] = prefix[format];
+        }
     }
 }
@@ -27,8 +27,15 @@
 #include <vector>
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <string_view>
+#include <variant>
+#include "csv_escape.hh"
 
 namespace csv {
+    class Filter;
+    class RecordBatch;
+
     /// An enum with all supported data types for a single field.
     //
     /// This is used by Specification::Field::type_ to specify the
@@ -38,6 +45,18 @@ namespace csv {
         INT64, DOUBLE, STRING
     };
 
+    /// The value of a single field, as stored in a csv::Record.
+    using FieldValue = std::variant<int64_t, double, std::string>;
+
+    /// Text formats written by the emitters.
+    //
+    /// Used to index the output fragments precomputed for each
+    /// field in Specification::Field.
+    ///
+    enum class TextFormat {
+        CSV, JSON, YAML, JSONL, COUNT
+    };
+
     /// A specification for record formats.
     //
     /// Instances of this class hosts information about the
@@ -54,7 +73,18 @@ namespace csv {
     public:
         /// A single field specification in a record.
         //
-        /// Contains the name and type of a single field in a record.
+        /// Contains the name and type of a single field in a record,
+        /// and a plan for converting the field, built once by the
+        /// Specification constructor.
+        ///
+        /// The plan holds functions that parse and format values of
+        /// the field's type, so that they need not be selected by
+        /// type for every field of every record, and the text written
+        /// before and after the value by each emitter, such as the
+        /// field name, separators, and quotes.
+        ///
+        /// String values are escaped by the csv::Escaper of the
+        /// output format, see Specification::escaper().
         ///
         struct Field {
             /// The name of the field
@@ -62,11 +92,37 @@ namespace csv {
 
             /// The type of the field
             FieldType type_;
+
+            /// Convert \a token to the type of the field.
+            //
+            /// Returns false if \a token is not a valid value.
+            ///
+            bool (*parse_)(std::string_view token, FieldValue& value) { nullptr };
+
+            /// Append the formatted value of the field in a csv::Record.
+            void (*append_)(std::string& output, const FieldValue& value,
+                            const Escaper& escaper) { nullptr };
+
+            /// Append the formatted value of field \a field in row \a row of a batch.
+            void (*append_batch_)(std::string& output, const RecordBatch& batch,
+                                  std::size_t row, std::size_t field,
+                                  const Escaper& escaper) { nullptr };
+
+            /// Text to write after the value, per TextFormat.
+            //
+            /// Holds everything up to the value of the next field,
+            /// such as closing quotes, separators, and the name of the
+            /// next field. For the last field, it ends the record.
+            ///
+            std::string after_[std::size_t(TextFormat::COUNT)];
+
+            /// Return the text to write after the value in \a format.
+            const std::string& after(TextFormat format) const { return after_[std::size_t(format)]; }
         };
 
         /// Constructor.
         //
-        /// The constrcuctor accepts separator and escape characters that
+        /// The constrcuctor accepts separator, escape, and quote characters that
         /// can be used by the ingester to correctly parse input output.
         ///
         /// The vector of \c < \c string, \c string \c > tuples specifies the field name and types
@@ -82,14 +138,30 @@ namespace csv {
         /// The constructor will transform the data type strings to their FieldType enum
         /// equivalent.
         ///
+        /// If \a projection is given, only the named fields are
+        /// converted and emitted, in the order they are named.
+        /// The remaining fields are still read from the input, but
+        /// are skipped without being converted or copied.
+        ///
+        /// If \a filter is given, it is compiled into a csv::Filter,
+        /// and only lines for which accept() returns true are
+        /// converted and emitted.
+        ///
         /// @param fields The vector of tuples to use as field specifications.
         /// @param separator_char The character to use as a separator when ingesting data.
         /// @param escape_char The escape character to use when ingesting data.
+        /// @param projection Names of the fields to emit. Empty to emit all fields.
+        /// @param filter A csv::Filter expression selecting the lines to emit. Empty to emit all lines.
+        /// @param quote_char The character that quotes fields when ingesting data.
+        ///        0 if fields are not quoted.
         ///
         /// @return n/a
         Specification(const std::vector<std::tuple<std::string, std::string> >& fields,
                       const char separator_char,
-                      const char escape_char);
+                      const char escape_char,
+                      const std::vector<std::string>& projection = {},
+                      const std::string& filter = "",
+                      const char quote_char = 0);
 
         /// Return the separator character provided to constructor.
         const char separator_char(void) const { return separator_char_; }
@@ -97,6 +169,9 @@ namespace csv {
         /// Return the escape character provided to constructor.
         const char escape_char(void) const { return escape_char_; }
 
+        /// Return the quote character provided to constructor.
+        const char quote_char(void) const { return quote_char_; }
+
         /// Return the number of elements that will be returned by a fields() call.
         const uint32_t field_count(void) const { return field_count_; }
 
@@ -106,9 +181,66 @@ namespace csv {
         /// data type of each field in a record. The order of the vector elements
         /// matches the order of fields in a processed record.
         ///
+        /// These are the fields selected by the projection given to
+        /// the constructor, which are the only ones that ingesters
+        /// convert and emitters write.
+        ///
         /// @return - A vector of field specifications.
         const std::vector<Field>& fields(void) const { return fields_; }
 
+        /// Return the number of elements that will be returned by an input_fields() call.
+        const uint32_t input_field_count(void) const { return input_fields_.size(); }
+
+        /// Return the specification of all fields in the input data.
+        //
+        /// The order of the vector elements matches the order of the
+        /// fields in each line of input data.
+        ///
+        /// @return - A vector of field specifications.
+        const std::vector<Field>& input_fields(void) const { return input_fields_; }
+
+        /// Return the input field index of each field in fields().
+        //
+        /// Element \c i is the position in input_fields(), and in the
+        /// tokens of a line of input, of field \c i of a record.
+        ///
+        const std::vector<uint32_t>& projection(void) const { return projection_; }
+
+        /// Return the text to write before the first value of a record in \a format.
+        //
+        /// An emitter writes a record as record_prefix(), followed by
+        /// the value and Field::after() of each field in fields().
+        ///
+        const std::string& record_prefix(TextFormat format) const { return record_prefix_[std::size_t(format)]; }
+
+        /// Return the escaper of string values written in \a format.
+        //
+        /// JSON and YAML strings use backslash escapes. CSV output
+        /// escapes separators, newlines, and quotes with escape_char(),
+        /// so that the output reads back the same. Without an escape
+        /// character, CSV strings that need it are quoted with
+        /// quote_char(), or written as is if there is none.
+        ///
+        const Escaper& escaper(TextFormat format) const { return escaper_[std::size_t(format)]; }
+
+        /// Return true if a line is to be converted and emitted.
+        //
+        /// Ingesters call this with the tokens of each line before
+        /// building a record from them. Lines are accepted unless
+        /// they fail the filter given to the constructor.
+        ///
+        /// A line with a token that the filter cannot compare, since
+        /// it is not a valid value of its field, is not accepted, and
+        /// is to be reported as a record that cannot be converted.
+        ///
+        /// @param tokens One token per field in input_fields().
+        /// @param error Set to the reason if the filter cannot compare a token.
+        ///              Empty if false is returned for a line that was filtered out.
+        ///
+        bool accept(const std::vector<std::string_view>& tokens, std::string& error) const {
+            return !filter_ || filter_match(tokens, error);
+        }
+
     private:
         /// Default constructor - Private to force initialized construction.
         Specification(void) = default;
@@ -119,14 +251,40 @@ namespace csv {
         static std::map<std::string, FieldType> enum_string_map_;
 
         /// CSV field names and types, in order of appearance
+        std::vector<Field> input_fields_;
+
+        /// Projected field names and types, in order of emission.
         std::vector<Field> fields_;
 
+        /// Index into input_fields_ of each element in fields_.
+        std::vector<uint32_t> projection_;
+
+        /// Text written before the first value of a record, per TextFormat.
+        std::string record_prefix_[std::size_t(TextFormat::COUNT)];
+
+        /// String escaper, per TextFormat.
+        Escaper escaper_[std::size_t(TextFormat::COUNT)];
+
+        /// Compiled filter, or null if all lines are accepted.
+        std::shared_ptr<const Filter> filter_;
+
+        bool filter_match(const std::vector<std::string_view>& tokens, std::string& error) const;
+
+        /// Set up the parse and format functions of a field.
+        static void plan_field(Field& field);
+
+        /// Set up the output fragments of fields_.
+        void plan_output(void);
+
         /// Escape character.
         char separator_char_;
 
         /// Escape character.
         char escape_char_;
 
+        /// Quote character.
+        char quote_char_;
+
         /// Number of fields.
         uint32_t field_count_;
    };
@@ -0,0 +1,251 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __STATIC_SPEC_HH__
+#define __STATIC_SPEC_HH__
+#include "specification.hh"
+#include "csv_common.hh"
+#include "csv_format.hh"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace csv {
+    /// Data types supported by csv::StaticField.
+    //
+    /// Only specialized for \c int64_t, \c double, and \c std::string.
+    /// Other types fail to compile.
+    ///
+    template <typename T>
+    struct StaticFieldType;
+
+    template <>
+    struct StaticFieldType<int64_t> {
+        static constexpr FieldType type = FieldType::INT64;
+        static constexpr const char* name = "int";
+    };
+
+    template <>
+    struct StaticFieldType<double> {
+        static constexpr FieldType type = FieldType::DOUBLE;
+        static constexpr const char* name = "double";
+    };
+
+    template <>
+    struct StaticFieldType<std::string> {
+        static constexpr FieldType type = FieldType::STRING;
+        static constexpr const char* name = "string";
+    };
+
+    /// A field of a csv::StaticSpec.
+    //
+    /// C++17 does not accept string literals as template arguments,
+    /// so the name is given as a character array with static storage:
+    ///
+    /// \code
+    ///     static constexpr char ts[] = "ts";
+    ///     using TsField = csv::StaticField<ts, int64_t>;
+    /// \endcode
+    ///
+    /// @tparam NAME The name of the field.
+    /// @tparam T The type of the field. One of \c int64_t, \c double, and \c std::string.
+    ///
+    template <const char* NAME, typename T>
+    struct StaticField {
+        static constexpr const char* name = NAME;
+        using type = T;
+        static constexpr FieldType field_type = StaticFieldType<T>::type;
+    };
+
+    /// A record specification fixed at compile time.
+    //
+    /// This is an alternative to csv::Specification and csv::Record
+    /// for programs that embed the converter with a schema known
+    /// when they are built. Records are plain tuples of the field
+    /// types, and parsing and formatting are unrolled over the fields
+    /// at compile time, with no per-field dispatch on the field type
+    /// and no std::variant.
+    ///
+    /// \code
+    ///     static constexpr char ts[] = "ts";
+    ///     static constexpr char val[] = "val";
+    ///     csv::StaticSpec<csv::StaticField<ts, int64_t>,
+    ///                     csv::StaticField<val, double>> spec(',');
+    ///     using Spec = decltype(spec);
+    ///     Spec::Record record;
+    ///
+    ///     if (spec.parse("1234,0.5", record))
+    ///         std::get<Spec::index<val>()>(record) *= 2;
+    /// \endcode
+    ///
+    /// Fields are tokenized and parsed with the same rules as the
+    /// runtime csv::Record, and formatted with the same output as the
+    /// "csv" and "json" emitters.
+    ///
+    /// An instance holds the buffers reused between parse() calls,
+    /// and is not to be shared between threads.
+    ///
+    template <typename... FIELDS>
+    class StaticSpec {
+    public:
+        /// A record, with one element per field.
+        using Record = std::tuple<typename FIELDS::type...>;
+
+        /// Number of fields.
+        static constexpr std::size_t field_count = sizeof...(FIELDS);
+
+        /// Constructor.
+        //
+        /// @param separator_char The character separating fields.
+        /// @param escape_char The escape character, or 0 for none.
+        ///
+        StaticSpec(char separator_char = ',', char escape_char = 0):
+            separator_char_(separator_char),
+            escape_char_(escape_char),
+            csv_escaper_(Escaper::Style::PREFIX, escape_char, separator_char),
+            json_escaper_(Escaper::Style::BACKSLASH)
+        {
+            tokens_.reserve(field_count);
+        }
+
+        /// Return the position of the field named \a NAME in a Record.
+        template <const char* NAME>
+        static constexpr std::size_t index(void) {
+            constexpr const char* names[] = { FIELDS::name... };
+            std::size_t result(0);
+
+            while(result < field_count && names[result] != NAME)
+                ++result;
+
+            return result;
+        }
+
+        /// Return an equivalent runtime specification.
+        Specification specification(void) const {
+            return Specification({ { FIELDS::name, StaticFieldType<typename FIELDS::type>::name }... },
+                                 separator_char_, escape_char_);
+        }
+
+        /// Parse a line.
+        //
+        /// @param line The line to parse, without its terminating newline.
+        /// @param record The record to store the field values in.
+        ///
+        /// @return true - The line was parsed into \a record.
+        /// @return false - The line has the wrong number of fields, or a number field is invalid.
+        ///
+        bool parse(std::string_view line, Record& record) {
+            tokens_.clear();
+
+            if (tokenize_line(line, separator_char_, escape_char_, tokens_, buffer_) != field_count)
+                return false;
+
+            return parse_fields(record, std::index_sequence_for<FIELDS...>());
+        }
+
+        /// Parse all lines of a block of data, and append them to \a records.
+        //
+        /// @param data The lines to parse. A newline preceded by the escape character does not end a line.
+        /// @param records The vector to append the parsed records to.
+        ///
+        /// @return true - All lines were parsed.
+        /// @return false - A line could not be parsed. The records before it were appended.
+        ///
+        bool parse(std::string_view data, std::vector<Record>& records) {
+            const char* begin(data.data());
+            const char* end(begin + data.length());
+
+            while(begin != end) {
+                const char* record_end(find_record_end(begin, end, escape_char_));
+
+                records.emplace_back();
+                if (!parse(std::string_view(begin, record_end - begin), records.back())) {
+                    records.pop_back();
+                    return false;
+                }
+                begin = (record_end == end)?end:(record_end + 1);
+            }
+            return true;
+        }
+
+        /// Append a record as a CSV line, as written by the "csv" emitter.
+        void append_csv(std::string& output, const Record& record) const {
+            append_csv_fields(output, record, std::index_sequence_for<FIELDS...>());
+            output += '\n';
+        }
+
+        /// Append a record as a JSON object, as written by the "json" emitter.
+        //
+        /// @param output The string to append to.
+        /// @param record The record to format.
+        /// @param first True for the first record of the array, which is not preceded by a comma.
+        ///
+        void append_json(std::string& output, const Record& record, bool first) const {
+            output.append(first?"{\n":",\n{\n");
+            append_json_fields(output, record, std::index_sequence_for<FIELDS...>());
+            output.append("}\n");
+        }
+
+    private:
+        static bool parse_value(std::string_view token, int64_t& value) { return parse_int64(token, value); }
+        static bool parse_value(std::string_view token, double& value) { return parse_double(token, value); }
+        static bool parse_value(std::string_view token, std::string& value) { value.assign(token); return true; }
+
+        static void append_value(std::string& output, int64_t value, const Escaper&) { append_int64(output, value); }
+        static void append_value(std::string& output, double value, const Escaper&) { append_double(output, value); }
+        static void append_value(std::string& output, const std::string& value, const Escaper& escaper) { escaper.append(output, value); }
+
+        template <std::size_t... I>
+        bool parse_fields(Record& record, std::index_sequence<I...>) {
+            return (parse_value(tokens_[I], std::get<I>(record)) && ...);
+        }
+
+        template <std::size_t... I>
+        void append_csv_fields(std::string& output, const Record& record, std::index_sequence<I...>) const {
+            ((I?(void)(output += separator_char_):(void)0, append_value(output, std::get<I>(record), csv_escaper_)), ...);
+        }
+
+        template <std::size_t... I>
+        void append_json_fields(std::string& output, const Record& record, std::index_sequence<I...>) const {
+            ((append_json_field<FIELDS>(output, std::get<I>(record)),
+              output.append(I + 1 < field_count?",\n":"\n")), ...);
+        }
+
+        template <typename FIELD>
+        void append_json_field(std::string& output, const typename FIELD::type& value) const {
+            output.append("    \"");
+            output.append(FIELD::name);
+            output.append("\": ");
+
+            if constexpr (FIELD::field_type == FieldType::STRING) {
+                output += '"';
+                json_escaper_.append(output, value);
+                output += '"';
+            } else
+                append_value(output, value, json_escaper_);
+        }
+
+        char separator_char_;
+        char escape_char_;
+        Escaper csv_escaper_;
+        Escaper json_escaper_;
+        std::vector<std::string_view> tokens_;
+        std::string buffer_;
+    };
+};
+#endif
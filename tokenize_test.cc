@@ -0,0 +1,322 @@
+// (C) 2020 - Magnus Feuer
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Differential test of csv::tokenize_line(), csv::StructuralTokenizer,
+// and csv::Escaper against character-by-character reference
+// implementations, run once for every instruction set supported by
+// the CPU.
+//
+#include "csv_common.hh"
+#include "csv_simd.hh"
+#include "csv_escape.hh"
+#include "csv_tokenizer.hh"
+#include <stdlib.h>
+#include <iostream>
+#include <random>
+#include <algorithm>
+
+//
+// The original, scalar, tokenizer.
+//
+static uint32_t reference_tokenize_line(const std::string& line,
+                                        uint8_t separator,
+                                        uint8_t escape,
+                                        std::vector<std::string>& result)
+{
+    bool escape_mode(false);
+    std::string token("");
+    int res(0);
+
+    if (!line.length())
+        return 0;
+
+    for(uint8_t ch: line) {
+        if (escape && ch == escape) {
+            escape_mode = true;
+            continue;
+        }
+
+        if (!escape_mode && ch == separator) {
+            result.push_back(token);
+            token.resize(0);
+            res++;
+            continue;
+        }
+
+        token.push_back(ch);
+        escape_mode = false;
+    }
+
+    result.push_back(token);
+    return res + 1;
+}
+
+//
+// Quote aware tokenizer of all records in 'data'.
+// Records are added to 'result' along with their text.
+//
+static void reference_tokenize_quoted(const std::string& data,
+                                      uint8_t separator,
+                                      uint8_t escape,
+                                      uint8_t quote,
+                                      std::vector<std::vector<std::string>>& result,
+                                      std::vector<std::string>& texts)
+{
+    std::vector<std::string> record;
+    std::string token("");
+    std::size_t record_start(0);
+    bool escape_mode(false);
+    bool quoted(false);
+
+    for(std::size_t i = 0; i < data.length(); ++i) {
+        uint8_t ch(data[i]);
+
+        if (escape && ch == escape) {
+            escape_mode = true;
+            continue;
+        }
+
+        if (escape_mode) {
+            token.push_back(ch);
+            escape_mode = false;
+            continue;
+        }
+
+        if (quote && ch == quote) {
+            if (quoted && i + 1 < data.length() && uint8_t(data[i + 1]) == quote) {
+                token.push_back(ch);
+                ++i;
+                continue;
+            }
+            quoted = !quoted;
+            continue;
+        }
+
+        if (!quoted && (ch == separator || ch == '\n')) {
+            // Empty lines have no fields.
+            if (ch == separator || i != record_start)
+                record.push_back(token);
+            token.clear();
+
+            if (ch == '\n') {
+                result.push_back(record);
+                texts.push_back(data.substr(record_start, i - record_start));
+                record.clear();
+                record_start = i + 1;
+            }
+            continue;
+        }
+        token.push_back(ch);
+    }
+
+    if (record_start != data.length()) {
+        record.push_back(token);
+        result.push_back(record);
+        texts.push_back(data.substr(record_start));
+    }
+}
+
+//
+// Per-character escaping, as done before csv::Escaper.
+//
+static void reference_escape(const std::string& value,
+                             csv::Escaper::Style style,
+                             char escape,
+                             char separator,
+                             std::string& result)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    for(char ch: value) {
+        if (style == csv::Escaper::Style::PREFIX) {
+            if (escape && (ch == separator || ch == '\n'))
+                result += escape;
+            result += ch;
+            continue;
+        }
+
+        switch(ch) {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\b': result += "\\b"; break;
+        case '\f': result += "\\f"; break;
+        case '\n': result += "\\n"; break;
+        case '\r': result += "\\r"; break;
+        case '\t': result += "\\t"; break;
+        default:
+            if (uint8_t(ch) < 0x20) {
+                result += "\\u00";
+                result += hex[uint8_t(ch) >> 4];
+                result += hex[ch & 0xf];
+            } else
+                result += ch;
+        }
+    }
+}
+
+static const char* level_name(csv::SimdLevel level)
+{
+    switch(level) {
+    case csv::SimdLevel::SCALAR: return "scalar";
+    case csv::SimdLevel::SSE2: return "sse2";
+    case csv::SimdLevel::AVX2: return "avx2";
+    case csv::SimdLevel::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+int main(int argc, char* argv[])
+{
+    // Separator, escape, and a few plain characters.
+    static const char alphabet[] = ",\\ab;\t\n";
+    std::mt19937 rng(4711);
+    std::vector<std::string_view> views;
+    std::string buffer;
+
+    for(auto level: { csv::SimdLevel::SCALAR, csv::SimdLevel::SSE2,
+                      csv::SimdLevel::AVX2, csv::SimdLevel::AVX512 }) {
+
+        if (!csv::set_simd_level(level)) {
+            std::cout << level_name(level) << ": not supported, skipped." << std::endl;
+            continue;
+        }
+
+        for(int i = 0; i < 20000; ++i) {
+            std::string line("");
+            std::size_t length(rng() % 300);
+            // Vary the density of special characters between lines.
+            std::size_t special_range(2 + rng() % 40);
+
+            for(std::size_t c = 0; c < length; ++c) {
+                std::size_t pick(rng() % special_range);
+                line.push_back(pick < 2?alphabet[pick]:alphabet[2 + (pick % (sizeof(alphabet) - 3))]);
+            }
+
+            for(uint8_t escape: { uint8_t(0), uint8_t('\\') }) {
+                std::vector<std::string> expect;
+                std::vector<std::string> result { "existing" };
+                uint32_t expect_count(reference_tokenize_line(line, ',', escape, expect));
+                uint32_t result_count(csv::tokenize_line(line, ',', escape, result));
+
+                // Existing elements in the result vector must be retained.
+                expect.insert(expect.begin(), "existing");
+
+                if (expect_count != result_count || expect != result) {
+                    std::cout << level_name(level) << ": FAILED on line [" << line <<
+                        "] with escape " << int(escape) << std::endl;
+                    exit(255);
+                }
+
+                // The view based tokenizer must produce the same fields,
+                // using a buffer and vector reused between lines.
+                views.clear();
+                views.push_back("existing");
+                result_count = csv::tokenize_line(line, ',', escape, views, buffer);
+
+                if (expect_count != result_count ||
+                    !std::equal(expect.begin(), expect.end(), views.begin(), views.end())) {
+                    std::cout << level_name(level) << ": FAILED on line [" << line <<
+                        "] with escape " << int(escape) << " (views)" << std::endl;
+                    exit(255);
+                }
+            }
+        }
+        // Quoted records, indexed in windows of different sizes.
+        static const char quote_alphabet[] = ",\"\\\nab;";
+
+        for(int i = 0; i < 5000; ++i) {
+            std::string data("");
+            std::size_t length(rng() % 1000);
+            std::size_t special_range(4 + rng() % 40);
+
+            for(std::size_t c = 0; c < length; ++c) {
+                std::size_t pick(rng() % special_range);
+                data.push_back(pick < 4?quote_alphabet[pick]:quote_alphabet[4 + pick % 3]);
+            }
+
+            for(uint8_t escape: { uint8_t(0), uint8_t('\\') }) {
+                std::vector<std::vector<std::string>> expect;
+                std::vector<std::string> expect_texts;
+
+                reference_tokenize_quoted(data, ',', escape, '"', expect, expect_texts);
+
+                for(std::size_t window_size: { std::size_t(64), std::size_t(100), csv::StructuralTokenizer::default_window_size }) {
+                    csv::StructuralTokenizer tokenizer(',', escape, '"', window_size);
+                    std::size_t record(0);
+                    bool failed(false);
+
+                    tokenizer.reset(data.data(), data.data() + data.length());
+                    while(!tokenizer.done() && !failed) {
+                        std::string_view text;
+                        uint32_t count(0);
+
+                        views.clear();
+                        views.push_back("existing");
+                        count = tokenizer.next(views, buffer, text);
+
+                        failed = (record >= expect.size() || count != expect[record].size() ||
+                                  text != expect_texts[record] ||
+                                  !std::equal(expect[record].begin(), expect[record].end(),
+                                              views.begin() + 1, views.end()));
+                        ++record;
+                    }
+
+                    if (failed || record != expect.size()) {
+                        std::cout << level_name(level) << ": FAILED on quoted data [" << data <<
+                            "] with escape " << int(escape) << " and window " << window_size <<
+                            " at record " << record << std::endl;
+                        exit(255);
+                    }
+                }
+            }
+        }
+
+        // Escaping, with characters above 0x7f to catch signed comparisons.
+        static const char escape_alphabet[] = ",\\\"\n\x01\x1f\x7f\x80\xff a";
+
+        for(int i = 0; i < 20000; ++i) {
+            std::string value("");
+            std::size_t length(rng() % 300);
+            std::size_t special_range(2 + rng() % 200);
+
+            for(std::size_t c = 0; c < length; ++c) {
+                std::size_t pick(rng() % special_range);
+                value.push_back(pick < sizeof(escape_alphabet) - 1?escape_alphabet[pick]:'a' + pick % 26);
+            }
+
+            for(auto style: { csv::Escaper::Style::BACKSLASH, csv::Escaper::Style::PREFIX }) {
+                for(char escape: { '\0', '\\' }) {
+                    csv::Escaper escaper(style, escape, ',');
+                    std::string expect("existing");
+                    std::string result("existing");
+
+                    reference_escape(value, style, escape, ',', expect);
+                    escaper.append(result, value);
+
+                    if (expect != result) {
+                        std::cout << level_name(level) << ": FAILED escaping [" << value <<
+                            "] with style " << int(style) << " and escape " << int(escape) << std::endl;
+                        exit(255);
+                    }
+                }
+            }
+        }
+        std::cout << level_name(level) << ": pass." << std::endl;
+    }
+
+    csv::set_simd_level(csv::simd_level_supported());
+    exit(0);
+}